@@ -0,0 +1,19 @@
+in vec3 vs_uv;
+in vec4 vs_color;
+flat in uint vs_textured;
+
+out vec4 out_color;
+
+uniform sampler2DArray atlas_sampler;
+uniform float sdf_width;
+
+void main()
+{
+	out_color = vs_color;
+	if (vs_textured != 0u) {
+		vec2 uv = vs_uv.xy / textureSize(atlas_sampler, 0).xy;
+		float a = texture(atlas_sampler, vec3(uv, vs_uv.z)).r;
+		if (sdf_width > 0.0) a = smoothstep(0.5 - sdf_width, 0.5 + sdf_width, a);
+		out_color.a *= a;
+	}
+}
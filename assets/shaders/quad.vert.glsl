@@ -0,0 +1,24 @@
+layout(location = 0) in vec4 i_rect;
+layout(location = 1) in uint i_uv;
+layout(location = 2) in vec4 i_color;
+
+uniform vec2 resolution;
+uniform float texel_scale;
+
+out vec3 vs_uv;
+out vec4 vs_color;
+flat out uint vs_textured;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 pos = mix(i_rect.xy, i_rect.zw, corner);
+
+    gl_Position = vec4(pos / resolution * 2.0 - 1.0, 0.0, 1.0);
+    gl_Position.y = -gl_Position.y;
+
+    vs_uv = vec3(i_uv & 0xFFFu, (i_uv >> 12) & 0xFFFu, i_uv >> 24);
+    vs_uv.xy += corner * (i_rect.zw - i_rect.xy) * texel_scale;
+    vs_color = i_color;
+    vs_textured = i_uv != 0xFFFFFFFFu ? 1u : 0u;
+}
@@ -11,7 +11,7 @@ parser = argparse.ArgumentParser("configure.py", description="generates build fi
 parser.add_argument("-o", "--out", default="build", help="build generation output directory")
 parser.add_argument("--debug", action="store_true", help="compile with debug info")
 parser.add_argument("--optimize", action="store_true", help="turn on compiler optimization")
-parser.add_argument("-r", "--render", choices=["opengl"], default="opengl", help="choose render backend")
+parser.add_argument("-r", "--render", choices=["opengl", "software"], default="opengl", help="choose render backend")
 args = parser.parse_args();
 
 host_os   = sys.platform
@@ -175,10 +175,14 @@ include_path(mimir, ["$root/src", "$root", "$root/external", "$builddir"], publi
 
 cxx(mimir, "mimir.cpp")
 cxx(mimir, "font.cpp")
+cxx(mimir, "gfx.cpp")
+cxx(mimir, "jobs.cpp")
 
 meta(mimir, "mimir.cpp")
 meta(mimir, "gui.cpp")
 meta(mimir, "font.cpp")
+meta(mimir, "gfx.cpp")
+meta(mimir, "jobs.cpp")
 
 if args.render == "opengl":
     gl_defines = define(mimir, "GFX_OPENGL")
@@ -196,23 +200,39 @@ if args.render == "opengl":
     define(core, gl_defines)
     lib(core, gl_libs)
 
+    if target_os == "win32": cxx(mimir, "core/win32_opengl.cpp")
+    if target_os == "linux": cxx(mimir, "core/linux_opengl.cpp")
 
-if target_os == "win32":
-    cxx(mimir, "win32_main.cpp")
-    cxx(mimir, "core/win32_opengl.cpp")
+    if target_os == "win32":
+        cxx(mimir, "win32_main.cpp")
+
+        lib(mimir, "user32")
+        lib(mimir, "shell32")
+        lib(mimir, "gdi32")
+        lib(mimir, "shlwapi")
+        lib(mimir, "Xinput")
+
+    if target_os == "linux":
+        cxx(mimir, "linux_main.cpp")
 
-    lib(mimir, "user32")
-    lib(mimir, "shell32")
-    lib(mimir, "gdi32")
-    lib(mimir, "shlwapi")
-    lib(mimir, "Xinput")
+        lib(mimir, "X11")
+        lib(mimir, "Xi")
 
-if target_os == "linux":
-    cxx(mimir, "linux_main.cpp")
-    cxx(mimir, "core/linux_opengl.cpp")
+# NOTE(jesper): renders into memory and runs headless, for benchmarks and pixel snapshots on machines without a GPU.
+# It has its own entry point and links neither a GL driver nor the window system libraries
+if args.render == "software":
+    define(mimir, "GFX_SOFTWARE")
+
+    meta(mimir, "gfx_software.cpp")
+    cxx(mimir, "gfx_software.cpp")
+    cxx(mimir, "headless_main.cpp")
+
+    if target_os == "win32":
+        lib(mimir, "shell32")
+        lib(mimir, "shlwapi")
 
-    lib(mimir, "X11")
-    lib(mimir, "Xi")
+if target_os == "win32": cxx(mimir, "win32_file.cpp")
+if target_os == "linux": cxx(mimir, "linux_file.cpp")
 
 test = build.test(mimir, "$root/src/core")
 include_path(test, "$root/src")
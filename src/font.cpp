@@ -5,7 +5,9 @@
 #include "core/maths.h"
 #include "core/file.h"
 #include "core/assets.h"
-#include "gfx_opengl.h"
+#include "core/thread.h"
+#include "gfx.h"
+#include "jobs.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #define STBTT_malloc(x,u)  ((void)(u),malloc(x))
@@ -20,12 +22,282 @@
 #define STBTT_fabs(x)     fabs(x)
 #include "stb/stb_truetype.h"
 
-FontAtlas create_font(String filename, f32 pixel_height, bool mono_space)
+#include <mutex>
+
+// NOTE(jesper): pages that had glyphs looked up in the current frame are never evicted, as the commands
+// referring to them haven't been submitted yet
+static u64 font_frame = 1;
+
+struct GlyphRasterJob {
+    FontAtlas *font;
+    const stbtt_fontinfo *info;
+    f32 scale;
+    i32 glyph_index;
+    bool sdf;
+
+    // NOTE(jesper): the bitmap box of the glyph, including the padding of SDF glyphs
+    i32 x0, y0;
+    i32 w, h;
+    i32 wa, ha;
+
+    i32 page;
+    u32 page_generation;
+    i32 dst_x, dst_y;
+
+    u8 *pixels;
+    GlyphRasterJob *next;
+};
+
+// NOTE(jesper): glyphs missing from the atlas get their slot allocated straight away, and are rasterized on the
+// job pool. The slot is cleared, so the glyph is drawn empty until its bitmap is uploaded at the start of a
+// following frame. The jobs and their bitmaps are allocated and freed on the main thread, so the workers only
+// link the finished jobs into the done list
+struct GlyphRasterQueue {
+    std::mutex m;
+    GlyphRasterJob *done;
+
+    // NOTE(jesper): jobs submitted, in progress, or done but not yet uploaded
+    i32 pending;
+};
+
+GlyphRasterQueue raster_queue{};
+
+// NOTE(jesper): squared euclidean distance transform of the n samples in f, from Felzenszwalb and Huttenlocher's
+// "Distance Transforms of Sampled Functions". v and z are scratch space for n and n+1 elements
+void edt_1d(f32 *f, f32 *d, i32 *v, f32 *z, i32 n)
+{
+    i32 k = 0;
+    v[0] = 0;
+    z[0] = -f32_MAX;
+    z[1] = f32_MAX;
+
+    for (i32 q = 1; q < n; q++) {
+        f32 s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+        while (s <= z[k]) {
+            k--;
+            s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+        }
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = f32_MAX;
+    }
+
+    k = 0;
+    for (i32 q = 0; q < n; q++) {
+        while (z[k+1] < q) k++;
+        d[q] = (q-v[k])*(q-v[k]) + f[v[k]];
+    }
+}
+
+void edt_2d(f32 *grid, i32 width, i32 height, Allocator mem)
+{
+    i32 n = MAX(width, height);
+    f32 *f = ALLOC_ARR(mem, f32, n);
+    f32 *d = ALLOC_ARR(mem, f32, n);
+    f32 *z = ALLOC_ARR(mem, f32, n+1);
+    i32 *v = ALLOC_ARR(mem, i32, n);
+
+    for (i32 x = 0; x < width; x++) {
+        for (i32 y = 0; y < height; y++) f[y] = grid[y*width + x];
+        edt_1d(f, d, v, z, height);
+        for (i32 y = 0; y < height; y++) grid[y*width + x] = d[y];
+    }
+
+    for (i32 y = 0; y < height; y++) {
+        edt_1d(&grid[y*width], d, v, z, width);
+        memcpy(&grid[y*width], d, width * sizeof d[0]);
+    }
+}
+
+// NOTE(jesper): rasterizes the glyph at FONT_SDF_UPSAMPLE times the size and computes the signed distance to its
+// edge at the center of each pixel. 128 is on the edge, and FONT_SDF_PADDING pixels inside or outside of it
+// is 255 or 0 respectively
+void font_make_glyph_sdf(GlyphRasterJob *job)
+{
+    SArena scratch = tl_scratch_arena();
+
+    i32 upsample = FONT_SDF_UPSAMPLE;
+    f32 scale = job->scale*upsample;
+
+    i32 width = job->w*upsample;
+    i32 height = job->h*upsample;
+
+    u8 *coverage = ALLOC_ARR(*scratch, u8, width*height);
+    memset(coverage, 0, width*height);
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(job->info, job->glyph_index, scale, scale, &x0, &y0, &x1, &y1);
+
+    i32 ox = x0 - job->x0*upsample;
+    i32 oy = y0 - job->y0*upsample;
+    if (ox >= 0 && oy >= 0 && ox < width && oy < height) {
+        stbtt_MakeGlyphBitmap(
+            job->info, &coverage[oy*width + ox],
+            MIN(x1-x0, width-ox), MIN(y1-y0, height-oy), width,
+            scale, scale, job->glyph_index);
+    }
+
+    f32 *outside = ALLOC_ARR(*scratch, f32, width*height);
+    f32 *inside = ALLOC_ARR(*scratch, f32, width*height);
+    for (i32 i = 0; i < width*height; i++) {
+        outside[i] = coverage[i] >= 128 ? 0 : 1e20f;
+        inside[i] = coverage[i] >= 128 ? 1e20f : 0;
+    }
+
+    edt_2d(outside, width, height, *scratch);
+    edt_2d(inside, width, height, *scratch);
+
+    f32 k = 128.0f / (FONT_SDF_PADDING*upsample);
+    for (i32 j = 0; j < job->h; j++) {
+        for (i32 i = 0; i < job->w; i++) {
+            i32 p = (j*upsample + upsample/2)*width + i*upsample + upsample/2;
+            f32 dist = outside[p] > 0 ? sqrtf(outside[p]) - 0.5f : 0.5f - sqrtf(inside[p]);
+            job->pixels[j*job->wa + i] = (u8)CLAMP(128.0f - dist*k, 0.0f, 255.0f);
+        }
+    }
+}
+
+void font_rasterize_glyph(GlyphRasterJob *job)
+{
+    memset(job->pixels, 0, job->wa*job->ha);
+
+    if (job->sdf) font_make_glyph_sdf(job);
+    else stbtt_MakeGlyphBitmap(job->info, job->pixels, job->w, job->h, job->wa, job->scale, job->scale, job->glyph_index);
+
+#if 0
+    LOG_RAW("w: %d, h: %d, wa: %d, ha: %d\n", job->w, job->h, job->wa, job->ha);
+    for (i32 j = 0; j < job->h; j++) {
+        for (i32 i = 0; i < job->w; i++) {
+            LOG_RAW("%c", " .:ioVM@"[job->pixels[j*job->wa+i]>>5]);
+        }
+        LOG_RAW("\n");
+    }
+
+    LOG_RAW("\n");
+#endif
+}
+
+void glyph_raster_job(void *data)
+{
+    GlyphRasterJob *job = (GlyphRasterJob*)data;
+    font_rasterize_glyph(job);
+
+    std::lock_guard lk(raster_queue.m);
+    job->next = raster_queue.done;
+    raster_queue.done = job;
+}
+
+void font_queue_glyph(GlyphRasterJob job)
+{
+    GlyphRasterJob *queued = ALLOC_T(mem_dynamic, GlyphRasterJob) { job };
+    queued->pixels = (u8*)ALLOC(mem_dynamic, job.wa*job.ha);
+
+    {
+        std::lock_guard lk(raster_queue.m);
+        raster_queue.pending++;
+    }
+
+    submit_job({ .proc = glyph_raster_job, .data = queued });
+}
+
+bool font_glyphs_pending() EXPORT
+{
+    std::lock_guard lk(raster_queue.m);
+    return raster_queue.pending > 0;
+}
+
+// NOTE(jesper): uploads the glyphs rasterized since the last frame as one batch. Glyphs whose page was evicted
+// in the meantime are dropped. Returns whether anything was uploaded
+bool font_begin_frame() EXPORT
+{
+    font_frame++;
+
+    GlyphRasterJob *done;
+    {
+        std::lock_guard lk(raster_queue.m);
+        done = raster_queue.done;
+        raster_queue.done = nullptr;
+        for (GlyphRasterJob *job = done; job; job = job->next) raster_queue.pending--;
+    }
+
+    if (!done) return false;
+
+    SArena scratch = tl_scratch_arena();
+    DynamicArray<GfxTextureUpload> uploads{ .alloc = scratch };
+    for (GlyphRasterJob *job = done; job; job = job->next) {
+        if (job->page_generation != job->font->pages[job->page].generation) continue;
+
+        array_add(&uploads, GfxTextureUpload{
+            .texture = job->font->texture,
+            .x = job->dst_x, .y = job->dst_y, .layer = job->page,
+            .width = job->wa, .height = job->ha,
+            .pixels = job->pixels,
+        });
+    }
+
+    gfx_upload_texture_layers(uploads.data, uploads.count);
+
+    for (GlyphRasterJob *job = done, *next; job; job = next) {
+        next = job->next;
+        FREE(mem_dynamic, job->pixels);
+        FREE(mem_dynamic, job);
+    }
+
+    return uploads.count > 0;
+}
+
+FontMetrics font_metrics(FontAtlas *font, f32 pixel_height)
+{
+    FontMetrics m{ .scale = stbtt_ScaleForPixelHeight(&font->info, pixel_height) };
+    m.line_height = m.scale * (font->ascent - font->descent + font->line_gap);
+    m.baseline = (i32)ceilf(font->ascent*m.scale);
+
+    int advance, lsb;
+    stbtt_GetCodepointHMetrics(&font->info, ' ', &advance, &lsb);
+    m.space_width = m.scale*advance;
+    return m;
+}
+
+// NOTE(jesper): changes the size the font is drawn at. The glyphs of SDF fonts are drawn at any size from the same
+// atlas, so it's only a matter of updating the metrics. Bitmap fonts have to be recreated
+bool font_set_pixel_height(FontAtlas *font, f32 pixel_height)
+{
+    if (!font->sdf) {
+        LOG_ERROR("the size of a bitmap font can't be changed, it must be recreated");
+        return false;
+    }
+
+    FontMetrics m = font_metrics(font, pixel_height);
+    font->scale = m.scale;
+    font->line_height = m.line_height;
+    font->space_width = m.space_width;
+    font->baseline = m.baseline;
+    return true;
+}
+
+// NOTE(jesper): the atlas texels per pixel the glyphs are drawn at, which is only ever not 1 for SDF fonts
+f32 font_texel_scale(FontAtlas *font) EXPORT
+{
+    return font->raster.scale / font->scale;
+}
+
+// NOTE(jesper): the distance the edge of SDF glyphs is smoothed over, about a pixel on screen. The field goes from
+// 0 to 1 over twice the padding in atlas texels
+f32 font_sdf_width(FontAtlas *font) EXPORT
+{
+    if (!font->sdf) return 0;
+    return 0.5f * font_texel_scale(font) / (2*FONT_SDF_PADDING);
+}
+
+FontAtlas create_font(String filename, f32 pixel_height, bool mono_space, bool sdf)
 {
     SArena scratch = tl_scratch_arena();
 
     FontAtlas font{};
     font.mono_space = mono_space;
+    font.sdf = sdf;
 
     // TODO(jesper): load fonts through asset handles
     String path = resolve_asset_path(filename, scratch);
@@ -35,66 +307,182 @@ FontAtlas create_font(String filename, f32 pixel_height, bool mono_space)
         stbtt_InitFont(&font.info, file.data, 0);
 
         stbtt_GetFontVMetrics(&font.info, &font.ascent, &font.descent, &font.line_gap);
-        font.scale = stbtt_ScaleForPixelHeight(&font.info, pixel_height);
-        font.line_height = font.scale * (font.ascent - font.descent + font.line_gap);
-        font.baseline = (i32)ceilf(font.ascent*font.scale);
-        // TODO(jesper): dynamically resize the atlas texture
-        font.size = { 512, 512 };
-        font.current = { 0, 0 };
+        font.size = { FONT_ATLAS_PAGE_SIZE, FONT_ATLAS_PAGE_SIZE };
+
+        FontMetrics m = font_metrics(&font, pixel_height);
+        font.scale = m.scale;
+        font.line_height = m.line_height;
+        font.space_width = m.space_width;
+        font.baseline = m.baseline;
+        font.raster = sdf ? font_metrics(&font, FONT_SDF_RASTER_HEIGHT) : m;
+
+        font.texture = gfx_create_texture_array(font.size.x, font.size.y, 1, sdf);
+        font.texture_pages = 1;
+        array_add(&font.pages, FontAtlasPage{});
+
+        font.direct_glyphs = ALLOC_ARR(mem_dynamic, Glyph, FONT_DIRECT_GLYPHS);
+        for (i32 i = 0; i < FONT_DIRECT_GLYPHS; i++) font.direct_glyphs[i] = { .page = -1 };
+
+        font.glyph_cache.capacity = 256;
+        font.glyph_cache.slots = ALLOC_ARR(mem_dynamic, Glyph, font.glyph_cache.capacity);
+        memset(font.glyph_cache.slots, 0, font.glyph_cache.capacity * sizeof font.glyph_cache.slots[0]);
+
+        // NOTE(jesper): printable ASCII is the bulk of what's drawn, so it's rasterized up front rather than
+        // trickling in over the first frames. Anything else is rasterized on the job pool, whose jobs refer
+        // to the font by pointer and so can't be used until it's been returned
+        for (u32 c = ' '; c < 0x7F; c++) find_or_create_glyph(&font, c);
+        font.async_raster = true;
+    }
+
+    return font;
+}
 
-        int advance, lsb;
-        stbtt_GetCodepointHMetrics(&font.info, ' ', &advance, &lsb);
-        font.space_width = font.scale*advance;
+Glyph* font_glyph_slot(FontAtlas *font, u32 codepoint)
+{
+    if (codepoint < FONT_DIRECT_GLYPHS) return &font->direct_glyphs[codepoint];
 
-        glGenTextures(1, &font.texture);
-        glBindTexture(GL_TEXTURE_2D, font.texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    u32 mask = font->glyph_cache.capacity-1;
+    u32 h = codepoint * 0x9E3779B1u;
+    u32 i = (h ^ (h >> 16)) & mask;
+
+    Glyph *slots = font->glyph_cache.slots;
+    while (slots[i].codepoint != 0 && slots[i].codepoint != codepoint) i = (i+1) & mask;
+    return &slots[i];
+}
 
-        // TODO(jesper): figure out if we need to do this or what the preferred way to clear a
-        // texture to black is
-        u8 *black = (u8*)ALLOC(mem_dynamic, font.size.x*font.size.y);
-        memset(black, 0, font.size.x*font.size.y);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, font.size.x, font.size.y);
+void font_glyph_cache_set(FontAtlas *font, Glyph glyph)
+{
+    Glyph *slot = font_glyph_slot(font, glyph.codepoint);
+
+    if (glyph.codepoint >= FONT_DIRECT_GLYPHS && slot->codepoint == 0) {
+        auto *cache = &font->glyph_cache;
+        if ((cache->count+1)*2 > cache->capacity) {
+            Glyph *old_slots = cache->slots;
+            i32 old_capacity = cache->capacity;
+
+            if (cache->capacity < FONT_GLYPH_CACHE_MAX) cache->capacity *= 2;
+            cache->slots = ALLOC_ARR(mem_dynamic, Glyph, cache->capacity);
+            memset(cache->slots, 0, cache->capacity * sizeof cache->slots[0]);
+            cache->count = 0;
+
+            if (cache->capacity != old_capacity) {
+                for (i32 i = 0; i < old_capacity; i++) {
+                    if (old_slots[i].codepoint == 0) continue;
+                    *font_glyph_slot(font, old_slots[i].codepoint) = old_slots[i];
+                    cache->count++;
+                }
+            }
+
+            FREE(mem_dynamic, old_slots);
+            slot = font_glyph_slot(font, glyph.codepoint);
+        }
+
+        cache->count++;
     }
 
-    return font;
+    *slot = glyph;
+}
+
+// NOTE(jesper): makes a new page current. Unused layers of the texture are used first, then the texture is grown,
+// and once it's at FONT_ATLAS_MAX_PAGES the least recently used page is evicted. Returns false if every page
+// is in use by the current frame
+bool font_atlas_next_page(FontAtlas *font)
+{
+    if (font->pages.count < font->texture_pages) {
+        font->current_page = array_add(&font->pages, FontAtlasPage{});
+        return true;
+    }
+
+    if (font->texture_pages < FONT_ATLAS_MAX_PAGES) {
+        i32 pages = MIN(font->texture_pages*2, FONT_ATLAS_MAX_PAGES);
+        GfxHandle texture = gfx_create_texture_array(font->size.x, font->size.y, pages, font->sdf);
+        gfx_copy_texture_layers(font->texture, texture, font->size.x, font->size.y, font->texture_pages);
+
+        array_add(&font->retired_textures, font->texture);
+        font->texture = texture;
+        font->texture_pages = pages;
+
+        font->current_page = array_add(&font->pages, FontAtlasPage{});
+        return true;
+    }
+
+    i32 lru = -1;
+    for (i32 i = 0; i < font->pages.count; i++) {
+        if (font->pages[i].last_used == font_frame) continue;
+        if (lru == -1 || font->pages[i].last_used < font->pages[lru].last_used) lru = i;
+    }
+
+    if (lru == -1) return false;
+
+    FontAtlasPage *page = &font->pages[lru];
+    page->current = { 0, 0 };
+    page->current_row_height = 0;
+    page->generation++;
+
+    gfx_clear_texture_layer(font->texture, lru, font->size.x, font->size.y);
+
+    font->current_page = lru;
+    font->generation++;
+    return true;
 }
 
 Glyph find_or_create_glyph(FontAtlas *font, u32 codepoint) EXPORT
 {
-    SArena scratch = tl_scratch_arena();
+    if (font->frame != font_frame) {
+        for (GfxHandle texture : font->retired_textures) gfx_destroy_texture(texture);
+        font->retired_textures.count = 0;
+        font->frame = font_frame;
+    }
+
+    Glyph *slot = font_glyph_slot(font, codepoint);
+    if (slot->codepoint == codepoint && slot->page >= 0 &&
+        slot->page_generation == font->pages[slot->page].generation)
+    {
+        font->pages[slot->page].last_used = font_frame;
+        return *slot;
+    }
 
     int glyph_index = stbtt_FindGlyphIndex(&font->info, codepoint);
 
+    // NOTE(jesper): several codepoints can map to the same glyph, most commonly the missing glyph
     Glyph *existing = map_find(&font->glyphs, glyph_index);
-    if (existing) return *existing;
+    if (existing && existing->page >= 0 &&
+        existing->page_generation == font->pages[existing->page].generation)
+    {
+        font->pages[existing->page].last_used = font_frame;
+
+        Glyph glyph = *existing;
+        glyph.codepoint = codepoint;
+        font_glyph_cache_set(font, glyph);
+        return glyph;
+    }
 
     bool glyph_empty = stbtt_IsGlyphEmpty(&font->info, glyph_index);
     (void)glyph_empty;
 
     int x0, y0, x1, y1;
-    stbtt_GetGlyphBitmapBox(&font->info, glyph_index, font->scale, font->scale, &x0, &y0, &x1, &y1);
+    stbtt_GetGlyphBitmapBox(&font->info, glyph_index, font->raster.scale, font->raster.scale, &x0, &y0, &x1, &y1);
+    bool empty = x1 <= x0 || y1 <= y0;
+
+    // NOTE(jesper): SDF glyphs have the distance field around them. Monospace cells get the padding on every side
+    // so that the glyph's position in the cell, and in turn the glyph grid encoding, is the same as for bitmaps
+    i32 pad = font->sdf ? FONT_SDF_PADDING : 0;
+    i32 cell_pad = font->mono_space ? pad : 0;
+    x0 -= pad; y0 -= pad;
+    x1 += pad; y1 += pad;
 
     i32 w = x1-x0;
     i32 h = y1-y0;
 
-    i32 dst_w = font->mono_space ? font->space_width : w;
-    i32 dst_h = font->mono_space ? font->line_height : h;
+    i32 dst_w = font->mono_space ? font->raster.space_width + 2*pad : w;
+    i32 dst_h = font->mono_space ? font->raster.line_height + 2*pad : h;
 
     // NOTE(jesper): need to align to 4 for the glTexSubImage2D. The alignment
     // probably needs to be queries from the API somehow, I don't know
     i32 wa = ROUND_TO(dst_w, 4);
     i32 ha = ROUND_TO(dst_h, 4);
 
-    u8 *pixels = (u8*)ALLOC(*scratch, wa*ha);
-    memset(pixels, 0, wa*ha);
-    stbtt_MakeGlyphBitmap(&font->info, pixels, w, h, wa, font->scale, font->scale, glyph_index);
-
-    i32 xoff = x0, yoff = font->baseline+y0;
-    i32 x = font->current.x, y = font->current.y;
-    i32 dst_x = x;
-    i32 dst_y = y;
+    i32 xoff = x0 + cell_pad, yoff = font->raster.baseline + y0 + cell_pad;
 
     // TODO(jesper): we need to better handle funkier glyphs in monospace fonts better. This rendering
     // path relies on a glyph not going outside its bounds, but they can, because fonts are fun
@@ -103,68 +491,109 @@ Glyph find_or_create_glyph(FontAtlas *font, u32 codepoint) EXPORT
     if (font->mono_space) {
         xoff = MAX(0, xoff);
         yoff = MAX(0, yoff);
+    }
+
+    // NOTE(jesper): the extent of the upload relative to the glyph's position in the atlas
+    i32 extent_x = font->mono_space ? xoff+wa : wa;
+    i32 extent_y = font->mono_space ? yoff+ha : ha;
+
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(&font->info, glyph_index, &advance, &lsb);
 
-        dst_x = x+xoff;
-        dst_y = y+yoff;
+    if (extent_x > font->size.x || extent_y > font->size.y) {
+        LOG_ERROR("glyph 0x%x is too large for the font atlas", codepoint);
+        return { .codepoint = codepoint, .advance = font->raster.scale*advance, .page = -1 };
     }
 
-    if (dst_x + wa >= font->size.x) {
-        font->current.x = x = 0;
-        font->current.y = y = font->current.y+font->current_row_height;
-        font->current_row_height = 0;
+    FontAtlasPage *page = &font->pages[font->current_page];
+    if (page->current.x + extent_x > font->size.x) {
+        page->current.x = 0;
+        page->current.y += page->current_row_height;
+        page->current_row_height = 0;
+    }
 
-        dst_x = font->mono_space ? x+xoff : x;
-        dst_y = font->mono_space ? y+yoff : y;
+    if (page->current.y + extent_y > font->size.y) {
+        // NOTE(jesper): not cached, so that it's tried again next frame when pages can be evicted
+        if (!font_atlas_next_page(font)) return { .codepoint = codepoint, .advance = font->raster.scale*advance, .page = -1 };
+        page = &font->pages[font->current_page];
     }
-    ASSERT(font->current.y < font->size.y);
 
-    glTextureSubImage2D(font->texture, 0, dst_x, dst_y, wa, ha, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    i32 x = page->current.x, y = page->current.y;
+    i32 dst_x = font->mono_space ? x+xoff : x;
+    i32 dst_y = font->mono_space ? y+yoff : y;
 
-    font->current.x += dst_w;
-    font->current_row_height = MAX(font->current_row_height, dst_h);
+    GlyphRasterJob job{
+        .font = font,
+        .info = &font->info,
+        .scale = font->raster.scale,
+        .glyph_index = glyph_index,
+        .sdf = font->sdf,
+        .x0 = x0, .y0 = y0,
+        .w = w, .h = h,
+        .wa = wa, .ha = ha,
+        .page = font->current_page,
+        .page_generation = page->generation,
+        .dst_x = dst_x, .dst_y = dst_y,
+    };
 
-    if (font->mono_space) {
-        x0 = 0; x1 = font->space_width;
-        y0 = 0; y1 = font->line_height;
+    // NOTE(jesper): the slot is already cleared, so there's nothing to rasterize for empty glyphs
+    if (!empty) {
+        if (font->async_raster) {
+            font_queue_glyph(job);
+        } else {
+            SArena scratch = tl_scratch_arena();
+            job.pixels = ALLOC_ARR(*scratch, u8, wa*ha);
+            font_rasterize_glyph(&job);
+
+            GfxTextureUpload upload{
+                .texture = font->texture,
+                .x = dst_x, .y = dst_y, .layer = job.page,
+                .width = wa, .height = ha,
+                .pixels = job.pixels,
+            };
+            gfx_upload_texture_layers(&upload, 1);
+        }
     }
 
-    int advance, lsb;
-    stbtt_GetGlyphHMetrics(&font->info, glyph_index, &advance, &lsb);
+    page->current.x += dst_w;
+    page->current_row_height = MAX(page->current_row_height, dst_h);
+    page->last_used = font_frame;
+
+    if (font->mono_space) {
+        x0 = 0; x1 = font->raster.space_width;
+        y0 = 0; y1 = font->raster.line_height;
+    }
 
 #if 0
     LOG_RAW("------- '%c (0x%x)' -------\n", codepoint < 128 ? codepoint : 0, codepoint);
     LOG_RAW("x0: %d, y0: %d, x1: %d, y1: %d\n", x0, y0, x1, y1);
     LOG_RAW("x: %d, y: %d, w: %d, h: %d, wa: %d, ha: %d\n", x, y, w, h, wa, ha);
-    for (i32 j = 0; j < h; j++) {
-        for (i32 i = 0; i < w; i++) {
-            LOG_RAW("%c", " .:ioVM@"[pixels[j*wa+i]>>5]);
-        }
-        LOG_RAW("\n");
-    }
-
-    LOG_RAW("\n");
 #endif
 
     Glyph glyph{
         .codepoint = codepoint,
-        .advance = font->scale*advance,
-        .x0 = x,       .y0 = y,
-        .x1 = x+dst_w, .y1 = y+dst_h,
-        .xoff = x0,    .yoff = y0,
+        .advance = font->raster.scale*advance,
+        .x0 = x+cell_pad,         .y0 = y+cell_pad,
+        .x1 = x+dst_w-cell_pad,   .y1 = y+dst_h-cell_pad,
+        .xoff = x0,               .yoff = y0,
+        .page = font->current_page,
+        .page_generation = page->generation,
     };
     map_set(&font->glyphs, glyph_index, glyph);
+    font_glyph_cache_set(font, glyph);
     return glyph;
 }
 
 f32 glyph_advance(FontAtlas *font, u32 codepoint)
 {
     Glyph glyph = find_or_create_glyph(font, codepoint);
-    return glyph.advance;
+    return glyph.advance * font->scale / font->raster.scale;
 }
 
 GlyphRect get_glyph_rect(FontAtlas *font, u32 codepoint, Vector2 *pen)
 {
     Glyph glyph = find_or_create_glyph(font, codepoint);
+    f32 k = font->scale / font->raster.scale;
 
     f32 iuv_x = 1.0f / font->size.x;
     f32 iuv_y = 1.0f / font->size.y;
@@ -172,18 +601,20 @@ GlyphRect get_glyph_rect(FontAtlas *font, u32 codepoint, Vector2 *pen)
     f32 y0 = font->mono_space ? pen->y - font->baseline : pen->y;
 
     GlyphRect g{
-        .x0 = floorf((pen->x+(f32)glyph.xoff) + 0.5f),
-        .y0 = floorf((y0+(f32)glyph.yoff) + 0.5f),
-        .x1 = g.x0 + glyph.x1 - glyph.x0,
-        .y1 = g.y0 + glyph.y1 - glyph.y0,
+        .x0 = floorf((pen->x+glyph.xoff*k) + 0.5f),
+        .y0 = floorf((y0+glyph.yoff*k) + 0.5f),
+        .x1 = g.x0 + (glyph.x1 - glyph.x0)*k,
+        .y1 = g.y0 + (glyph.y1 - glyph.y0)*k,
 
         .s0 = glyph.x0*iuv_x,
         .t0 = glyph.y0*iuv_y,
         .s1 = glyph.x1*iuv_x,
         .t1 = glyph.y1*iuv_y,
+
+        .layer = (f32)MAX(glyph.page, 0),
     };
 
-    pen->x += glyph.advance;
+    pen->x += glyph.advance*k;
     return g;
 }
 
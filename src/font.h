@@ -10,7 +10,24 @@
 
 #include "core/string.h"
 #include "core/map.h"
-#include "gfx_opengl.h"
+#include "gfx.h"
+
+// NOTE(jesper): the atlas is a texture array of pages. Pages are added as they fill up, and the texture grows
+// to fit them, up to FONT_ATLAS_MAX_PAGES. Past that, the least recently used page is cleared and reused
+#define FONT_ATLAS_PAGE_SIZE 512
+#define FONT_ATLAS_MAX_PAGES 16
+
+// NOTE(jesper): glyphs of codepoints below FONT_DIRECT_GLYPHS are looked up directly by codepoint, the rest go
+// through an open-addressed cache that's cleared if it would grow past FONT_GLYPH_CACHE_MAX
+#define FONT_DIRECT_GLYPHS 0x800
+#define FONT_GLYPH_CACHE_MAX (64*1024)
+
+// NOTE(jesper): SDF fonts are rasterized once at FONT_SDF_RASTER_HEIGHT, with FONT_SDF_PADDING pixels of distance
+// field around each glyph, and can then be drawn at any size. The distance field is computed from a bitmap
+// rasterized at FONT_SDF_UPSAMPLE times the size
+#define FONT_SDF_RASTER_HEIGHT 32
+#define FONT_SDF_PADDING 4
+#define FONT_SDF_UPSAMPLE 4
 
 struct Glyph {
     u32 codepoint;
@@ -19,6 +36,10 @@ struct Glyph {
     i32 x0, y0;
     i32 x1, y1;
     i32 xoff, yoff;
+
+    // NOTE(jesper): -1 if there was no room for the glyph in the atlas, in which case it has an empty rect
+    i32 page;
+    u32 page_generation;
 };
 
 struct GlyphRect {
@@ -26,10 +47,28 @@ struct GlyphRect {
     f32 x1, y1;
     f32 s0, t0;
     f32 s1, t1;
+    f32 layer;
+};
+
+struct FontAtlasPage {
+    Vector2 current;
+    f32 current_row_height;
+
+    // NOTE(jesper): bumped when the page is evicted, invalidating the glyphs that were on it
+    u32 generation;
+    u64 last_used;
+};
+
+struct FontMetrics {
+    f32 scale;
+    f32 line_height;
+    f32 space_width;
+    i32 baseline;
 };
 
 struct FontAtlas {
-    GLuint texture;
+    GfxHandle texture;
+    i32 texture_pages;
 
     i32 ascent;
     i32 descent;
@@ -40,11 +79,38 @@ struct FontAtlas {
     f32 space_width;
 
     bool mono_space;
+    bool async_raster;
+    bool sdf;
+
+    // NOTE(jesper): the metrics of the glyphs in the atlas. The same as the ones above for bitmap fonts, whose
+    // glyphs are rasterized at the size they're drawn at, while glyph positions and advances have to be scaled
+    // by scale/raster.scale for SDF fonts
+    FontMetrics raster;
 
     stbtt_fontinfo info;
     Vector2 size;
-    Vector2 current;
-    f32 current_row_height;
+
+    DynamicArray<FontAtlasPage> pages;
+    i32 current_page;
+
+    // NOTE(jesper): bumped whenever a page is evicted, so that anything caching glyph positions, like the glyph
+    // grids of views, knows to re-encode them
+    u32 generation;
+
+    // NOTE(jesper): textures replaced by a larger one this frame. Commands recorded earlier in the frame may
+    // still refer to them, so they're deleted in the next one
+    DynamicArray<GfxHandle> retired_textures;
+    u64 frame;
+
+    // NOTE(jesper): glyphs by codepoint. An empty slot in the direct table has a page of -1, and one in the
+    // cache a codepoint of 0. Both are filled from the glyphs by glyph index below, so that stb_truetype is
+    // only reached the first time a codepoint is seen
+    Glyph *direct_glyphs;
+    struct {
+        Glyph *slots;
+        i32 capacity;
+        i32 count;
+    } glyph_cache;
 
     DynamicMap<i32 , Glyph> glyphs;
 };
@@ -56,7 +122,8 @@ struct GlyphsData {
     DynamicArray<GlyphRect> glyphs;
 };
 
-FontAtlas create_font(String path, f32 pixel_height, bool mono_space = false);
+FontAtlas create_font(String path, f32 pixel_height, bool mono_space = false, bool sdf = false);
+bool font_set_pixel_height(FontAtlas *font, f32 pixel_height);
 f32 glyph_advance(FontAtlas *font, u32 codepoint);
 GlyphRect get_glyph_rect(FontAtlas *font, u32 codepoint, Vector2 *pen);
 
@@ -4,6 +4,10 @@
 namespace PUBLIC {}
 using namespace PUBLIC;
 
+extern bool font_glyphs_pending();
+extern bool font_begin_frame();
+extern f32 font_texel_scale(FontAtlas *font);
+extern f32 font_sdf_width(FontAtlas *font);
 extern Glyph find_or_create_glyph(FontAtlas *font, u32 codepoint);
 extern GlyphsData calc_glyphs_data(String text, FontAtlas *font, Allocator mem);
 extern DynamicArray<GlyphRect> calc_glyph_rects(String text, FontAtlas *font, Allocator mem);
@@ -0,0 +1,23 @@
+#ifndef GFX_PUBLIC_H
+#define GFX_PUBLIC_H
+
+namespace PUBLIC {}
+using namespace PUBLIC;
+
+extern void *gfx_stream_push(GfxStream *stream, i32 count);
+extern i32 gfx_stream_add(GfxStream *stream, const void *elements, i32 count);
+extern bool gfx_merge_quads(GfxCommand *dst, GfxCommand src);
+extern void gfx_push_command(GfxCommand cmd, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_square(Vector2 center, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_rect(Vector2 tl, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_square(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_square(Vector2 center, Vector2 size, Vector2 uv_tl, Vector2 uv_br, GfxHandle texture, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_line(Vector2 a, Vector2 b, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_line_loop(Vector2 *points, i32 num_points, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_line_square(Vector2 center, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_draw_line_rect(Vector2 tl, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf);
+extern void gfx_reset_command_buffer(GfxCommandBuffer *cmdbuf);
+extern GfxCommandBuffer gfx_command_buffer();
+
+#endif // GFX_PUBLIC_H
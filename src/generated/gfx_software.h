@@ -0,0 +1,27 @@
+#ifndef GFX_SOFTWARE_PUBLIC_H
+#define GFX_SOFTWARE_PUBLIC_H
+
+namespace PUBLIC {}
+using namespace PUBLIC;
+
+extern void gfx_wait_fence(GfxFence *fence);
+extern GfxHandle gfx_create_mapped_buffer(i64 size, void **mapped);
+extern void gfx_destroy_mapped_buffer(GfxHandle buffer);
+extern void gfx_create_stream(GfxStream *stream, i32 stride, i32 capacity);
+extern void gfx_stream_begin_frame(GfxStream *stream);
+extern void gfx_stream_rewrite(GfxStream *stream);
+extern void init_gfx(Vector2 resolution);
+extern bool gfx_change_resolution(Vector2 resolution);
+extern void gfx_begin_frame();
+extern void gfx_end_frame();
+extern void gfx_clear(Vector3 color);
+extern void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view);
+extern GfxHandle gfx_create_texture(void *pixel_data, i32 width, i32 height);
+extern GfxHandle gfx_create_texture_array(i32 width, i32 height, i32 layers, bool linear);
+extern void gfx_copy_texture_layers(GfxHandle src, GfxHandle dst, i32 width, i32 height, i32 layers);
+extern void gfx_clear_texture_layer(GfxHandle texture, i32 layer, i32 width, i32 height);
+extern void gfx_upload_texture_layers(GfxTextureUpload *uploads, i32 count);
+extern void gfx_destroy_texture(GfxHandle texture);
+extern bool gfx_write_snapshot(String path);
+
+#endif // GFX_SOFTWARE_PUBLIC_H
@@ -4,6 +4,10 @@
 namespace PUBLIC {}
 using namespace PUBLIC;
 
+extern bool gui_draw_list_overflowed(GuiDrawList *list);
+extern void gui_begin_draw_list(GuiDrawList *list);
+extern void gui_end_draw_list();
+extern void gui_submit_draw_list(GuiDrawList *list, Matrix3 view);
 extern void gui_push_layout(LayoutRect rect);
 extern void gui_pop_layout();
 extern LayoutRect *gui_current_layout();
@@ -35,7 +39,7 @@ extern LayoutRect split_bottom(LayoutRect *layout, SplitDesc desc);
 extern LayoutRect split_col(LayoutRect *layout, SplitDesc desc);
 extern LayoutRect split_row(LayoutRect *layout, SplitDesc desc);
 extern LayoutRect split_rect(LayoutRect *layout, SplitDesc desc);
-extern void init_gui();
+extern void init_gui(bool sdf_fonts);
 extern GuiWindow *gui_current_window();
 extern bool gui_input_layer(GuiId id, InputMapId map_id);
 extern void gui_drag_start(Vector2 data0, Vector2 data1);
@@ -47,6 +51,9 @@ extern void gui_clear_hot();
 extern bool gui_pressed(GuiId id);
 extern bool gui_clicked(GuiId id, Rect rect);
 extern bool gui_drag(GuiId id, Vector2 data0, Vector2 data1, f32 min_drag);
+extern void gui_damage_window(GuiId id);
+extern void gui_damage_windows();
+extern bool gui_needs_redraw();
 extern void gui_begin_frame();
 extern void gui_end_frame();
 extern void gui_render();
@@ -1,6 +1,15 @@
 #ifndef GFX_OPENGL_INTERNAL_H
 #define GFX_OPENGL_INTERNAL_H
 
+static void gfx_use_program(GLuint program);
+static void gfx_bind_vertex_array(GLuint vao);
+static void gfx_bind_array_buffer(GLuint vbo);
+static void gfx_bind_texture(GLenum target, GLuint texture);
+static void gfx_polygon_mode(GLenum mode);
+static void gfx_wait_stream_fence(i32 frame);
+static void gfx_stream_grow(GfxStream *stream);
+static void gfx_stream_set_region(GfxStream *stream, i32 region);
+static i64 gfx_stream_base(GLuint vbo);
 static bool gfx_link_program(GfxProgram *program);
 static void gl_debug_proc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *);
 
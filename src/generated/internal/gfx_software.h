@@ -0,0 +1,24 @@
+#ifndef GFX_SOFTWARE_INTERNAL_H
+#define GFX_SOFTWARE_INTERNAL_H
+
+static GfxHandle gfx_sw_add_buffer(u8 *data, i64 size);
+static u8 *gfx_sw_buffer_data(GfxHandle buffer);
+static void gfx_sw_destroy_buffer(GfxHandle buffer);
+static GfxHandle gfx_sw_add_texture(GfxSwTexture texture);
+static GfxSwTexture *gfx_sw_texture(GfxHandle texture);
+static u32 gfx_sw_pack(f32 r, f32 g, f32 b);
+static u32 gfx_sw_div255(u32 x);
+static u32 gfx_sw_blend(u32 dst, u32 src, u32 alpha);
+static void gfx_sw_blend_span(u32 *dst, i32 count, u32 color, const u8 *coverage);
+static void gfx_sw_pixel_range(f32 p0, f32 p1, i32 size, i32 *first, i32 *end);
+static Vector2 gfx_sw_screen_from_ws(Matrix3 view, f32 x, f32 y);
+static f32 gfx_sw_edge(Vector2 a, Vector2 b, Vector2 p);
+static u32 gfx_sw_fetch_rgba(GfxSwTexture *texture, f32 s, f32 t);
+static f32 gfx_sw_sample_r8(GfxSwTexture *texture, i32 layer, f32 s, f32 t);
+static f32 gfx_sw_sdf_coverage(f32 a, f32 sdf_width);
+static void gfx_sw_draw_triangles(f32 *vertices, i32 vertex_count, GfxSwTexture *texture, Matrix3 view);
+static void gfx_sw_draw_lines(f32 *vertices, i32 vertex_count, Matrix3 view);
+static void gfx_sw_draw_quads(GfxCommand cmd);
+static void gfx_sw_draw_mono_text(GfxCommand cmd);
+
+#endif // GFX_SOFTWARE_INTERNAL_H
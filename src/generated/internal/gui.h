@@ -5,7 +5,9 @@ static bool gui_is_parent(GuiId id);
 static i32 gui_push_overlay(Rect rect, bool active);
 static void gui_push_command_buffer();
 static void gui_pop_command_buffer(GfxCommandBuffer *dst);
-static GfxCommand gui_command(GfxCommandType type);
+static GuiDrawList *gui_draw_target();
+static void gui_reset_draw_list(GuiDrawList *list);
+static GfxCommand gui_command(GfxCommandType type, GuiDrawList *list);
 static void gui_push_command(GfxCommandBuffer *cmdbuf, GfxCommand cmd);
 static LayoutRect make_layout_rect(SplitDesc desc, Rect rect);
 static LayoutRect split_row_internal(LayoutRect *layout, SplitDesc desc);
@@ -16,13 +18,19 @@ static void gui_handle_focus_grabbing(GuiId id);
 static void clear_focus();
 static bool apply_clip_rect(GlyphRect *g, Rect *clip_rect);
 static bool apply_clip_rect(Rect *rect, Rect *clip_rect);
+static bool gui_fonts_changed();
+static bool gui_window_needs_rebuild(GuiWindow *wnd);
+static void gui_rebuild_window(GuiWindow *wnd);
 static GuiWindow *push_window_to_top(i32 index);
 static i32 gui_find_or_create_window_index(GuiId id, GuiWindowDesc desc);
 static bool gui_begin_window_internal(GuiId id, String title, i32 wnd_index);
+static GfxCommandBuffer *gui_gizmo_command_buffer();
 static void gui_push_clip_rect(Rect rect);
 static void gui_pop_clip_rect();
 static void gui_draw_button(Rect rect, Vector3 btn_bg, Vector3 btn_bg_acc0, Vector3 btn_bg_acc1);
 static void gui_draw_icon_button(GuiId id, String icon, Rect rect);
 static void gui_draw_icon(String icon, Rect rect);
+static void gui_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color);
+static GfxQuad gui_glyph_quad(GlyphRect g, Vector2 atlas_size, u32 color);
 
 #endif // GUI_INTERNAL_H
@@ -2,10 +2,11 @@
 #define MIMIR_INTERNAL_H
 
 static u32 hash32(BufferId buffer, u32 seed = MURMUR3_SEED);
-static void ts_parse_buffer(Buffer *buffer, TSInputEdit edit);
+static void ts_parse_buffer(Buffer *buffer);
 static void lsp_open(LspConnection *lsp, BufferId buffer_id, String language_id, String content);
-static i32 line_from_offset(i64 offset, Array<i64> offsets, i32 guessed_line = 0);
+static bool headless_work_pending();
+static int app_run_headless(Array<String> args);
 static void app_gather_input(AppWindow *wnd);
-static void update_and_render();
+static bool update_and_render();
 
 #endif // MIMIR_INTERNAL_H
@@ -0,0 +1,12 @@
+#ifndef JOBS_PUBLIC_H
+#define JOBS_PUBLIC_H
+
+namespace PUBLIC {}
+using namespace PUBLIC;
+
+extern JobPool *get_job_pool();
+extern void run_jobs(Array<Job> jobs);
+extern void submit_job(Job job);
+extern void shutdown_job_pool();
+
+#endif // JOBS_PUBLIC_H
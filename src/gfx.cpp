@@ -0,0 +1,412 @@
+#include "gfx.h"
+
+#include "core/assets.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ASSERT(x) ASSERT(x)
+#include "stb/stb_image.h"
+
+extern Allocator mem_frame;
+
+GfxContext gfx{};
+
+// NOTE(jesper): returns room for count elements in the current region, or nullptr if it's full, in which case the
+// geometry is dropped and the stream grows the next time it begins a frame or is rewritten. Whoever draws from it
+// has to check overflowed and draw again, or what's on screen is missing the geometry until something else changes
+void* gfx_stream_push(GfxStream *stream, i32 count) EXPORT
+{
+    if (stream->count + count > stream->capacity) {
+        if (!stream->overflowed) {
+            LOG_ERROR("gfx stream out of room: %d elements, capacity %d", stream->count + count, stream->capacity);
+        }
+
+        stream->overflowed = true;
+        return nullptr;
+    }
+
+    void *dst = stream->data + (i64)stream->count * stream->stride;
+    stream->count += count;
+    return dst;
+}
+
+// NOTE(jesper): returns the offset of the first element added, or -1 if the stream is full
+i32 gfx_stream_add(GfxStream *stream, const void *elements, i32 count) EXPORT
+{
+    i32 offset = stream->count;
+
+    void *dst = gfx_stream_push(stream, count);
+    if (!dst) return -1;
+
+    memcpy(dst, elements, (i64)count * stream->stride);
+    return offset;
+}
+
+// NOTE(jesper): solid quads don't sample, so they can join a batch of any texture
+bool gfx_merge_quads(GfxCommand *dst, GfxCommand src) EXPORT
+{
+    if (dst->quads.vbo != src.quads.vbo) return false;
+    if (dst->quads.offset + dst->quads.count != src.quads.offset) return false;
+    if (dst->quads.texture && src.quads.texture) {
+        if (dst->quads.texture != src.quads.texture) return false;
+        if (dst->quads.texel_scale != src.quads.texel_scale) return false;
+        if (dst->quads.sdf_width != src.quads.sdf_width) return false;
+    }
+
+    // NOTE(jesper): solid quads don't sample the atlas, so they take on the parameters of the textured ones
+    if (!dst->quads.texture) {
+        dst->quads.texture = src.quads.texture;
+        dst->quads.texel_scale = src.quads.texel_scale;
+        dst->quads.sdf_width = src.quads.sdf_width;
+    }
+
+    dst->quads.count += src.quads.count;
+    return true;
+}
+
+void gfx_push_command(GfxCommand cmd, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    if (auto *last = array_tail(cmdbuf->commands);
+        last && cmd.type == last->type)
+    {
+        switch (cmd.type) {
+        case GFX_COMMAND_COLORED_PRIM:
+        case GFX_COMMAND_COLORED_LINE:
+            if (last->colored_prim.vbo == cmd.colored_prim.vbo &&
+                (last->colored_prim.vbo_offset+(last->colored_prim.vertex_count*6))  == cmd.colored_prim.vbo_offset)
+            {
+                last->colored_prim.vertex_count += cmd.colored_prim.vertex_count;
+                return;
+            }
+            break;
+        case GFX_COMMAND_TEXTURED_PRIM:
+            if (last->textured_prim.texture == cmd.textured_prim.texture &&
+                last->textured_prim.vbo == cmd.textured_prim.vbo &&
+                last->textured_prim.vbo_offset+last->textured_prim.vertex_count*4 == cmd.textured_prim.vbo_offset)
+            {
+                last->textured_prim.vertex_count += cmd.textured_prim.vertex_count;
+                return;
+            }
+            break;
+        case GFX_COMMAND_QUADS:
+            if (gfx_merge_quads(last, cmd)) return;
+            break;
+        case GFX_COMMAND_MONO_TEXT:
+        case GFX_COMMAND_GUI_PRIM_TEXTURE:
+            break;
+        }
+    }
+
+    array_add(&cmdbuf->commands, cmd);
+}
+
+void gfx_draw_square(Vector2 center, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    color = linear_from_sRGB(color);
+
+    f32 left = center.x - size.x*0.5f;
+    f32 right = center.x + size.x*0.5f;
+    f32 top = center.y - size.y*0.5f;
+    f32 bottom = center.y + size.y*0.5f;
+
+    f32 vertices[] = {
+        right, top, color.r, color.g, color.b, color.a,
+        left, top, color.r, color.g, color.b, color.a,
+        left, bottom, color.r, color.g, color.b, color.a,
+
+        left, bottom, color.r, color.g, color.b, color.a,
+        right, bottom, color.r, color.g, color.b, color.a,
+        right, top, color.r, color.g, color.b, color.a,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_PRIM;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 6;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_rect(
+        Vector2 tl,
+        Vector2 size,
+        Vector4 color,
+        GfxCommandBuffer *cmdbuf) EXPORT
+{
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        tl.x+size.x, tl.y,        color.r, color.g, color.b, color.a,
+        tl.x,        tl.y,        color.r, color.g, color.b, color.a,
+        tl.x,        tl.y+size.y, color.r, color.g, color.b, color.a,
+
+        tl.x,        tl.y+size.y, color.r, color.g, color.b, color.a,
+        tl.x+size.x, tl.y+size.y, color.r, color.g, color.b, color.a,
+        tl.x+size.x, tl.y,        color.r, color.g, color.b, color.a,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_PRIM;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 6;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_square(
+    Vector2 p0,
+    Vector2 p1,
+    Vector2 p2,
+    Vector2 p3,
+    Vector3 color,
+    GfxCommandBuffer *cmdbuf) EXPORT
+{
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
+        p1.x, p1.y, color.r, color.g, color.b, 1.0f,
+        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
+
+        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
+        p3.x, p3.y, color.r, color.g, color.b, 1.0f,
+        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_PRIM;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 6;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_square(
+    Vector2 center,
+    Vector2 size,
+    Vector2 uv_tl,
+    Vector2 uv_br,
+    GfxHandle texture,
+    GfxCommandBuffer *cmdbuf) EXPORT
+{
+    f32 left = center.x - size.x*0.5f;
+    f32 right = center.x + size.x*0.5f;
+    f32 top = center.y - size.y*0.5f;
+    f32 bottom = center.y + size.y*0.5f;
+
+    f32 vertices[] = {
+        right, top, uv_br.x, uv_tl.y,
+        left, top, uv_tl.x, uv_tl.y,
+        left, bottom, uv_tl.x, uv_br.y,
+
+        left, bottom, uv_tl.x, uv_br.y,
+        right, bottom, uv_br.x, uv_br.y,
+        right, top, uv_br.x, uv_tl.y,
+    };
+
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd{
+        .type = GFX_COMMAND_TEXTURED_PRIM,
+        .textured_prim.vbo = gfx.frame_vertices.vbo,
+        .textured_prim.vbo_offset = offset,
+        .textured_prim.texture = texture,
+        .textured_prim.vertex_count = 6,
+    };
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
+        p1.x, p1.y, color.r, color.g, color.b, 1.0f,
+        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_PRIM;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 3;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+
+void gfx_draw_line(Vector2 a, Vector2 b, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        a.x, a.y, color.r, color.g, color.b, 1.0f,
+        b.x, b.y, color.r, color.g, color.b, 1.0f,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_LINE;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 2;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_line_loop(Vector2 *points, i32 num_points, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    i32 offset = gfx.frame_vertices.count;
+
+    f32 *dst = (f32*)gfx_stream_push(&gfx.frame_vertices, num_points*2*6);
+    if (!dst) return;
+
+    color = linear_from_sRGB(color);
+
+    for (i32 i = 0; i < num_points; i++) {
+        Vector2 a = points[i];
+        Vector2 b = points[(i+1) % num_points];
+
+        f32 vertices[] = {
+            a.x, a.y, color.r, color.g, color.b, 1.0f,
+            b.x, b.y, color.r, color.g, color.b, 1.0f,
+        };
+        memcpy(dst, vertices, sizeof vertices);
+        dst += ARRAY_COUNT(vertices);
+    }
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_LINE;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = num_points*2;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+
+void gfx_draw_line_square(Vector2 center, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    f32 left = center.x - size.x*0.5f;
+    f32 right = center.x + size.x*0.5f;
+    f32 top = center.y - size.y*0.5f;
+    f32 bottom = center.y + size.y*0.5f;
+
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        // ---
+        left, top, color.r, color.g, color.b, 1.0f,
+        right, top, color.r, color.g, color.b, 1.0f,
+
+        //   |
+        right, top, color.r, color.g, color.b, 1.0f,
+        right, bottom, color.r, color.g, color.b, 1.0f,
+
+        // ___
+        right, bottom, color.r, color.g, color.b, 1.0f,
+        left, bottom, color.r, color.g, color.b, 1.0f,
+
+        // |
+        left, bottom, color.r, color.g, color.b, 1.0f,
+        left, top, color.r, color.g, color.b, 1.0f,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_LINE;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 8;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_draw_line_rect(Vector2 tl, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
+{
+    f32 left = tl.x;
+    f32 right = tl.x + size.x;
+    f32 top = tl.y;
+    f32 bottom = tl.y + size.y;
+
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        // ---
+        left, top, color.r, color.g, color.b, 1.0f,
+        right, top, color.r, color.g, color.b, 1.0f,
+
+        //   |
+        right, top, color.r, color.g, color.b, 1.0f,
+        right, bottom, color.r, color.g, color.b, 1.0f,
+
+        // ___
+        right, bottom - 1, color.r, color.g, color.b, 1.0f,
+        left, bottom - 1, color.r, color.g, color.b, 1.0f,
+
+        // |
+        left, bottom, color.r, color.g, color.b, 1.0f,
+        left, top, color.r, color.g, color.b, 1.0f,
+    };
+    i32 offset = gfx_stream_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
+    if (offset < 0) return;
+
+    GfxCommand cmd;
+    cmd.type = GFX_COMMAND_COLORED_LINE;
+    cmd.colored_prim.vbo = gfx.frame_vertices.vbo;
+    cmd.colored_prim.vbo_offset = offset;
+    cmd.colored_prim.vertex_count = 8;
+    gfx_push_command(cmd, cmdbuf);
+}
+
+void gfx_reset_command_buffer(GfxCommandBuffer *cmdbuf) EXPORT
+{
+    array_reset(&cmdbuf->commands, cmdbuf->commands.count);
+}
+
+GfxCommandBuffer gfx_command_buffer() EXPORT
+{
+    GfxCommandBuffer cmd{ .commands.alloc = mem_frame };
+    return cmd;
+}
+
+// ----------------------------------------
+// GFX_ASSETS
+// ----------------------------------------
+void* gfx_load_texture_asset(AssetHandle /*handle*/, void *existing, String /*identifier*/, u8 *data, i32 size)
+{
+    i32 width, height, num_channels;
+    u8 *pixel_data = stbi_load_from_memory(data, size, &width, &height, &num_channels, 4);
+
+    if (!pixel_data) {
+        LOG_ERROR("failed to load texture: %s", stbi_failure_reason());
+        return nullptr;
+    }
+
+    GfxHandle object = gfx_create_texture(pixel_data, width, height);
+    stbi_image_free(pixel_data);
+
+    if (!object) {
+        LOG_ERROR("failed to create texture");
+        return nullptr;
+    }
+
+    if (existing) {
+        TextureAsset *texture = (TextureAsset*)existing;
+        gfx_destroy_texture(texture->texture_handle);
+        texture->texture_handle = object;
+        return texture;
+    }
+
+    return ALLOC_T(mem_dynamic, TextureAsset) {
+        .texture_handle = object,
+    };
+}
+
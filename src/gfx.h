@@ -0,0 +1,175 @@
+#ifndef GFX_H
+#define GFX_H
+
+#include "core/maths.h"
+#include "core/array.h"
+
+// NOTE(jesper): handles of the backend's buffer, texture and shader objects. The OpenGL backend uses the GL object
+// names, the software backend indexes its own tables. Fences are GLsync objects or, for the software backend,
+// never set since nothing is in flight
+typedef u32 GfxHandle;
+typedef struct GfxFenceObject *GfxFence;
+
+struct GfxProgram;
+
+struct TextureAsset {
+    GfxHandle texture_handle;
+};
+
+struct ShaderAsset {
+    GfxHandle object;
+    i32 stage;
+
+    DynamicArray<GfxProgram*> used_by;
+};
+
+// NOTE(jesper): one instance per screen-space quad, expanded into a triangle strip by the vertex shader. uv is
+// the atlas texel of the quad's top left corner, s and t in the low 24 bits and the layer in the top 8, and
+// the quad covers the texel_scale of its command texels per pixel. Solid quads set it to GFX_QUAD_SOLID and only
+// use the color, which is bgr packed
+#define GFX_QUAD_SOLID 0xFFFFFFFF
+
+struct GfxQuad {
+    f32 x0, y0;
+    f32 x1, y1;
+    u32 uv;
+    u32 color;
+};
+
+static_assert(sizeof(GfxQuad) == 24);
+
+enum GfxCommandType {
+    GFX_COMMAND_COLORED_LINE,
+    GFX_COMMAND_COLORED_PRIM,
+    GFX_COMMAND_TEXTURED_PRIM,
+    GFX_COMMAND_GUI_PRIM_TEXTURE,
+    GFX_COMMAND_QUADS,
+    GFX_COMMAND_MONO_TEXT,
+};
+
+struct GfxCommand {
+    GfxCommandType type;
+    union {
+        struct {
+            GfxHandle vbo;
+            i32 vbo_offset;
+            i32 vertex_count;
+        } colored_prim;
+        struct {
+            GfxHandle vbo;
+            i32 vbo_offset;
+            i32 vertex_count;
+            GfxHandle texture;
+        } textured_prim;
+        struct {
+            GfxHandle vbo;
+            GfxHandle texture;
+            i32 vbo_offset;
+            i32 vertex_count;
+        } gui_prim_texture;
+        struct {
+            GfxHandle vbo;
+            GfxHandle texture;
+            i32 offset;
+            i32 count;
+
+            // NOTE(jesper): atlas texels per pixel, which is 1 for fonts rasterized at the size they're drawn at.
+            // For SDF atlases, sdf_width is the distance the edge is smoothed over, and 0 otherwise
+            f32 texel_scale;
+            f32 sdf_width;
+        } quads;
+        struct {
+            GfxHandle vbo;
+            i32 vbo_offset;
+            GfxHandle glyph_ssbo;
+            GfxFence *fence;
+            GfxHandle glyph_atlas;
+            Vector2 cell_size;
+            Vector2 atlas_cell_size;
+            f32 sdf_width;
+            Vector2 pos;
+            f32 offset;
+            i32 line_offset;
+            i32 columns;
+            i32 rows;
+        } mono_text;
+    };
+};
+
+struct GfxCommandBuffer {
+    DynamicArray<GfxCommand> commands;
+};
+
+// NOTE(jesper): a persistently mapped buffer split into one region per frame in flight, which geometry is written
+// straight into. Offsets and counts are in elements of stride bytes relative to the current region, and the
+// submitter adds the region's base when it binds the buffer. A region is only rewritten once the fence of the
+// frame that last drew from it has signalled. Streams move to the current frame's region in gfx_stream_begin_frame,
+// or to their next region in gfx_stream_rewrite
+#define GFX_STREAM_FRAMES 3
+
+struct GfxStream {
+    GfxHandle vbo;
+    u8 *mapped;
+    u8 *data;
+    i64 base;
+    i32 region;
+    i32 stride;
+    i32 capacity;
+    i32 count;
+    bool overflowed;
+};
+
+// NOTE(jesper): a sub-rectangle of one layer of a single channel texture array, used for the glyph atlases
+struct GfxTextureUpload {
+    GfxHandle texture;
+    i32 x, y, layer;
+    i32 width, height;
+    const u8 *pixels;
+};
+
+struct GfxContext {
+    DynamicArray<GfxStream*> streams;
+    i32 stream_frame;
+    GfxFence stream_fences[GFX_STREAM_FRAMES];
+
+    GfxCommandBuffer frame_cmdbuf;
+    GfxStream frame_vertices;
+    Vector2 resolution;
+};
+
+extern GfxContext gfx;
+
+struct Camera2 {
+    Matrix3 projection;
+    Vector2 position;
+    f32 uni_scale = 1.0f;
+};
+
+struct Camera3 {
+    Matrix4 projection;
+    Vector3 position;
+    f32 uni_scale = 1.0f;
+};
+
+#include "generated/gfx.h"
+#if defined(GFX_SOFTWARE)
+#include "generated/gfx_software.h"
+#else
+#include "generated/gfx_opengl.h"
+#endif
+
+
+void gfx_push_command(GfxCommand cmd, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_square(Vector2 center, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_square(Vector2 center, Vector2 size, Vector2 uv_tl, Vector2 uv_br, GfxHandle texture, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_square(Vector2 p0,  Vector2 p1,  Vector2 p2, Vector2 p3, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_rect(Vector2 tl, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+
+void gfx_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+
+void gfx_draw_line(Vector2 a, Vector2 b, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_line_square(Vector2 center, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_line_rect(Vector2 tl, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+void gfx_draw_line_loop(Vector2 *points, i32 num_points, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+
+#endif // GFX_H
@@ -3,46 +3,138 @@
 
 #include "core/assets.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ASSERT(x) ASSERT(x)
-#include "stb/stb_image.h"
+GfxGlContext gfx_gl{};
 
-extern Allocator mem_frame;
+void gfx_use_program(GLuint program) INTERNAL
+{
+    if (gfx_gl.state.program == program) return;
+    glUseProgram(program);
+    gfx_gl.state.program = program;
+}
 
-GfxContext gfx{};
+void gfx_bind_vertex_array(GLuint vao) INTERNAL
+{
+    if (gfx_gl.state.vao == vao) return;
+    glBindVertexArray(vao);
+    gfx_gl.state.vao = vao;
+}
 
-void gfx_push_command(GfxCommand cmd, GfxCommandBuffer *cmdbuf) EXPORT
+void gfx_bind_array_buffer(GLuint vbo) INTERNAL
 {
-    if (auto *last = array_tail(cmdbuf->commands);
-        last && cmd.type == last->type)
-    {
-        switch (cmd.type) {
-        case GFX_COMMAND_COLORED_PRIM:
-        case GFX_COMMAND_COLORED_LINE:
-            if (last->colored_prim.vbo == cmd.colored_prim.vbo &&
-                (last->colored_prim.vbo_offset+(last->colored_prim.vertex_count*6))  == cmd.colored_prim.vbo_offset)
-            {
-                last->colored_prim.vertex_count += cmd.colored_prim.vertex_count;
-                return;
-            }
-            break;
-        case GFX_COMMAND_TEXTURED_PRIM:
-            if (last->textured_prim.texture == cmd.textured_prim.texture &&
-                last->textured_prim.vbo == cmd.textured_prim.vbo &&
-                last->textured_prim.vbo_offset+last->textured_prim.vertex_count*4 == cmd.textured_prim.vbo_offset)
-            {
-                last->textured_prim.vertex_count += cmd.textured_prim.vertex_count;
-                return;
-            }
-            break;
-        case GFX_COMMAND_MONO_TEXT:
-        case GFX_COMMAND_GUI_PRIM_TEXTURE:
-        case GFX_COMMAND_GUI_TEXT:
-            break;
-        }
-    }
+    if (gfx_gl.state.array_buffer == vbo) return;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    gfx_gl.state.array_buffer = vbo;
+}
+
+void gfx_bind_texture(GLenum target, GLuint texture) INTERNAL
+{
+    GLuint *bound = target == GL_TEXTURE_2D_ARRAY ? &gfx_gl.state.texture_2d_array : &gfx_gl.state.texture_2d;
+    if (*bound == texture) return;
+    glBindTexture(target, texture);
+    *bound = texture;
+}
+
+void gfx_polygon_mode(GLenum mode) INTERNAL
+{
+    if (gfx_gl.state.polygon_mode == mode) return;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    gfx_gl.state.polygon_mode = mode;
+}
+
+// NOTE(jesper): waits for the commands submitted before the fence to finish, and deletes it
+void gfx_wait_fence(GfxFence *fence) EXPORT
+{
+    if (!*fence) return;
+
+    glClientWaitSync((GLsync)*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100*1000*1000);
+    glDeleteSync((GLsync)*fence);
+    *fence = nullptr;
+}
+
+// NOTE(jesper): immutable storage that stays mapped for writing for as long as the buffer lives. Anything the GPU
+// is still reading from has to be fenced by the caller before it's rewritten
+GfxHandle gfx_create_mapped_buffer(i64 size, void **mapped) EXPORT
+{
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    GLuint buffer;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, size, nullptr, flags);
+    *mapped = glMapNamedBufferRange(buffer, 0, size, flags);
+    return buffer;
+}
+
+void gfx_destroy_mapped_buffer(GfxHandle buffer) EXPORT
+{
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+void gfx_create_stream(GfxStream *stream, i32 stride, i32 capacity) EXPORT
+{
+    i64 size = (i64)GFX_STREAM_FRAMES * capacity * stride;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &stream->vbo);
+    glNamedBufferStorage(stream->vbo, size, nullptr, flags);
+
+    stream->mapped = (u8*)glMapNamedBufferRange(stream->vbo, 0, size, flags);
+    stream->stride = stride;
+    stream->capacity = capacity;
+    stream->region = gfx.stream_frame;
+    stream->base = (i64)stream->region * capacity * stride;
+    stream->data = stream->mapped + stream->base;
+    stream->count = 0;
+    stream->overflowed = false;
+
+    if (array_find_index(gfx.streams, stream) == -1) array_add(&gfx.streams, stream);
+}
 
-    array_add(&cmdbuf->commands, cmd);
+void gfx_wait_stream_fence(i32 frame) INTERNAL
+{
+    gfx_wait_fence(&gfx.stream_fences[frame]);
+}
+
+// NOTE(jesper): a stream that ran out of room is recreated at twice the size. Every region of the old buffer could
+// still be in flight, so this waits for all of them
+void gfx_stream_grow(GfxStream *stream) INTERNAL
+{
+    for (i32 i = 0; i < GFX_STREAM_FRAMES; i++) gfx_wait_stream_fence(i);
+
+    glUnmapNamedBuffer(stream->vbo);
+    glDeleteBuffers(1, &stream->vbo);
+    gfx_create_stream(stream, stream->stride, stream->capacity*2);
+}
+
+void gfx_stream_set_region(GfxStream *stream, i32 region) INTERNAL
+{
+    stream->region = region;
+    stream->base = (i64)region * stream->capacity * stream->stride;
+    stream->data = stream->mapped + stream->base;
+    stream->count = 0;
+}
+
+void gfx_stream_begin_frame(GfxStream *stream) EXPORT
+{
+    if (stream->overflowed) gfx_stream_grow(stream);
+    gfx_stream_set_region(stream, gfx.stream_frame);
+}
+
+// NOTE(jesper): starts over in the next region of a stream whose contents are drawn on every frame until they're
+// rewritten, instead of being rewritten every frame. A stream is rewritten at most once a frame, so the region was
+// last drawn from before the two previous rewrites, in a frame that gfx_begin_frame has waited on
+void gfx_stream_rewrite(GfxStream *stream) EXPORT
+{
+    if (stream->overflowed) gfx_stream_grow(stream);
+    gfx_stream_set_region(stream, (stream->region+1) % GFX_STREAM_FRAMES);
+}
+
+i64 gfx_stream_base(GLuint vbo) INTERNAL
+{
+    for (GfxStream *stream : gfx.streams) {
+        if (stream->vbo == vbo) return stream->base;
+    }
+    return 0;
 }
 
 bool gfx_link_program(GfxProgram *program) INTERNAL
@@ -222,7 +314,7 @@ void init_gfx(Vector2 resolution) EXPORT
         glEnable(GL_DEBUG_OUTPUT);
     }
 
-    gfx.frame_vertices.alloc = mem_frame;
+    gfx_create_stream(&gfx.frame_vertices, sizeof(f32), 256*1024);
 
     glDebugMessageCallback(gl_debug_proc, nullptr);
     gfx_change_resolution(resolution);
@@ -231,7 +323,7 @@ void init_gfx(Vector2 resolution) EXPORT
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    gfx.shaders.global.cs_from_ws = 0;
+    gfx_gl.shaders.global.cs_from_ws = 0;
 
     {
         const char *vert = SHADER_HEADER
@@ -252,8 +344,8 @@ void init_gfx(Vector2 resolution) EXPORT
             "	out_color = vs_color;\n"
             "}\0";
 
-        gfx.shaders.pass2d.program = gfx_create_shader(vert, frag);
-        ASSERT(glGetUniformLocation(gfx.shaders.pass2d.program->object, "cs_from_ws") == gfx.shaders.global.cs_from_ws);
+        gfx_gl.shaders.pass2d.program = gfx_create_shader(vert, frag);
+        ASSERT(glGetUniformLocation(gfx_gl.shaders.pass2d.program->object, "cs_from_ws") == gfx_gl.shaders.global.cs_from_ws);
     }
 
     {
@@ -276,20 +368,21 @@ void init_gfx(Vector2 resolution) EXPORT
             "	out_color = vec4(texture(tex_sampler, vs_uv).rgba);\n"
             "}\0";
 
-        gfx.shaders.basic2d.program = gfx_create_shader(vert, frag);
-        ASSERT(glGetUniformLocation(gfx.shaders.basic2d.program->object, "cs_from_ws") == gfx.shaders.global.cs_from_ws);
+        gfx_gl.shaders.basic2d.program = gfx_create_shader(vert, frag);
+        ASSERT(glGetUniformLocation(gfx_gl.shaders.basic2d.program->object, "cs_from_ws") == gfx_gl.shaders.global.cs_from_ws);
     }
 
     {
-        gfx.shaders.gui_prim_texture.program = gfx_create_shader_program(
+        gfx_gl.shaders.gui_prim_texture.program = gfx_create_shader_program(
             "shaders/gui_prim_texture.vert.glsl",
             "shaders/gui_prim_texture.frag.glsl");
     }
 
     {
-        gfx.shaders.text.program = gfx_create_shader_program("shaders/text.vert.glsl", "shaders/text.frag.glsl");
-        gfx.shaders.text.resolution = glGetUniformLocation(gfx.shaders.text.program->object, "resolution");
-        gfx.shaders.text.color = glGetUniformLocation(gfx.shaders.text.program->object, "color");
+        gfx_gl.shaders.quads.program = gfx_create_shader_program("shaders/quad.vert.glsl", "shaders/quad.frag.glsl");
+        gfx_gl.shaders.quads.resolution = glGetUniformLocation(gfx_gl.shaders.quads.program->object, "resolution");
+        gfx_gl.shaders.quads.texel_scale = glGetUniformLocation(gfx_gl.shaders.quads.program->object, "texel_scale");
+        gfx_gl.shaders.quads.sdf_width = glGetUniformLocation(gfx_gl.shaders.quads.program->object, "sdf_width");
     }
 
     {
@@ -308,9 +401,12 @@ void init_gfx(Vector2 resolution) EXPORT
 
         const char *frag = SHADER_HEADER
             "in vec2 vs_pos;\n"
-            "uniform sampler2D glyph_atlas;\n"
+            "uniform sampler2DArray glyph_atlas;\n"
             "uniform vec2 cell_size;\n"
+            "uniform vec2 atlas_cell_size;\n"
+            "uniform float sdf_width;\n"
             "uniform int columns;\n"
+            "uniform int rows;\n"
             "uniform int line_offset;\n"
             "uniform vec2 pos;\n"
             "struct GlyphData {\n"
@@ -326,24 +422,33 @@ void init_gfx(Vector2 resolution) EXPORT
             "{\n"
             "	ivec2 cell_index = ivec2(vec2(vs_pos / cell_size));\n"
             "	vec2 cell_pos = vec2(mod(vs_pos, cell_size));\n"
-            "	GlyphData cell = glyph_data[cell_index.y*columns + cell_index.x];\n"
             "	vec4 color = vec4(0.0, 0.0, 0.0, 0.0);\n"
-            "	if (cell.glyph_index != 0xFFFFFFFF)\n"
+            "	if (cell_index.y < rows && cell_index.x < columns)\n"
             "	{\n"
-            "		ivec2 glyph_pos = ivec2(cell.glyph_index & 0xFFFF, cell.glyph_index >> 16);\n"
-            "		vec2 uv = (glyph_pos + cell_pos) / textureSize(glyph_atlas, 0);\n"
-            "		color = vec4(bgr_unpack(cell.fg), texture(glyph_atlas, uv).r);\n"
+            "		int row = (cell_index.y + line_offset) % rows;\n"
+            "		GlyphData cell = glyph_data[row*columns + cell_index.x];\n"
+            "		if (cell.glyph_index != 0xFFFFFFFF)\n"
+            "		{\n"
+            "			ivec3 glyph_pos = ivec3(cell.glyph_index & 0xFFF, (cell.glyph_index >> 12) & 0xFFF, cell.glyph_index >> 24);\n"
+            "			vec2 uv = (glyph_pos.xy + cell_pos * atlas_cell_size / cell_size) / textureSize(glyph_atlas, 0).xy;\n"
+            "			float a = texture(glyph_atlas, vec3(uv, glyph_pos.z)).r;\n"
+            "			if (sdf_width > 0.0) a = smoothstep(0.5 - sdf_width, 0.5 + sdf_width, a);\n"
+            "			color = vec4(bgr_unpack(cell.fg), a);\n"
+            "		}\n"
             "	}\n"
             "	out_color = color;\n"
             "}\0";
 
-            gfx.shaders.mono_text.program = gfx_create_shader(vert, frag);
-            gfx.shaders.mono_text.resolution = glGetUniformLocation(gfx.shaders.mono_text.program->object, "resolution");
-            gfx.shaders.mono_text.cell_size = glGetUniformLocation(gfx.shaders.mono_text.program->object, "cell_size");
-            gfx.shaders.mono_text.pos = glGetUniformLocation(gfx.shaders.mono_text.program->object, "pos");
-            gfx.shaders.mono_text.offset = glGetUniformLocation(gfx.shaders.mono_text.program->object, "voffset");
-            gfx.shaders.mono_text.line_offset = glGetUniformLocation(gfx.shaders.mono_text.program->object, "line_offset");
-            gfx.shaders.mono_text.columns = glGetUniformLocation(gfx.shaders.mono_text.program->object, "columns");
+            gfx_gl.shaders.mono_text.program = gfx_create_shader(vert, frag);
+            gfx_gl.shaders.mono_text.resolution = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "resolution");
+            gfx_gl.shaders.mono_text.cell_size = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "cell_size");
+            gfx_gl.shaders.mono_text.atlas_cell_size = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "atlas_cell_size");
+            gfx_gl.shaders.mono_text.sdf_width = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "sdf_width");
+            gfx_gl.shaders.mono_text.pos = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "pos");
+            gfx_gl.shaders.mono_text.offset = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "voffset");
+            gfx_gl.shaders.mono_text.line_offset = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "line_offset");
+            gfx_gl.shaders.mono_text.columns = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "columns");
+            gfx_gl.shaders.mono_text.rows = glGetUniformLocation(gfx_gl.shaders.mono_text.program->object, "rows");
     }
 
     f32 square_vertices[] = {
@@ -356,19 +461,29 @@ void init_gfx(Vector2 resolution) EXPORT
         0.5f, -0.5f,
     };
 
-    glGenBuffers(1, &gfx.vbos.square);
-    glGenVertexArrays(1, &gfx.vaos.square);
+    glGenBuffers(1, &gfx_gl.vbos.square);
+    glGenVertexArrays(1, &gfx_gl.vaos.square);
 
-    glBindVertexArray(gfx.vaos.square);
+    glBindVertexArray(gfx_gl.vaos.square);
 
-    glBindBuffer(GL_ARRAY_BUFFER, gfx.vbos.square);
+    glBindBuffer(GL_ARRAY_BUFFER, gfx_gl.vbos.square);
     glBufferData(GL_ARRAY_BUFFER, sizeof square_vertices, square_vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof square_vertices[0], (void*)0);
     glEnableVertexAttribArray(0);
 
-    glGenBuffers(1, &gfx.vbos.frame);
-    glGenVertexArrays(1, &gfx.vaos.frame);
+    glGenVertexArrays(1, &gfx_gl.vaos.frame);
+
+    // NOTE(jesper): the quad instance buffer is bound per command buffer, so only the instance layout lives here
+    glCreateVertexArrays(1, &gfx_gl.vaos.quads);
+    glVertexArrayAttribFormat(gfx_gl.vaos.quads, 0, 4, GL_FLOAT, GL_FALSE, offsetof(GfxQuad, x0));
+    glVertexArrayAttribIFormat(gfx_gl.vaos.quads, 1, 1, GL_UNSIGNED_INT, offsetof(GfxQuad, uv));
+    glVertexArrayAttribFormat(gfx_gl.vaos.quads, 2, GL_BGRA, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(GfxQuad, color));
+    for (GLuint attrib = 0; attrib < 3; attrib++) {
+        glVertexArrayAttribBinding(gfx_gl.vaos.quads, attrib, 0);
+        glEnableVertexArrayAttrib(gfx_gl.vaos.quads, attrib);
+    }
+    glVertexArrayBindingDivisor(gfx_gl.vaos.quads, 0, 1);
 }
 
 bool gfx_change_resolution(Vector2 resolution) EXPORT
@@ -380,328 +495,80 @@ bool gfx_change_resolution(Vector2 resolution) EXPORT
     return true;
 }
 
-void gfx_draw_square(Vector2 center, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_PRIM;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 6;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    f32 left = center.x - size.x*0.5f;
-    f32 right = center.x + size.x*0.5f;
-    f32 top = center.y - size.y*0.5f;
-    f32 bottom = center.y + size.y*0.5f;
-
-    f32 vertices[] = {
-        right, top, color.r, color.g, color.b, color.a,
-        left, top, color.r, color.g, color.b, color.a,
-        left, bottom, color.r, color.g, color.b, color.a,
-
-        left, bottom, color.r, color.g, color.b, color.a,
-        right, bottom, color.r, color.g, color.b, color.a,
-        right, top, color.r, color.g, color.b, color.a,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-void gfx_draw_rect(
-        Vector2 tl,
-        Vector2 size,
-        Vector4 color,
-        GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_PRIM;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 6;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        tl.x+size.x, tl.y,        color.r, color.g, color.b, color.a,
-        tl.x,        tl.y,        color.r, color.g, color.b, color.a,
-        tl.x,        tl.y+size.y, color.r, color.g, color.b, color.a,
-
-        tl.x,        tl.y+size.y, color.r, color.g, color.b, color.a,
-        tl.x+size.x, tl.y+size.y, color.r, color.g, color.b, color.a,
-        tl.x+size.x, tl.y,        color.r, color.g, color.b, color.a,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-void gfx_draw_square(
-    Vector2 p0,
-    Vector2 p1,
-    Vector2 p2,
-    Vector2 p3,
-    Vector3 color,
-    GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_PRIM;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 6;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
-        p1.x, p1.y, color.r, color.g, color.b, 1.0f,
-        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
-
-        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
-        p3.x, p3.y, color.r, color.g, color.b, 1.0f,
-        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-void gfx_draw_square(
-    Vector2 center,
-    Vector2 size,
-    Vector2 uv_tl,
-    Vector2 uv_br,
-    GLuint texture,
-    GfxCommandBuffer *cmdbuf) EXPORT
-{
-    f32 left = center.x - size.x*0.5f;
-    f32 right = center.x + size.x*0.5f;
-    f32 top = center.y - size.y*0.5f;
-    f32 bottom = center.y + size.y*0.5f;
-
-    f32 vertices[] = {
-        right, top, uv_br.x, uv_tl.y,
-        left, top, uv_tl.x, uv_tl.y,
-        left, bottom, uv_tl.x, uv_br.y,
-
-        left, bottom, uv_tl.x, uv_br.y,
-        right, bottom, uv_br.x, uv_br.y,
-        right, top, uv_br.x, uv_tl.y,
-    };
-
-    GfxCommand cmd{
-        .type = GFX_COMMAND_TEXTURED_PRIM,
-        .textured_prim.vbo = gfx.vbos.frame,
-        .textured_prim.vbo_offset = gfx.frame_vertices.count,
-        .textured_prim.texture = texture,
-        .textured_prim.vertex_count = 6,
-    };
-    gfx_push_command(cmd, cmdbuf);
-
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-
-}
-
-void gfx_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_PRIM;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 3;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
-        p1.x, p1.y, color.r, color.g, color.b, 1.0f,
-        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-
-void gfx_draw_line(Vector2 a, Vector2 b, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_LINE;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 2;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        a.x, a.y, color.r, color.g, color.b, 1.0f,
-        b.x, b.y, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-void gfx_draw_line_loop(Vector2 *points, i32 num_points, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_LINE;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = num_points*2;
-    gfx_push_command(cmd, cmdbuf);
-
-    color = linear_from_sRGB(color);
-
-    array_grow(&gfx.frame_vertices, num_points*2*6);
-    for (i32 i = 0; i < num_points-1; i++) {
-        f32 vertices[] = {
-            points[i].x, points[i].y, color.r, color.g, color.b, 1.0f,
-            points[i+1].x, points[i+1].y, color.r, color.g, color.b, 1.0f,
-        };
-        array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-    }
-
-    f32 vertices[] = {
-        points[num_points-1].x, points[num_points-1].y, color.r, color.g, color.b, 1.0f,
-        points[0].x, points[0].y, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-
-void gfx_draw_line_square(Vector2 center, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_LINE;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 8;
-    gfx_push_command(cmd, cmdbuf);
-
-    f32 left = center.x - size.x*0.5f;
-    f32 right = center.x + size.x*0.5f;
-    f32 top = center.y - size.y*0.5f;
-    f32 bottom = center.y + size.y*0.5f;
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        // ---
-        left, top, color.r, color.g, color.b, 1.0f,
-        right, top, color.r, color.g, color.b, 1.0f,
-
-        //   |
-        right, top, color.r, color.g, color.b, 1.0f,
-        right, bottom, color.r, color.g, color.b, 1.0f,
-
-        // ___
-        right, bottom, color.r, color.g, color.b, 1.0f,
-        left, bottom, color.r, color.g, color.b, 1.0f,
-
-        // |
-        left, bottom, color.r, color.g, color.b, 1.0f,
-        left, top, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-void gfx_draw_line_rect(Vector2 tl, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf) EXPORT
-{
-    GfxCommand cmd;
-    cmd.type = GFX_COMMAND_COLORED_LINE;
-    cmd.colored_prim.vbo = gfx.vbos.frame;
-    cmd.colored_prim.vbo_offset = gfx.frame_vertices.count;
-    cmd.colored_prim.vertex_count = 8;
-    gfx_push_command(cmd, cmdbuf);
-
-    f32 left = tl.x;
-    f32 right = tl.x + size.x;
-    f32 top = tl.y;
-    f32 bottom = tl.y + size.y;
-
-    color = linear_from_sRGB(color);
-
-    f32 vertices[] = {
-        // ---
-        left, top, color.r, color.g, color.b, 1.0f,
-        right, top, color.r, color.g, color.b, 1.0f,
-
-        //   |
-        right, top, color.r, color.g, color.b, 1.0f,
-        right, bottom, color.r, color.g, color.b, 1.0f,
-
-        // ___
-        right, bottom - 1, color.r, color.g, color.b, 1.0f,
-        left, bottom - 1, color.r, color.g, color.b, 1.0f,
-
-        // |
-        left, bottom, color.r, color.g, color.b, 1.0f,
-        left, top, color.r, color.g, color.b, 1.0f,
-    };
-    array_add(&gfx.frame_vertices, vertices, ARRAY_COUNT(vertices));
-}
-
-
-
 void gfx_begin_frame() EXPORT
 {
-    array_reset(&gfx.frame_vertices, gfx.frame_vertices.count);
-    gfx_reset_command_buffer(&gfx.frame_cmdbuf);
-}
+    gfx_gl.state = {};
+    gfx.stream_frame = (gfx.stream_frame+1) % GFX_STREAM_FRAMES;
+    gfx_wait_stream_fence(gfx.stream_frame);
 
-void gfx_flush_transfers() EXPORT
-{
-    glBindVertexArray(gfx.vaos.frame);
-    glBindBuffer(GL_ARRAY_BUFFER, gfx.vbos.frame);
-    glBufferData(GL_ARRAY_BUFFER, gfx.frame_vertices.count * sizeof gfx.frame_vertices[0], gfx.frame_vertices.data, GL_STREAM_DRAW);
+    gfx_stream_begin_frame(&gfx.frame_vertices);
+    gfx_reset_command_buffer(&gfx.frame_cmdbuf);
 }
 
-void gfx_reset_command_buffer(GfxCommandBuffer *cmdbuf) EXPORT
+// NOTE(jesper): called after the last command of a frame that was drawn, frames that were skipped leave their
+// region unfenced
+void gfx_end_frame() EXPORT
 {
-    array_reset(&cmdbuf->commands, cmdbuf->commands.count);
+    gfx.stream_fences[gfx.stream_frame] = (GfxFence)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
-GfxCommandBuffer gfx_command_buffer() EXPORT
+void gfx_clear(Vector3 color) EXPORT
 {
-    GfxCommandBuffer cmd{ .commands.alloc = mem_frame };
-    return cmd;
+    glClearColor(color.r, color.g, color.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view) EXPORT
 {
-    for (GfxCommand cmd : cmdbuf.commands) {
+    for (i32 i = 0; i < cmdbuf.commands.count; i++) {
+        GfxCommand cmd = cmdbuf.commands[i];
+        if (cmd.type != GFX_COMMAND_QUADS) gfx_bind_vertex_array(gfx_gl.vaos.frame);
+
         switch (cmd.type) {
         case GFX_COMMAND_MONO_TEXT:
-            glBindBuffer(GL_ARRAY_BUFFER, cmd.mono_text.vbo);
+            gfx_bind_array_buffer(cmd.mono_text.vbo);
 
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            glUseProgram(gfx.shaders.mono_text.program->object);
+            gfx_polygon_mode(GL_FILL);
+            gfx_use_program(gfx_gl.shaders.mono_text.program->object);
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(f32), (void*)(i64)((cmd.mono_text.vbo_offset+0)*sizeof(f32)));
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(f32), (void*)(gfx_stream_base(cmd.mono_text.vbo) + (cmd.mono_text.vbo_offset+0)*sizeof(f32)));
             glEnableVertexAttribArray(0);
 
-            glBindTexture(GL_TEXTURE_2D, cmd.mono_text.glyph_atlas);
+            gfx_bind_texture(GL_TEXTURE_2D_ARRAY, cmd.mono_text.glyph_atlas);
 
             glBindBuffer(GL_SHADER_STORAGE_BUFFER, cmd.mono_text.glyph_ssbo);
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cmd.mono_text.glyph_ssbo);
             //glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-            glUniform2f(gfx.shaders.mono_text.resolution, gfx.resolution.x, gfx.resolution.y);
-            glUniform2f(gfx.shaders.mono_text.cell_size, cmd.mono_text.cell_size.x, cmd.mono_text.cell_size.y);
-            glUniform2f(gfx.shaders.mono_text.pos, cmd.mono_text.pos.x, cmd.mono_text.pos.y);
-            glUniform1f(gfx.shaders.mono_text.offset, cmd.mono_text.offset);
-            glUniform1i(gfx.shaders.mono_text.line_offset, cmd.mono_text.line_offset);
-            glUniform1i(gfx.shaders.mono_text.columns, cmd.mono_text.columns);
+            glUniform2f(gfx_gl.shaders.mono_text.resolution, gfx.resolution.x, gfx.resolution.y);
+            glUniform2f(gfx_gl.shaders.mono_text.cell_size, cmd.mono_text.cell_size.x, cmd.mono_text.cell_size.y);
+            glUniform2f(gfx_gl.shaders.mono_text.atlas_cell_size, cmd.mono_text.atlas_cell_size.x, cmd.mono_text.atlas_cell_size.y);
+            glUniform1f(gfx_gl.shaders.mono_text.sdf_width, cmd.mono_text.sdf_width);
+            glUniform2f(gfx_gl.shaders.mono_text.pos, cmd.mono_text.pos.x, cmd.mono_text.pos.y);
+            glUniform1f(gfx_gl.shaders.mono_text.offset, cmd.mono_text.offset);
+            glUniform1i(gfx_gl.shaders.mono_text.line_offset, cmd.mono_text.line_offset);
+            glUniform1i(gfx_gl.shaders.mono_text.columns, cmd.mono_text.columns);
+            glUniform1i(gfx_gl.shaders.mono_text.rows, cmd.mono_text.rows);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            // NOTE(jesper): the glyph grid is persistently mapped, the fence lets the next frame wait for this draw
+            // to finish before it rewrites any of its rows
+            if (cmd.mono_text.fence) {
+                if (*cmd.mono_text.fence) glDeleteSync((GLsync)*cmd.mono_text.fence);
+                *cmd.mono_text.fence = (GfxFence)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
             break;
         case GFX_COMMAND_TEXTURED_PRIM:
-            glBindBuffer(GL_ARRAY_BUFFER, cmd.textured_prim.vbo);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gfx_bind_array_buffer(cmd.textured_prim.vbo);
+            gfx_polygon_mode(GL_FILL);
 
-            glUseProgram(gfx.shaders.basic2d.program->object);
-            glBindTexture(GL_TEXTURE_2D, cmd.textured_prim.texture);
-            glUniformMatrix3fv(gfx.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
+            gfx_use_program(gfx_gl.shaders.basic2d.program->object);
+            gfx_bind_texture(GL_TEXTURE_2D, cmd.textured_prim.texture);
+            glUniformMatrix3fv(gfx_gl.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(i64)((cmd.textured_prim.vbo_offset+0)*sizeof(f32)));
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(i64)((cmd.textured_prim.vbo_offset+2)*sizeof(f32)));
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(gfx_stream_base(cmd.textured_prim.vbo) + (cmd.textured_prim.vbo_offset+0)*sizeof(f32)));
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(gfx_stream_base(cmd.textured_prim.vbo) + (cmd.textured_prim.vbo_offset+2)*sizeof(f32)));
 
             glEnableVertexAttribArray(0);
             glEnableVertexAttribArray(1);
@@ -709,14 +576,14 @@ void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view) EXPORT
             glDrawArrays(GL_TRIANGLES, 0, cmd.textured_prim.vertex_count);
             break;
         case GFX_COMMAND_COLORED_PRIM:
-            glBindBuffer(GL_ARRAY_BUFFER, cmd.colored_prim.vbo);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gfx_bind_array_buffer(cmd.colored_prim.vbo);
+            gfx_polygon_mode(GL_FILL);
 
-            glUseProgram(gfx.shaders.pass2d.program->object);
-            glUniformMatrix3fv(gfx.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
+            gfx_use_program(gfx_gl.shaders.pass2d.program->object);
+            glUniformMatrix3fv(gfx_gl.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(i64)((cmd.colored_prim.vbo_offset+0)*sizeof(f32)));
-            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(i64)((cmd.colored_prim.vbo_offset+2)*sizeof(f32)));
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(gfx_stream_base(cmd.colored_prim.vbo) + (cmd.colored_prim.vbo_offset+0)*sizeof(f32)));
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(gfx_stream_base(cmd.colored_prim.vbo) + (cmd.colored_prim.vbo_offset+2)*sizeof(f32)));
 
             glEnableVertexAttribArray(0);
             glEnableVertexAttribArray(1);
@@ -724,14 +591,14 @@ void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view) EXPORT
             glDrawArrays(GL_TRIANGLES, 0, cmd.colored_prim.vertex_count);
             break;
         case GFX_COMMAND_COLORED_LINE:
-            glBindBuffer(GL_ARRAY_BUFFER, gfx.vbos.frame);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            gfx_bind_array_buffer(cmd.colored_prim.vbo);
+            gfx_polygon_mode(GL_LINE);
 
-            glUseProgram(gfx.shaders.pass2d.program->object);
-            glUniformMatrix3fv(gfx.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
+            gfx_use_program(gfx_gl.shaders.pass2d.program->object);
+            glUniformMatrix3fv(gfx_gl.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(i64)((cmd.colored_prim.vbo_offset+0)*sizeof(f32)));
-            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(i64)((cmd.colored_prim.vbo_offset+2)*sizeof(f32)));
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(gfx_stream_base(cmd.colored_prim.vbo) + (cmd.colored_prim.vbo_offset+0)*sizeof(f32)));
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6*sizeof(f32), (void*)(gfx_stream_base(cmd.colored_prim.vbo) + (cmd.colored_prim.vbo_offset+2)*sizeof(f32)));
 
             glEnableVertexAttribArray(0);
             glEnableVertexAttribArray(1);
@@ -739,50 +606,58 @@ void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view) EXPORT
             glDrawArrays(GL_LINES, 0, cmd.colored_prim.vertex_count);
             break;
         case GFX_COMMAND_GUI_PRIM_TEXTURE:
-            glBindBuffer(GL_ARRAY_BUFFER, cmd.gui_prim_texture.vbo);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gfx_bind_array_buffer(cmd.gui_prim_texture.vbo);
+            gfx_polygon_mode(GL_FILL);
 
-            glUseProgram(gfx.shaders.gui_prim_texture.program->object);
+            gfx_use_program(gfx_gl.shaders.gui_prim_texture.program->object);
 
-            glUniformMatrix3fv(gfx.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
+            glUniformMatrix3fv(gfx_gl.shaders.global.cs_from_ws, 1, GL_FALSE, view.data);
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(cmd.gui_prim_texture.vbo_offset*sizeof(f32)));
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)((cmd.gui_prim_texture.vbo_offset+2)*sizeof(f32)));
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(gfx_stream_base(cmd.gui_prim_texture.vbo) + cmd.gui_prim_texture.vbo_offset*sizeof(f32)));
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(gfx_stream_base(cmd.gui_prim_texture.vbo) + (cmd.gui_prim_texture.vbo_offset+2)*sizeof(f32)));
             glEnableVertexAttribArray(0);
             glEnableVertexAttribArray(1);
 
-            glBindTexture(GL_TEXTURE_2D, cmd.gui_prim_texture.texture);
+            gfx_bind_texture(GL_TEXTURE_2D, cmd.gui_prim_texture.texture);
 
             glDrawArrays(GL_TRIANGLES, 0, cmd.gui_prim_texture.vertex_count / 4);
             break;
-        case GFX_COMMAND_GUI_TEXT:
-            glBindBuffer(GL_ARRAY_BUFFER, cmd.gui_text.vbo);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-            glUseProgram(gfx.shaders.text.program->object);
+        case GFX_COMMAND_QUADS:
+            // NOTE(jesper): the command buffers of overlays and child windows are appended wholesale, so
+            // their first quads can still continue the batch that came before them
+            while (i+1 < cmdbuf.commands.count &&
+                   cmdbuf.commands[i+1].type == GFX_COMMAND_QUADS &&
+                   gfx_merge_quads(&cmd, cmdbuf.commands[i+1]))
+            {
+                i++;
+            }
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)(cmd.gui_text.vbo_offset*sizeof(f32)));
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(f32), (void*)((cmd.gui_text.vbo_offset+2)*sizeof(f32)));
-            glEnableVertexAttribArray(0);
-            glEnableVertexAttribArray(1);
+            gfx_bind_vertex_array(gfx_gl.vaos.quads);
+            if (gfx_gl.state.quads_buffer != cmd.quads.vbo) {
+                glVertexArrayVertexBuffer(gfx_gl.vaos.quads, 0, cmd.quads.vbo, gfx_stream_base(cmd.quads.vbo), sizeof(GfxQuad));
+                gfx_gl.state.quads_buffer = cmd.quads.vbo;
+            }
 
-            glUniform2f(gfx.shaders.text.resolution, gfx.resolution.x, gfx.resolution.y);
-            glUniform3f(gfx.shaders.text.color, cmd.gui_text.color.r, cmd.gui_text.color.g, cmd.gui_text.color.b);
+            gfx_polygon_mode(GL_FILL);
+            gfx_use_program(gfx_gl.shaders.quads.program->object);
+            glUniform2f(gfx_gl.shaders.quads.resolution, gfx.resolution.x, gfx.resolution.y);
+            glUniform1f(gfx_gl.shaders.quads.texel_scale, cmd.quads.texel_scale);
+            glUniform1f(gfx_gl.shaders.quads.sdf_width, cmd.quads.sdf_width);
 
-            glBindTexture(GL_TEXTURE_2D, cmd.gui_text.font_atlas);
+            if (cmd.quads.texture) gfx_bind_texture(GL_TEXTURE_2D_ARRAY, cmd.quads.texture);
 
-            glDrawArrays(GL_TRIANGLES, 0, cmd.gui_text.vertex_count / 4);
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, cmd.quads.count, cmd.quads.offset);
             break;
         }
     }
 }
 
-GLuint gfx_create_texture(void *pixel_data, i32 width, i32 height) EXPORT
+GfxHandle gfx_create_texture(void *pixel_data, i32 width, i32 height) EXPORT
 {
     GLuint handle;
     glGenTextures(1, &handle);
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    gfx_bind_texture(GL_TEXTURE_2D, handle);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -792,37 +667,86 @@ GLuint gfx_create_texture(void *pixel_data, i32 width, i32 height) EXPORT
     return handle;
 }
 
-// ----------------------------------------
-// GFX_ASSETS
-// ----------------------------------------
-void* gfx_load_texture_asset(AssetHandle /*handle*/, void *existing, String /*identifier*/, u8 *data, i32 size)
+// NOTE(jesper): a single channel texture array, cleared to 0. Only distance fields are filtered, bitmaps are drawn
+// at the size they were rasterized at
+GfxHandle gfx_create_texture_array(i32 width, i32 height, i32 layers, bool linear) EXPORT
+{
+    GLint filter = linear ? GL_LINEAR : GL_NEAREST;
+
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, filter);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, filter);
+    glTextureStorage3D(texture, 1, GL_R8, width, height, layers);
+    glClearTexImage(texture, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    return texture;
+}
+
+void gfx_copy_texture_layers(GfxHandle src, GfxHandle dst, i32 width, i32 height, i32 layers) EXPORT
 {
-    i32 width, height, num_channels;
-    u8 *pixel_data = stbi_load_from_memory(data, size, &width, &height, &num_channels, 4);
+    glCopyImageSubData(
+        src, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+        dst, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+        width, height, layers);
+}
 
-    if (!pixel_data) {
-        LOG_ERROR("failed to load texture: %s", stbi_failure_reason());
-        return nullptr;
+void gfx_clear_texture_layer(GfxHandle texture, i32 layer, i32 width, i32 height) EXPORT
+{
+    glClearTexSubImage(texture, 0, 0, 0, layer, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+}
+
+// NOTE(jesper): batches are copied into one pixel unpack buffer, which is orphaned every time so that the copy
+// doesn't wait on the uploads of the previous batch
+void gfx_upload_texture_layers(GfxTextureUpload *uploads, i32 count) EXPORT
+{
+    if (count == 1) {
+        GfxTextureUpload &up = uploads[0];
+        glTextureSubImage3D(
+            up.texture, 0, up.x, up.y, up.layer, up.width, up.height, 1,
+            GL_RED, GL_UNSIGNED_BYTE, up.pixels);
+        return;
     }
 
-    GLuint object = gfx_create_texture(pixel_data, width, height);
-    if (!object) {
-        LOG_ERROR("failed to create texture");
-        return nullptr;
+    i64 size = 0;
+    for (i32 i = 0; i < count; i++) size += uploads[i].width*uploads[i].height;
+    if (size == 0) return;
+
+    if (!gfx_gl.pbos.upload) glCreateBuffers(1, &gfx_gl.pbos.upload);
+
+    glNamedBufferData(gfx_gl.pbos.upload, size, nullptr, GL_STREAM_DRAW);
+    u8 *dst = (u8*)glMapNamedBufferRange(gfx_gl.pbos.upload, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    i64 offset = 0;
+    for (i32 i = 0; i < count; i++) {
+        memcpy(dst+offset, uploads[i].pixels, uploads[i].width*uploads[i].height);
+        offset += uploads[i].width*uploads[i].height;
     }
 
-    if (existing) {
-        TextureAsset *texture = (TextureAsset*)existing;
-        glDeleteTextures(1, &texture->texture_handle);
-        texture->texture_handle = object;
-        return texture;
+    glUnmapNamedBuffer(gfx_gl.pbos.upload);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gfx_gl.pbos.upload);
+
+    offset = 0;
+    for (i32 i = 0; i < count; i++) {
+        GfxTextureUpload &up = uploads[i];
+        glTextureSubImage3D(
+            up.texture, 0, up.x, up.y, up.layer, up.width, up.height, 1,
+            GL_RED, GL_UNSIGNED_BYTE, (void*)offset);
+        offset += up.width*up.height;
     }
 
-    return ALLOC_T(mem_dynamic, TextureAsset) {
-        .texture_handle = object,
-    };
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void gfx_destroy_texture(GfxHandle texture) EXPORT
+{
+    if (gfx_gl.state.texture_2d == texture) gfx_gl.state.texture_2d = 0;
+    if (gfx_gl.state.texture_2d_array == texture) gfx_gl.state.texture_2d_array = 0;
+    glDeleteTextures(1, &texture);
 }
 
+// ----------------------------------------
+// GFX_ASSETS
+// ----------------------------------------
 void* gfx_load_shader_asset(
     AssetHandle /*handle*/,
     void *existing,
@@ -860,6 +784,7 @@ void* gfx_load_shader_asset(
         for (auto it : shader->used_by) {
             for (auto s : it->shaders) glDetachShader(it->object, s);
 
+            if (gfx_gl.state.program == it->object) gfx_gl.state.program = 0;
             glDeleteProgram(it->object);
             it->object = glCreateProgram();
 
@@ -1,9 +1,6 @@
 #ifndef GFX_OPENGL_H
 #define GFX_OPENGL_H
 
-#include "core/maths.h"
-#include "core/array.h"
-
 #if defined(_WIN32)
 #include "core/win32_lite.h"
 #include "core/win32_opengl.h"
@@ -11,74 +8,13 @@
 #include "core/linux_opengl.h"
 #endif
 
-struct GfxProgram {
-    GLuint object;
-    GLuint shaders[2];
-};
+#include "gfx.h"
 
-struct TextureAsset {
-    GLuint texture_handle;
-};
+static_assert(sizeof(GfxHandle) == sizeof(GLuint));
 
-struct ShaderAsset {
+struct GfxProgram {
     GLuint object;
-    GLint stage;
-
-    DynamicArray<GfxProgram*> used_by;
-};
-
-enum GfxCommandType {
-    GFX_COMMAND_COLORED_LINE,
-    GFX_COMMAND_COLORED_PRIM,
-    GFX_COMMAND_TEXTURED_PRIM,
-    GFX_COMMAND_GUI_PRIM_TEXTURE,
-    GFX_COMMAND_GUI_TEXT,
-    GFX_COMMAND_MONO_TEXT,
-};
-
-struct GfxCommand {
-    GfxCommandType type;
-    union {
-        struct {
-            GLuint vbo;
-            i32 vbo_offset;
-            i32 vertex_count;
-        } colored_prim;
-        struct {
-            GLuint vbo;
-            i32 vbo_offset;
-            i32 vertex_count;
-            GLuint texture;
-        } textured_prim;
-        struct {
-            GLuint vbo;
-            GLuint texture;
-            i32 vbo_offset;
-            i32 vertex_count;
-        } gui_prim_texture;
-        struct {
-            GLuint vbo;
-            GLuint font_atlas;
-            i32 vbo_offset;
-            i32 vertex_count;
-            Vector3 color;
-        } gui_text;
-        struct {
-            GLuint vbo;
-            i32 vbo_offset;
-            GLuint glyph_ssbo;
-            GLuint glyph_atlas;
-            Vector2 cell_size;
-            Vector2 pos;
-            f32 offset;
-            i32 line_offset;
-            i32 columns;
-        } mono_text;
-    };
-};
-
-struct GfxCommandBuffer {
-    DynamicArray<GfxCommand> commands;
+    GLuint shaders[2];
 };
 
 struct GfxVertexAttrib {
@@ -90,7 +26,7 @@ struct GfxVertexAttrib {
     GLsizei offset;
 };
 
-struct GfxContext {
+struct GfxGlContext {
     struct {
         struct {
             GLint cs_from_ws;
@@ -106,13 +42,15 @@ struct GfxContext {
         struct {
             GfxProgram *program;
             GLint resolution;
-            GLint color;
-        } text;
+            GLint texel_scale;
+            GLint sdf_width;
+        } quads;
         struct {
             GfxProgram *program;
             GLuint resolution;
-            GLuint cell_size;
-            GLuint pos, offset, line_offset, columns;
+            GLuint cell_size, atlas_cell_size;
+            GLuint pos, offset, line_offset, columns, rows;
+            GLuint sdf_width;
         } mono_text;
         struct {
             GfxProgram *program;
@@ -123,50 +61,34 @@ struct GfxContext {
     struct {
         GLuint square;
         GLuint frame;
+        GLuint quads;
     } vaos;
 
     struct {
         GLuint square;
-        GLuint frame;
     } vbos;
 
+    struct {
+        GLuint upload;
+    } pbos;
+
     struct {
         GLuint font;
     } textures;
 
-    GfxCommandBuffer frame_cmdbuf;
-    DynamicArray<f32> frame_vertices;
-    Vector2 resolution;
-};
-
-extern GfxContext gfx;
-
-struct Camera2 {
-    Matrix3 projection;
-    Vector2 position;
-    f32 uni_scale = 1.0f;
-};
-
-struct Camera3 {
-    Matrix4 projection;
-    Vector3 position;
-    f32 uni_scale = 1.0f;
+    // NOTE(jesper): the GL objects last bound through the gfx_bind_* and gfx_use_program helpers, to skip the
+    // redundant binds between consecutive commands. Reset every frame since textures are deleted in between
+    struct {
+        GLuint program;
+        GLuint vao;
+        GLuint array_buffer;
+        GLuint quads_buffer;
+        GLuint texture_2d;
+        GLuint texture_2d_array;
+        GLenum polygon_mode;
+    } state;
 };
 
-#include "generated/gfx_opengl.h"
-
-
-void gfx_push_command(GfxCommand cmd, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_square(Vector2 center, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_square(Vector2 center, Vector2 size, Vector2 uv_tl, Vector2 uv_br, GLuint texture, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_square(Vector2 p0,  Vector2 p1,  Vector2 p2, Vector2 p3, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_rect(Vector2 tl, Vector2 size, Vector4 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-
-void gfx_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-
-void gfx_draw_line(Vector2 a, Vector2 b, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_line_square(Vector2 center, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_line_rect(Vector2 tl, Vector2 size, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
-void gfx_draw_line_loop(Vector2 *points, i32 num_points, Vector3 color, GfxCommandBuffer *cmdbuf = &gfx.frame_cmdbuf);
+extern GfxGlContext gfx_gl;
 
 #endif // GFX_OPENGL_H
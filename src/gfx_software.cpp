@@ -0,0 +1,716 @@
+#include "gfx.h"
+#include "generated/gfx_software.h"
+
+#include "core/assets.h"
+#include "core/file.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// NOTE(jesper): renders the GfxCommand set on the CPU, into a framebuffer that never leaves memory. It exists to
+// run frame time benchmarks and pixel snapshots on machines without a GPU, so it follows what the GL backend does
+// closely rather than trying to look good: nearest sampling except for distance fields, no anti-aliasing, and
+// blending with the same src alpha, one minus src alpha function
+struct GfxSwBuffer {
+    u8 *data;
+    i64 size;
+};
+
+struct GfxSwTexture {
+    u8 *pixels;
+    i32 width, height, layers;
+    i32 channels;
+    bool linear;
+};
+
+struct GfxSwContext {
+    // NOTE(jesper): handles are 1-based indices into these, destroyed objects leave a slot behind that's
+    // reused by the next one created
+    DynamicArray<GfxSwBuffer> buffers;
+    DynamicArray<GfxSwTexture> textures;
+
+    // NOTE(jesper): linear colour, bgr packed with alpha in the top byte like GfxQuad::color, and with row 0 at
+    // the top of the screen. The snapshot encodes it to sRGB the way GL_FRAMEBUFFER_SRGB would
+    u32 *framebuffer;
+    i32 width, height;
+} gfx_sw{};
+
+GfxHandle gfx_sw_add_buffer(u8 *data, i64 size) INTERNAL
+{
+    for (i32 i = 0; i < gfx_sw.buffers.count; i++) {
+        if (gfx_sw.buffers[i].data) continue;
+        gfx_sw.buffers[i] = { data, size };
+        return i+1;
+    }
+
+    array_add(&gfx_sw.buffers, GfxSwBuffer{ data, size });
+    return gfx_sw.buffers.count;
+}
+
+u8* gfx_sw_buffer_data(GfxHandle buffer) INTERNAL
+{
+    if (buffer == 0 || (i32)buffer > gfx_sw.buffers.count) return nullptr;
+    return gfx_sw.buffers[buffer-1].data;
+}
+
+void gfx_sw_destroy_buffer(GfxHandle buffer) INTERNAL
+{
+    if (!gfx_sw_buffer_data(buffer)) return;
+    FREE(mem_dynamic, gfx_sw.buffers[buffer-1].data);
+    gfx_sw.buffers[buffer-1] = {};
+}
+
+GfxHandle gfx_sw_add_texture(GfxSwTexture texture) INTERNAL
+{
+    for (i32 i = 0; i < gfx_sw.textures.count; i++) {
+        if (gfx_sw.textures[i].pixels) continue;
+        gfx_sw.textures[i] = texture;
+        return i+1;
+    }
+
+    array_add(&gfx_sw.textures, texture);
+    return gfx_sw.textures.count;
+}
+
+GfxSwTexture* gfx_sw_texture(GfxHandle texture) INTERNAL
+{
+    if (texture == 0 || (i32)texture > gfx_sw.textures.count) return nullptr;
+    if (!gfx_sw.textures[texture-1].pixels) return nullptr;
+    return &gfx_sw.textures[texture-1];
+}
+
+void gfx_wait_fence(GfxFence *fence) EXPORT
+{
+    // NOTE(jesper): commands are executed before gfx_submit_commands returns, so no fence is ever placed
+    *fence = nullptr;
+}
+
+GfxHandle gfx_create_mapped_buffer(i64 size, void **mapped) EXPORT
+{
+    u8 *data = (u8*)ALLOC(mem_dynamic, size);
+    *mapped = data;
+    return gfx_sw_add_buffer(data, size);
+}
+
+void gfx_destroy_mapped_buffer(GfxHandle buffer) EXPORT
+{
+    gfx_sw_destroy_buffer(buffer);
+}
+
+// NOTE(jesper): submission is synchronous, so unlike the GL backend a stream only needs the one region
+void gfx_create_stream(GfxStream *stream, i32 stride, i32 capacity) EXPORT
+{
+    i64 size = (i64)capacity * stride;
+
+    stream->mapped = (u8*)ALLOC(mem_dynamic, size);
+    stream->vbo = gfx_sw_add_buffer(stream->mapped, size);
+    stream->stride = stride;
+    stream->capacity = capacity;
+    stream->region = 0;
+    stream->base = 0;
+    stream->data = stream->mapped;
+    stream->count = 0;
+    stream->overflowed = false;
+
+    if (array_find_index(gfx.streams, stream) == -1) array_add(&gfx.streams, stream);
+}
+
+void gfx_stream_begin_frame(GfxStream *stream) EXPORT
+{
+    if (stream->overflowed) {
+        gfx_sw_destroy_buffer(stream->vbo);
+        gfx_create_stream(stream, stream->stride, stream->capacity*2);
+    }
+
+    stream->count = 0;
+}
+
+void gfx_stream_rewrite(GfxStream *stream) EXPORT
+{
+    gfx_stream_begin_frame(stream);
+}
+
+void init_gfx(Vector2 resolution) EXPORT
+{
+    gfx_create_stream(&gfx.frame_vertices, sizeof(f32), 256*1024);
+    gfx_change_resolution(resolution);
+}
+
+bool gfx_change_resolution(Vector2 resolution) EXPORT
+{
+    if (gfx.resolution == resolution) return false;
+    LOG_INFO("new render resolution: {%f, %f}", resolution.x, resolution.y);
+
+    if (gfx_sw.framebuffer) FREE(mem_dynamic, gfx_sw.framebuffer);
+    gfx_sw.width = (i32)resolution.x;
+    gfx_sw.height = (i32)resolution.y;
+    gfx_sw.framebuffer = ALLOC_ARR(mem_dynamic, u32, (i64)gfx_sw.width*gfx_sw.height);
+    memset(gfx_sw.framebuffer, 0, (i64)gfx_sw.width*gfx_sw.height*sizeof gfx_sw.framebuffer[0]);
+
+    gfx.resolution = resolution;
+    return true;
+}
+
+void gfx_begin_frame() EXPORT
+{
+    gfx_stream_begin_frame(&gfx.frame_vertices);
+    gfx_reset_command_buffer(&gfx.frame_cmdbuf);
+}
+
+void gfx_end_frame() EXPORT
+{
+}
+
+u32 gfx_sw_pack(f32 r, f32 g, f32 b) INTERNAL
+{
+    u32 ur = (u32)(CLAMP(r, 0.0f, 1.0f)*255.0f + 0.5f);
+    u32 ug = (u32)(CLAMP(g, 0.0f, 1.0f)*255.0f + 0.5f);
+    u32 ub = (u32)(CLAMP(b, 0.0f, 1.0f)*255.0f + 0.5f);
+    return 0xFF000000 | (ur << 16) | (ug << 8) | ub;
+}
+
+void gfx_clear(Vector3 color) EXPORT
+{
+    u32 packed = gfx_sw_pack(color.r, color.g, color.b);
+
+    i64 count = (i64)gfx_sw.width*gfx_sw.height;
+    for (i64 i = 0; i < count; i++) gfx_sw.framebuffer[i] = packed;
+}
+
+u32 gfx_sw_div255(u32 x) INTERNAL
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+u32 gfx_sw_blend(u32 dst, u32 src, u32 alpha) INTERNAL
+{
+    u32 r = gfx_sw_div255(((src >> 16) & 0xFF)*alpha + ((dst >> 16) & 0xFF)*(255-alpha));
+    u32 g = gfx_sw_div255(((src >> 8) & 0xFF)*alpha + ((dst >> 8) & 0xFF)*(255-alpha));
+    u32 b = gfx_sw_div255((src & 0xFF)*alpha + (dst & 0xFF)*(255-alpha));
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+// NOTE(jesper): blends color over count pixels, with its alpha scaled by each pixel's coverage if there is any.
+// 4 pixels are blended at a time as 16-bit channels, runs of uncovered glyph texels are skipped outright
+void gfx_sw_blend_span(u32 *dst, i32 count, u32 color, const u8 *coverage) INTERNAL
+{
+    u32 alpha = color >> 24;
+    if (!coverage && alpha == 255) {
+        for (i32 i = 0; i < count; i++) dst[i] = color;
+        return;
+    }
+
+    i32 i = 0;
+
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((i32)color), zero);
+    __m128i v_alpha = _mm_set1_epi16((i16)alpha);
+    __m128i v_255 = _mm_set1_epi16(255);
+    __m128i v_128 = _mm_set1_epi16(128);
+    __m128i opaque = _mm_set1_epi32((i32)0xFF000000);
+
+    auto div255 = [&](__m128i x) -> __m128i
+    {
+        x = _mm_add_epi16(x, v_128);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+
+    for (; i+4 <= count; i += 4) {
+        __m128i a = v_alpha;
+        if (coverage) {
+            i32 texels;
+            memcpy(&texels, coverage+i, sizeof texels);
+            if (texels == 0) continue;
+
+            a = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texels), zero), v_alpha));
+        }
+
+        __m128i a2 = _mm_unpacklo_epi16(a, a);
+        __m128i a_lo = _mm_unpacklo_epi32(a2, a2);
+        __m128i a_hi = _mm_unpackhi_epi32(a2, a2);
+
+        __m128i d = _mm_loadu_si128((__m128i*)(dst+i));
+        __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+        __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+        d_lo = div255(_mm_add_epi16(_mm_mullo_epi16(src, a_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(v_255, a_lo))));
+        d_hi = div255(_mm_add_epi16(_mm_mullo_epi16(src, a_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(v_255, a_hi))));
+
+        d = _mm_or_si128(_mm_packus_epi16(d_lo, d_hi), opaque);
+        _mm_storeu_si128((__m128i*)(dst+i), d);
+    }
+#endif
+
+    for (; i < count; i++) {
+        u32 a = coverage ? gfx_sw_div255(alpha*coverage[i]) : alpha;
+        if (a) dst[i] = gfx_sw_blend(dst[i], color, a);
+    }
+}
+
+// NOTE(jesper): the pixels whose centers are inside [p0, p1), clipped to [0, size)
+void gfx_sw_pixel_range(f32 p0, f32 p1, i32 size, i32 *first, i32 *end) INTERNAL
+{
+    *first = MAX((i32)ceilf(p0 - 0.5f), 0);
+    *end = MIN((i32)ceilf(p1 - 0.5f), size);
+}
+
+Vector2 gfx_sw_screen_from_ws(Matrix3 view, f32 x, f32 y) INTERNAL
+{
+    f32 cx = view.data[0]*x + view.data[3]*y + view.data[6];
+    f32 cy = view.data[1]*x + view.data[4]*y + view.data[7];
+    return { (cx*0.5f + 0.5f)*gfx_sw.width, (0.5f - cy*0.5f)*gfx_sw.height };
+}
+
+f32 gfx_sw_edge(Vector2 a, Vector2 b, Vector2 p) INTERNAL
+{
+    return (b.x - a.x)*(p.y - a.y) - (b.y - a.y)*(p.x - a.x);
+}
+
+// NOTE(jesper): the texture's texel at the texel coordinate, clamped to its edges
+u32 gfx_sw_fetch_rgba(GfxSwTexture *texture, f32 s, f32 t) INTERNAL
+{
+    i32 x = CLAMP((i32)floorf(s), 0, texture->width-1);
+    i32 y = CLAMP((i32)floorf(t), 0, texture->height-1);
+    return ((u32*)texture->pixels)[y*texture->width + x];
+}
+
+f32 gfx_sw_sample_r8(GfxSwTexture *texture, i32 layer, f32 s, f32 t) INTERNAL
+{
+    u8 *texels = texture->pixels + (i64)layer*texture->width*texture->height;
+
+    if (!texture->linear) {
+        i32 x = CLAMP((i32)floorf(s), 0, texture->width-1);
+        i32 y = CLAMP((i32)floorf(t), 0, texture->height-1);
+        return texels[y*texture->width + x] / 255.0f;
+    }
+
+    s -= 0.5f; t -= 0.5f;
+    f32 fx = floorf(s), fy = floorf(t);
+    f32 wx = s - fx, wy = t - fy;
+
+    i32 x0 = CLAMP((i32)fx, 0, texture->width-1), x1 = CLAMP((i32)fx+1, 0, texture->width-1);
+    i32 y0 = CLAMP((i32)fy, 0, texture->height-1), y1 = CLAMP((i32)fy+1, 0, texture->height-1);
+
+    f32 top = texels[y0*texture->width + x0]*(1.0f-wx) + texels[y0*texture->width + x1]*wx;
+    f32 bottom = texels[y1*texture->width + x0]*(1.0f-wx) + texels[y1*texture->width + x1]*wx;
+    return (top*(1.0f-wy) + bottom*wy) / 255.0f;
+}
+
+// NOTE(jesper): the smoothstep of the fragment shaders, turning a distance field sample into coverage
+f32 gfx_sw_sdf_coverage(f32 a, f32 sdf_width) INTERNAL
+{
+    a = CLAMP((a - (0.5f - sdf_width)) / (2.0f*sdf_width), 0.0f, 1.0f);
+    return a*a*(3.0f - 2.0f*a);
+}
+
+// NOTE(jesper): vertices are 2 position floats followed by either 4 colour floats, or 2 texture coordinates if
+// there's a texture. Flat coloured triangles, which is what the GUI draws, blend each row as one span
+void gfx_sw_draw_triangles(f32 *vertices, i32 vertex_count, GfxSwTexture *texture, Matrix3 view) INTERNAL
+{
+    i32 stride = texture ? 4 : 6;
+
+    for (i32 v = 0; v+3 <= vertex_count; v += 3) {
+        f32 *vtx[3] = { vertices+(v+0)*stride, vertices+(v+1)*stride, vertices+(v+2)*stride };
+
+        Vector2 p[3];
+        for (i32 i = 0; i < 3; i++) p[i] = gfx_sw_screen_from_ws(view, vtx[i][0], vtx[i][1]);
+
+        f32 area = gfx_sw_edge(p[0], p[1], p[2]);
+        if (area == 0.0f) continue;
+
+        i32 x0, x1, y0, y1;
+        gfx_sw_pixel_range(MIN(p[0].x, MIN(p[1].x, p[2].x)), MAX(p[0].x, MAX(p[1].x, p[2].x)), gfx_sw.width, &x0, &x1);
+        gfx_sw_pixel_range(MIN(p[0].y, MIN(p[1].y, p[2].y)), MAX(p[0].y, MAX(p[1].y, p[2].y)), gfx_sw.height, &y0, &y1);
+
+        bool flat = !texture &&
+            memcmp(vtx[0]+2, vtx[1]+2, 4*sizeof(f32)) == 0 &&
+            memcmp(vtx[0]+2, vtx[2]+2, 4*sizeof(f32)) == 0;
+
+        u32 flat_color = 0;
+        if (flat) {
+            flat_color = gfx_sw_pack(vtx[0][2], vtx[0][3], vtx[0][4]) & 0x00FFFFFF;
+            flat_color |= (u32)(CLAMP(vtx[0][5], 0.0f, 1.0f)*255.0f + 0.5f) << 24;
+        }
+
+        for (i32 y = y0; y < y1; y++) {
+            u32 *row = gfx_sw.framebuffer + (i64)y*gfx_sw.width;
+
+            i32 first = -1, last = -1;
+            for (i32 x = x0; x < x1; x++) {
+                Vector2 c{ x + 0.5f, y + 0.5f };
+                f32 w0 = gfx_sw_edge(p[1], p[2], c) / area;
+                f32 w1 = gfx_sw_edge(p[2], p[0], c) / area;
+                f32 w2 = gfx_sw_edge(p[0], p[1], c) / area;
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                if (first == -1) first = x;
+                last = x;
+                if (flat) continue;
+
+                f32 attribs[4];
+                for (i32 i = 0; i < stride-2; i++) attribs[i] = vtx[0][2+i]*w0 + vtx[1][2+i]*w1 + vtx[2][2+i]*w2;
+
+                u32 src;
+                if (texture) {
+                    src = gfx_sw_fetch_rgba(texture, attribs[0]*texture->width, attribs[1]*texture->height);
+                } else {
+                    src = gfx_sw_pack(attribs[0], attribs[1], attribs[2]) & 0x00FFFFFF;
+                    src |= (u32)(CLAMP(attribs[3], 0.0f, 1.0f)*255.0f + 0.5f) << 24;
+                }
+
+                if (u32 a = src >> 24; a) row[x] = gfx_sw_blend(row[x], src, a);
+            }
+
+            if (flat && first != -1) gfx_sw_blend_span(row+first, last-first+1, flat_color, nullptr);
+        }
+    }
+}
+
+void gfx_sw_draw_lines(f32 *vertices, i32 vertex_count, Matrix3 view) INTERNAL
+{
+    for (i32 v = 0; v+2 <= vertex_count; v += 2) {
+        f32 *a = vertices + v*6;
+        f32 *b = vertices + (v+1)*6;
+
+        Vector2 p0 = gfx_sw_screen_from_ws(view, a[0], a[1]);
+        Vector2 p1 = gfx_sw_screen_from_ws(view, b[0], b[1]);
+
+        u32 color = gfx_sw_pack(a[2], a[3], a[4]);
+        u32 alpha = (u32)(CLAMP(a[5], 0.0f, 1.0f)*255.0f + 0.5f);
+
+        f32 dx = p1.x - p0.x, dy = p1.y - p0.y;
+        i32 steps = (i32)MAX(fabsf(dx), fabsf(dy));
+
+        // NOTE(jesper): GL leaves out the last pixel of a line, which is what lets the line loops and rects
+        // share their corners without blending them twice
+        for (i32 i = 0; i < steps; i++) {
+            f32 t = (f32)i / steps;
+            i32 x = (i32)floorf(p0.x + dx*t);
+            i32 y = (i32)floorf(p0.y + dy*t);
+            if (x < 0 || y < 0 || x >= gfx_sw.width || y >= gfx_sw.height) continue;
+
+            u32 *dst = gfx_sw.framebuffer + (i64)y*gfx_sw.width + x;
+            *dst = gfx_sw_blend(*dst, color, alpha);
+        }
+    }
+}
+
+void gfx_sw_draw_quads(GfxCommand cmd) INTERNAL
+{
+    GfxQuad *quads = (GfxQuad*)gfx_sw_buffer_data(cmd.quads.vbo);
+    GfxSwTexture *atlas = gfx_sw_texture(cmd.quads.texture);
+    if (!quads) return;
+
+    f32 texel_scale = cmd.quads.texel_scale;
+    f32 sdf_width = cmd.quads.sdf_width;
+
+    SArena scratch = tl_scratch_arena();
+    u8 *coverage = nullptr;
+
+    for (i32 i = cmd.quads.offset; i < cmd.quads.offset+cmd.quads.count; i++) {
+        GfxQuad q = quads[i];
+
+        i32 x0, x1, y0, y1;
+        gfx_sw_pixel_range(q.x0, q.x1, gfx_sw.width, &x0, &x1);
+        gfx_sw_pixel_range(q.y0, q.y1, gfx_sw.height, &y0, &y1);
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        if (q.uv == GFX_QUAD_SOLID) {
+            for (i32 y = y0; y < y1; y++) {
+                gfx_sw_blend_span(gfx_sw.framebuffer + (i64)y*gfx_sw.width + x0, x1-x0, q.color, nullptr);
+            }
+            continue;
+        }
+
+        i32 layer = q.uv >> 24;
+        if (!atlas || layer >= atlas->layers) continue;
+
+        // NOTE(jesper): scaled glyphs, which are SDF ones, are sampled per pixel like the fragment shader does
+        if (texel_scale != 1.0f || sdf_width > 0.0f) {
+            if (!coverage) coverage = ALLOC_ARR(*scratch, u8, gfx_sw.width);
+
+            f32 s0 = (f32)(q.uv & 0xFFF);
+            f32 t0 = (f32)((q.uv >> 12) & 0xFFF);
+
+            for (i32 y = y0; y < y1; y++) {
+                f32 t = t0 + (y + 0.5f - q.y0)*texel_scale;
+                for (i32 x = x0; x < x1; x++) {
+                    f32 a = gfx_sw_sample_r8(atlas, layer, s0 + (x + 0.5f - q.x0)*texel_scale, t);
+                    if (sdf_width > 0.0f) a = gfx_sw_sdf_coverage(a, sdf_width);
+                    coverage[x-x0] = (u8)(a*255.0f + 0.5f);
+                }
+
+                gfx_sw_blend_span(gfx_sw.framebuffer + (i64)y*gfx_sw.width + x0, x1-x0, q.color, coverage);
+            }
+            continue;
+        }
+
+        // NOTE(jesper): texels map 1:1 to pixels, so every row of the quad covers a contiguous run of atlas texels
+        // that's used as the coverage of the span as is
+        i32 s = (i32)(q.uv & 0xFFF) + (i32)floorf(x0 + 0.5f - q.x0);
+        i32 t = (i32)((q.uv >> 12) & 0xFFF) + (i32)floorf(y0 + 0.5f - q.y0);
+        if (s < 0) { x0 -= s; s = 0; }
+        if (t < 0) { y0 -= t; t = 0; }
+        x1 = MIN(x1, x0 + atlas->width - s);
+        y1 = MIN(y1, y0 + atlas->height - t);
+
+        u8 *texels = atlas->pixels + (i64)layer*atlas->width*atlas->height;
+        for (i32 y = y0; y < y1; y++) {
+            gfx_sw_blend_span(
+                gfx_sw.framebuffer + (i64)y*gfx_sw.width + x0, x1-x0, q.color,
+                texels + (i64)(t + y-y0)*atlas->width + s);
+        }
+    }
+}
+
+// NOTE(jesper): the same cell lookup as the mono text fragment shader. Each row of pixels is shaded into a
+// coverage and colour row first, and then blended in runs of the same colour
+void gfx_sw_draw_mono_text(GfxCommand cmd) INTERNAL
+{
+    f32 *vertices = (f32*)gfx_sw_buffer_data(cmd.mono_text.vbo);
+    u32 *cells = (u32*)gfx_sw_buffer_data(cmd.mono_text.glyph_ssbo);
+    GfxSwTexture *atlas = gfx_sw_texture(cmd.mono_text.glyph_atlas);
+    if (!vertices || !cells || !atlas) return;
+
+    vertices += cmd.mono_text.vbo_offset;
+
+    Vector2 tl = { vertices[0], vertices[1] };
+    Vector2 br = tl;
+    for (i32 i = 1; i < 6; i++) {
+        tl = { MIN(tl.x, vertices[i*2]), MIN(tl.y, vertices[i*2+1]) };
+        br = { MAX(br.x, vertices[i*2]), MAX(br.y, vertices[i*2+1]) };
+    }
+
+    i32 x0, x1, y0, y1;
+    gfx_sw_pixel_range(tl.x, br.x, gfx_sw.width, &x0, &x1);
+    gfx_sw_pixel_range(tl.y, br.y, gfx_sw.height, &y0, &y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    Vector2 cell_size = cmd.mono_text.cell_size;
+    Vector2 scale = { cmd.mono_text.atlas_cell_size.x / cell_size.x, cmd.mono_text.atlas_cell_size.y / cell_size.y };
+    f32 sdf_width = cmd.mono_text.sdf_width;
+
+    SArena scratch = tl_scratch_arena();
+    u8 *coverage = ALLOC_ARR(*scratch, u8, x1-x0);
+    u32 *colors = ALLOC_ARR(*scratch, u32, x1-x0);
+
+    for (i32 y = y0; y < y1; y++) {
+        f32 vy = y + 0.5f - cmd.mono_text.pos.y + cmd.mono_text.offset;
+        if (vy < 0.0f) continue;
+
+        i32 cell_y = (i32)(vy / cell_size.y);
+        if (cell_y >= cmd.mono_text.rows) continue;
+
+        f32 py = vy - cell_y*cell_size.y;
+        i32 row = (cell_y + cmd.mono_text.line_offset) % cmd.mono_text.rows;
+        u32 *row_cells = cells + (i64)row*cmd.mono_text.columns*2;
+
+        for (i32 x = x0; x < x1; x++) {
+            coverage[x-x0] = 0;
+            colors[x-x0] = 0;
+
+            f32 vx = x + 0.5f - cmd.mono_text.pos.x;
+            if (vx < 0.0f) continue;
+
+            i32 cell_x = (i32)(vx / cell_size.x);
+            if (cell_x >= cmd.mono_text.columns) continue;
+
+            u32 glyph_index = row_cells[cell_x*2];
+            u32 fg = row_cells[cell_x*2+1];
+            if (glyph_index == 0xFFFFFFFF) continue;
+
+            i32 layer = glyph_index >> 24;
+            if (layer >= atlas->layers) continue;
+
+            f32 px = vx - cell_x*cell_size.x;
+            f32 s = (glyph_index & 0xFFF) + px*scale.x;
+            f32 t = ((glyph_index >> 12) & 0xFFF) + py*scale.y;
+
+            f32 a = gfx_sw_sample_r8(atlas, layer, s, t);
+            if (sdf_width > 0.0f) a = gfx_sw_sdf_coverage(a, sdf_width);
+
+            coverage[x-x0] = (u8)(a*255.0f + 0.5f);
+            colors[x-x0] = fg | 0xFF000000;
+        }
+
+        u32 *dst = gfx_sw.framebuffer + (i64)y*gfx_sw.width + x0;
+        for (i32 i = 0; i < x1-x0;) {
+            i32 end = i+1;
+            while (end < x1-x0 && colors[end] == colors[i]) end++;
+
+            if (colors[i]) gfx_sw_blend_span(dst+i, end-i, colors[i], coverage+i);
+            i = end;
+        }
+    }
+}
+
+void gfx_submit_commands(GfxCommandBuffer cmdbuf, Matrix3 view) EXPORT
+{
+    for (GfxCommand &cmd : cmdbuf.commands) {
+        switch (cmd.type) {
+        case GFX_COMMAND_MONO_TEXT:
+            gfx_sw_draw_mono_text(cmd);
+            break;
+        case GFX_COMMAND_TEXTURED_PRIM:
+            if (f32 *vertices = (f32*)gfx_sw_buffer_data(cmd.textured_prim.vbo);
+                vertices && gfx_sw_texture(cmd.textured_prim.texture))
+            {
+                gfx_sw_draw_triangles(
+                    vertices + cmd.textured_prim.vbo_offset, cmd.textured_prim.vertex_count,
+                    gfx_sw_texture(cmd.textured_prim.texture), view);
+            }
+            break;
+        case GFX_COMMAND_COLORED_PRIM:
+            if (f32 *vertices = (f32*)gfx_sw_buffer_data(cmd.colored_prim.vbo); vertices) {
+                gfx_sw_draw_triangles(vertices + cmd.colored_prim.vbo_offset, cmd.colored_prim.vertex_count, nullptr, view);
+            }
+            break;
+        case GFX_COMMAND_COLORED_LINE:
+            if (f32 *vertices = (f32*)gfx_sw_buffer_data(cmd.colored_prim.vbo); vertices) {
+                gfx_sw_draw_lines(vertices + cmd.colored_prim.vbo_offset, cmd.colored_prim.vertex_count, view);
+            }
+            break;
+        case GFX_COMMAND_GUI_PRIM_TEXTURE:
+            if (f32 *vertices = (f32*)gfx_sw_buffer_data(cmd.gui_prim_texture.vbo);
+                vertices && gfx_sw_texture(cmd.gui_prim_texture.texture))
+            {
+                gfx_sw_draw_triangles(
+                    vertices + cmd.gui_prim_texture.vbo_offset, cmd.gui_prim_texture.vertex_count / 4,
+                    gfx_sw_texture(cmd.gui_prim_texture.texture), view);
+            }
+            break;
+        case GFX_COMMAND_QUADS:
+            gfx_sw_draw_quads(cmd);
+            break;
+        }
+    }
+}
+
+// NOTE(jesper): the texels are swizzled into the framebuffer's packing when they're created, so sampling them is a
+// plain load. Like the GL backend the data isn't decoded from sRGB
+GfxHandle gfx_create_texture(void *pixel_data, i32 width, i32 height) EXPORT
+{
+    u32 *src = (u32*)pixel_data;
+    u32 *pixels = ALLOC_ARR(mem_dynamic, u32, (i64)width*height);
+
+    for (i64 i = 0; i < (i64)width*height; i++) {
+        u32 rgba = src[i];
+        pixels[i] = (rgba & 0xFF00FF00) | ((rgba & 0xFF) << 16) | ((rgba >> 16) & 0xFF);
+    }
+
+    return gfx_sw_add_texture({
+        .pixels = (u8*)pixels,
+        .width = width, .height = height, .layers = 1,
+        .channels = 4,
+    });
+}
+
+GfxHandle gfx_create_texture_array(i32 width, i32 height, i32 layers, bool linear) EXPORT
+{
+    i64 size = (i64)width*height*layers;
+    u8 *pixels = (u8*)ALLOC(mem_dynamic, size);
+    memset(pixels, 0, size);
+
+    return gfx_sw_add_texture({
+        .pixels = pixels,
+        .width = width, .height = height, .layers = layers,
+        .channels = 1,
+        .linear = linear,
+    });
+}
+
+void gfx_copy_texture_layers(GfxHandle src, GfxHandle dst, i32 width, i32 height, i32 layers) EXPORT
+{
+    GfxSwTexture *src_tex = gfx_sw_texture(src);
+    GfxSwTexture *dst_tex = gfx_sw_texture(dst);
+    if (!src_tex || !dst_tex) return;
+
+    ASSERT(src_tex->width == width && dst_tex->width == width);
+    ASSERT(src_tex->height == height && dst_tex->height == height);
+    memcpy(dst_tex->pixels, src_tex->pixels, (i64)width*height*MIN(layers, dst_tex->layers));
+}
+
+void gfx_clear_texture_layer(GfxHandle texture, i32 layer, i32 width, i32 height) EXPORT
+{
+    GfxSwTexture *tex = gfx_sw_texture(texture);
+    if (!tex || layer >= tex->layers) return;
+
+    memset(tex->pixels + (i64)layer*tex->width*tex->height, 0, (i64)width*height);
+}
+
+void gfx_upload_texture_layers(GfxTextureUpload *uploads, i32 count) EXPORT
+{
+    for (i32 i = 0; i < count; i++) {
+        GfxTextureUpload &up = uploads[i];
+
+        GfxSwTexture *tex = gfx_sw_texture(up.texture);
+        if (!tex || up.layer >= tex->layers) continue;
+
+        u8 *dst = tex->pixels + (i64)up.layer*tex->width*tex->height;
+        for (i32 y = 0; y < up.height; y++) {
+            memcpy(dst + (i64)(up.y+y)*tex->width + up.x, up.pixels + (i64)y*up.width, up.width);
+        }
+    }
+}
+
+void gfx_destroy_texture(GfxHandle texture) EXPORT
+{
+    GfxSwTexture *tex = gfx_sw_texture(texture);
+    if (!tex) return;
+
+    FREE(mem_dynamic, tex->pixels);
+    *tex = {};
+}
+
+// NOTE(jesper): writes the framebuffer as a binary PPM, encoded to sRGB the way the GL backend's framebuffer is
+bool gfx_write_snapshot(String path) EXPORT
+{
+    if (!gfx_sw.framebuffer) return false;
+
+    u8 srgb[256];
+    for (i32 i = 0; i < 256; i++) {
+        f32 c = i / 255.0f;
+        c = c <= 0.0031308f ? c*12.92f : 1.055f*powf(c, 1.0f/2.4f) - 0.055f;
+        srgb[i] = (u8)(c*255.0f + 0.5f);
+    }
+
+    SArena scratch = tl_scratch_arena();
+
+    char header[64];
+    i32 header_length = snprintf(header, sizeof header, "P6\n%d %d\n255\n", gfx_sw.width, gfx_sw.height);
+
+    i64 count = (i64)gfx_sw.width*gfx_sw.height;
+    u8 *pixels = ALLOC_ARR(*scratch, u8, count*3);
+    for (i64 i = 0; i < count; i++) {
+        u32 c = gfx_sw.framebuffer[i];
+        pixels[i*3+0] = srgb[(c >> 16) & 0xFF];
+        pixels[i*3+1] = srgb[(c >> 8) & 0xFF];
+        pixels[i*3+2] = srgb[c & 0xFF];
+    }
+
+    FileHandle f = open_file(path, FILE_OPEN_TRUNCATE);
+    if (!f) return false;
+
+    write_file(f, header, header_length);
+    write_file(f, pixels, count*3);
+    close_file(f);
+    return true;
+}
+
+// ----------------------------------------
+// GFX_ASSETS
+// ----------------------------------------
+// NOTE(jesper): the shaders are still registered as assets so that the asset table is the same for both backends,
+// but there's nothing to compile them for
+void* gfx_load_shader_asset(
+    AssetHandle /*handle*/,
+    void *existing,
+    String /*identifier*/,
+    u8 */*data*/, i32 /*size*/)
+{
+    if (existing) return existing;
+    return ALLOC_T(mem_dynamic, ShaderAsset) {};
+}
@@ -2,7 +2,7 @@
 #include "generated/gui.h"
 #include "generated/internal/gui.h"
 #include "font.h"
-#include "gfx_opengl.h"
+#include "gfx.h"
 
 #include "core/assets.h"
 #include "core/core.h"
@@ -56,7 +56,65 @@ void gui_pop_command_buffer(GfxCommandBuffer *dst) INTERNAL
     if (dst) array_add(&dst->commands, buf.commands);
 }
 
-GfxCommand gui_command(GfxCommandType type) INTERNAL
+// NOTE(jesper): the draw list that draws are recorded into, or nullptr if the current window isn't being rebuilt
+// this frame, in which case its draws are dropped and it keeps the draw list it was last rebuilt with
+GuiDrawList* gui_draw_target() INTERNAL
+{
+    if (gui.draw_list) return gui.draw_list;
+
+    GuiWindow *wnd = &gui.windows[gui.current_window];
+    return wnd->state.rebuilt ? &wnd->draw : nullptr;
+}
+
+// NOTE(jesper): starts the list over in the next region of its streams. The streams are rewritten at most once a
+// frame, so this is called once for each list being rebuilt or recorded in a frame
+void gui_reset_draw_list(GuiDrawList *list) INTERNAL
+{
+    if (!list->quads) {
+        list->quads = ALLOC_T(mem_dynamic, GfxStream) {};
+        list->vertices = ALLOC_T(mem_dynamic, GfxStream) {};
+        gfx_create_stream(list->quads, sizeof(GfxQuad), 1024);
+        gfx_create_stream(list->vertices, sizeof(f32), 4*1024);
+    }
+
+    list->commands.commands.count = 0;
+    gfx_stream_rewrite(list->quads);
+    gfx_stream_rewrite(list->vertices);
+}
+
+// NOTE(jesper): a list that ran out of room in its streams dropped some of its geometry, and has to be recorded
+// again once they've grown
+bool gui_draw_list_overflowed(GuiDrawList *list) EXPORT
+{
+    return list->quads && (list->quads->overflowed || list->vertices->overflowed);
+}
+
+// NOTE(jesper): records the draw list of something drawn outside of the GUI windows, such as the editor views, in
+// place of the current window's. Draws go to it until gui_end_draw_list, regardless of whether the current window
+// is being rebuilt
+void gui_begin_draw_list(GuiDrawList *list) EXPORT
+{
+    ASSERT(!gui.draw_list);
+
+    gui_reset_draw_list(list);
+    gui.draw_list = list;
+    gui_push_command_buffer();
+}
+
+void gui_end_draw_list() EXPORT
+{
+    ASSERT(gui.draw_list);
+
+    gui_pop_command_buffer(&gui.draw_list->commands);
+    gui.draw_list = nullptr;
+}
+
+void gui_submit_draw_list(GuiDrawList *list, Matrix3 view) EXPORT
+{
+    if (list->commands.commands.count > 0) gfx_submit_commands(list->commands, view);
+}
+
+GfxCommand gui_command(GfxCommandType type, GuiDrawList *list) INTERNAL
 {
     // TODO(jesper): this entire function essentially exists to initialise the vertex buffer
     // data for the command. This should be replaced with a better API that lets you push
@@ -65,16 +123,17 @@ GfxCommand gui_command(GfxCommandType type) INTERNAL
     GfxCommand cmd{ .type = type };
     switch (type) {
     case GFX_COMMAND_COLORED_PRIM:
-        cmd.colored_prim.vbo = gui.vbo;
-        cmd.colored_prim.vbo_offset = gui.vertices.count;
+        cmd.colored_prim.vbo = list->vertices->vbo;
+        cmd.colored_prim.vbo_offset = list->vertices->count;
         break;
-    case GFX_COMMAND_GUI_TEXT:
-        cmd.gui_text.vbo = gui.vbo;
-        cmd.gui_text.vbo_offset = gui.vertices.count;
+    case GFX_COMMAND_QUADS:
+        cmd.quads.vbo = list->quads->vbo;
+        cmd.quads.offset = list->quads->count;
+        cmd.quads.texel_scale = 1;
         break;
     case GFX_COMMAND_GUI_PRIM_TEXTURE:
-        cmd.gui_prim_texture.vbo = gui.vbo;
-        cmd.gui_prim_texture.vbo_offset = gui.vertices.count;
+        cmd.gui_prim_texture.vbo = list->vertices->vbo;
+        cmd.gui_prim_texture.vbo_offset = list->vertices->count;
         break;
     case GFX_COMMAND_COLORED_LINE:
     case GFX_COMMAND_TEXTURED_PRIM:
@@ -91,15 +150,6 @@ void gui_push_command(GfxCommandBuffer *cmdbuf, GfxCommand cmd) INTERNAL
         existing && existing->type == cmd.type)
     {
         switch (cmd.type) {
-        case GFX_COMMAND_GUI_TEXT:
-            if (existing->gui_text.vbo_offset + existing->gui_text.vertex_count == cmd.gui_text.vbo_offset &&
-                existing->gui_text.font_atlas == cmd.gui_text.font_atlas &&
-                existing->gui_text.color == cmd.gui_text.color)
-            {
-                existing->gui_text.vertex_count += cmd.gui_text.vertex_count;
-                return;
-            }
-            break;
         case GFX_COMMAND_GUI_PRIM_TEXTURE:
             if (existing->gui_prim_texture.vbo_offset + existing->gui_prim_texture.vertex_count == cmd.gui_prim_texture.vbo_offset &&
                 existing->gui_prim_texture.texture == cmd.gui_prim_texture.texture)
@@ -112,6 +162,7 @@ void gui_push_command(GfxCommandBuffer *cmdbuf, GfxCommand cmd) INTERNAL
         case GFX_COMMAND_COLORED_LINE:
         case GFX_COMMAND_TEXTURED_PRIM:
         case GFX_COMMAND_MONO_TEXT:
+        case GFX_COMMAND_QUADS:
             PANIC("incorrect API usage; use gfx_push_command");
             break;
         }
@@ -396,34 +447,29 @@ GuiMenu* gui_find_or_create_menu(GuiId id, Vector2 initial_size, Vector2 max_siz
 }
 
 
-void init_gui() EXPORT
+void init_gui(bool sdf_fonts) EXPORT
 {
     PANIC_IF(!mem_frame, "mem_frame not initialised");
-    gui.vertices = { .alloc = mem_frame };
     gui.layout_stack = { .alloc = mem_frame };
     gui.overlay_rects = { .alloc = mem_frame };
 
     array_add(&gui.id_stack, { 0xdeadbeef });
 
-    glGenBuffers(1, &gui.vbo);
-
     array_add(&gui.windows, {
         .id = GUI_ID,
         .client_rect = Rect{ { 0.0f, 0.0f }, { gfx.resolution.x, gfx.resolution.y } },
-        .command_buffer.commands.alloc = mem_frame,
         .size = gfx.resolution,
     });
 
     array_add(&gui.windows, {
         .id = GUI_ID,
         .client_rect = Rect{ { 0.0f, 0.0f }, { gfx.resolution.x, gfx.resolution.y } },
-        .command_buffer.commands.alloc = mem_frame,
         .size = gfx.resolution,
     });
 
     array_add(&gui.layout_stack, { { { 0, 0 }, gfx.resolution } });
 
-    gui.fonts.base  = create_font("fonts/Ubuntu/Ubuntu-Regular.ttf", 18);
+    gui.fonts.base  = create_font("fonts/Ubuntu/Ubuntu-Regular.ttf", 18, false, sdf_fonts);
     gui.fonts.icons = create_font("fonts/NerdFont/UbuntuNerdFont-Regular.ttf", 16);
 
     {
@@ -707,6 +753,72 @@ bool apply_clip_rect(Rect *rect, Rect *clip_rect) INTERNAL
     return true;
 }
 
+void gui_damage_window(GuiId id) EXPORT
+{
+    if (GuiWindow *wnd = gui_find_window(id); wnd) wnd->state.damaged = true;
+}
+
+void gui_damage_windows() EXPORT
+{
+    for (GuiWindow &wnd : gui.windows) wnd.state.damaged = true;
+}
+
+// NOTE(jesper): the windows' draw lists refer to glyphs by their atlas texel and texture, so they're all rebuilt if
+// either of the fonts replaced its texture or evicted a page
+bool gui_fonts_changed() INTERNAL
+{
+    FontAtlas *fonts[] = { &gui.fonts.base, &gui.fonts.icons };
+
+    bool changed = false;
+    for (i32 i = 0; i < ARRAY_COUNT(fonts); i++) {
+        if (gui.drawn_fonts[i].texture != fonts[i]->texture ||
+            gui.drawn_fonts[i].generation != fonts[i]->generation)
+        {
+            gui.drawn_fonts[i] = { fonts[i]->texture, fonts[i]->generation };
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// NOTE(jesper): the GUI is immediate mode, so what a window draws can only change in response to input, to it being
+// damaged, or to a menu that's open on top of it. The mouse is checked against both where it is and where it was, so
+// that the window it left is rebuilt as well as the one it entered
+bool gui_window_needs_rebuild(GuiWindow *wnd) INTERNAL
+{
+    if (wnd->state.damaged || !wnd->state.was_active || gui.overlay_open) return true;
+    if (!gui.input) return false;
+
+    if (gui.hot_window == wnd->id || gui.focused_window == wnd->id) return true;
+    if (gui.dragging != GUI_ID_INVALID) return true;
+
+    Rect rect{ wnd->pos, wnd->pos+wnd->size };
+    Vector2 mouse = gui_mouse();
+    Vector2 prev_mouse{ mouse.x - gui.mouse.dx, mouse.y - gui.mouse.dy };
+    return point_in_rect(mouse, rect) || point_in_rect(prev_mouse, rect);
+}
+
+// NOTE(jesper): whether the next frame has any window to rebuild, not counting the ones that are hidden
+bool gui_needs_redraw() EXPORT
+{
+    if (gui.input) return true;
+
+    for (i32 i = 0; i < gui.windows.count; i++) {
+        GuiWindow *wnd = &gui.windows[i];
+        if (wnd->state.damaged && (i <= GUI_OVERLAY || wnd->state.active)) return true;
+    }
+
+    return false;
+}
+
+void gui_rebuild_window(GuiWindow *wnd) INTERNAL
+{
+    gui_reset_draw_list(&wnd->draw);
+    wnd->state.rebuilt = true;
+    wnd->state.damaged = false;
+}
+
 void gui_begin_frame() EXPORT
 {
     gui.mouse.x = g_mouse.x;
@@ -714,21 +826,33 @@ void gui_begin_frame() EXPORT
 
     gui_push_command_buffer();
 
+    gui.frame_state = { gui.hot, gui.pressed, gui.focused, gui.hot_window, gui.focused_window };
+
+    // NOTE(jesper): when resolution changes the root and overlay "windows" have to adjust their
+    // clip rects as well
+    Vector2 root_size = gui.windows[GUI_BACKGROUND].client_rect.br;
+    if (root_size.x != gfx.resolution.x || root_size.y != gfx.resolution.y) gui_damage_windows();
+    if (gui_fonts_changed()) gui_damage_windows();
+
+    gui.windows[GUI_BACKGROUND].client_rect.br = gfx.resolution;
+    gui.windows[GUI_OVERLAY].client_rect.br = gfx.resolution;
+
     for (GuiWindow &wnd : gui.windows) {
-        array_reset(&wnd.command_buffer.commands, wnd.command_buffer.commands.capacity);
         wnd.state.was_active = wnd.state.active;
         wnd.state.active = false;
+        wnd.state.rebuilt = false;
+    }
+
+    // NOTE(jesper): the background and overlay aren't begun like the other windows, and the code that draws them runs
+    // every frame, so they're rebuilt on any input rather than skipped. When they're not, their draws are dropped
+    for (i32 i : { GUI_BACKGROUND, GUI_OVERLAY }) {
+        GuiWindow *wnd = &gui.windows[i];
+        if (wnd->state.damaged || gui.input) gui_rebuild_window(wnd);
     }
 
-    array_reset(&gui.vertices, gui.vertices.count);
     array_reset(&gui.layout_stack, gui.layout_stack.count);
     array_reset(&gui.overlay_rects, gui.overlay_rects.count);
 
-    // NOTE(jesper): when resolution changes the root and overlay "windows" have to adjust their
-    // clip rects as well
-    gui.windows[GUI_BACKGROUND].client_rect.br = gfx.resolution;
-    gui.windows[GUI_OVERLAY].client_rect.br = gfx.resolution;
-
     gui_push_layout({ { { 0, 0 }, gfx.resolution }});
 }
 
@@ -767,15 +891,22 @@ void gui_end_frame() EXPORT
     if (!get_input_mouse(MB_PRIMARY, HOLD)) gui.pressed = GUI_ID_INVALID;
     gui.mouse.dx = gui.mouse.dy = 0;
 
-    gui_pop_command_buffer(&gui.windows[GUI_BACKGROUND].command_buffer);
+    GuiWindow *background = &gui.windows[GUI_BACKGROUND];
+    gui_pop_command_buffer(background->state.rebuilt ? &background->draw.commands : nullptr);
 
     ASSERT(gui.draw_stack.count == 0);
     ASSERT(gui.clip_stack.count == 0);
     ASSERT(gui.id_stack.count == 1);
     ASSERT(gui.layout_stack.count == 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, gui.vbo);
-    glBufferData(GL_ARRAY_BUFFER, gui.vertices.count * sizeof gui.vertices[0], gui.vertices.data, GL_STREAM_DRAW);
+    // NOTE(jesper): a window that was skipped because it didn't need rebuilding didn't get to claim hot, so whatever
+    // was hot in it stays hot. The background and overlay are never skipped, only their draws are
+    if (i32 index = gui_find_window_index(gui.hot_window);
+        index > GUI_OVERLAY && gui.next_hot == GUI_ID_INVALID &&
+        gui.windows[index].state.active && !gui.windows[index].state.rebuilt)
+    {
+        gui.next_hot = gui.hot;
+    }
 
     if (GUI_DEBUG_HOT && gui.hot != gui.next_hot) {
         LOG_INFO("next hot id: %u", gui.next_hot);
@@ -845,15 +976,37 @@ void gui_end_frame() EXPORT
         LOG_INFO("focused window: %u", gui.focused_window);
         LOG_INFO("old focused window: %u", old_focused);
     }
+
+    // NOTE(jesper): glyphs created while drawing can evict the ones drawn earlier in the frame
+    if (gui_fonts_changed()) gui_damage_windows();
+
+    // NOTE(jesper): a window whose draw list ran out of room is rebuilt on the next frame, into streams that have
+    // grown to fit it
+    gui.frame_damaged = false;
+    for (GuiWindow &wnd : gui.windows) {
+        if (wnd.state.rebuilt || wnd.state.active != wnd.state.was_active) gui.frame_damaged = true;
+        if (wnd.state.rebuilt && gui_draw_list_overflowed(&wnd.draw)) wnd.state.damaged = true;
+    }
+
+    // NOTE(jesper): the widgets were drawn with the hot and focused state the frame began with, so a change to it
+    // is treated as input to have the next frame draw it
+    gui.overlay_open = gui.overlay_rects.count > 0;
+    gui.input = gui.frame_state.hot != gui.hot ||
+        gui.frame_state.pressed != gui.pressed ||
+        gui.frame_state.focused != gui.focused ||
+        gui.frame_state.hot_window != gui.hot_window ||
+        gui.frame_state.focused_window != gui.focused_window;
 }
 
 void gui_render() EXPORT
 {
     Matrix3 view = mat3_orthographic2(0, gfx.resolution.x, gfx.resolution.y, 0);
 
-    gfx_submit_commands(gui.windows[GUI_BACKGROUND].command_buffer, view);
-    for (auto &wnd : slice(gui.windows, 2)) gfx_submit_commands(wnd.command_buffer, view);
-    gfx_submit_commands(gui.windows[GUI_OVERLAY].command_buffer, view);
+    gui_submit_draw_list(&gui.windows[GUI_BACKGROUND].draw, view);
+    for (auto &wnd : slice(gui.windows, 2)) {
+        if (wnd.state.active) gui_submit_draw_list(&wnd.draw, view);
+    }
+    gui_submit_draw_list(&gui.windows[GUI_OVERLAY].draw, view);
 }
 
 
@@ -1531,7 +1684,6 @@ i32 gui_find_or_create_window_index(GuiId id, GuiWindowDesc desc) INTERNAL
 
     GuiWindow wnd{
         .id = id,
-        .command_buffer.commands.alloc = mem_frame,
         .pos = rect.tl + desc.position - desc.anchor*desc.size + desc.parent_anchor*rect.size(),
         .size = desc.size,
         .flags = desc.flags,
@@ -1553,7 +1705,6 @@ GuiId gui_create_window_id(GuiId id, GuiWindowDesc desc) EXPORT
 
     GuiWindow wnd{
         .id = id,
-        .command_buffer.commands.alloc = mem_frame,
         .title = duplicate_string(desc.title, mem_dynamic),
         .pos = rect.tl + desc.position - desc.anchor*desc.size + desc.parent_anchor*rect.size(),
         .size = desc.size,
@@ -1639,6 +1790,13 @@ bool gui_begin_window_internal(
     GuiWindow *wnd = &gui.windows[wnd_index];
     if (wnd->state.hidden) return false;
 
+    // NOTE(jesper): a window that doesn't need rebuilding is kept active and drawn with its previous draw list, but its
+    // contents aren't run
+    if (!gui_window_needs_rebuild(wnd)) {
+        wnd->state.active = true;
+        return false;
+    }
+
     ASSERT(gui.current_window == GUI_BACKGROUND);
     gui.current_window = wnd_index;
 
@@ -1652,6 +1810,7 @@ bool gui_begin_window_internal(
         wnd = push_window_to_top(gui.current_window);
     }
 
+    gui_rebuild_window(wnd);
     gui_push_id(id);
     gui_push_layout({
         { wnd->pos, wnd->pos+wnd->size },
@@ -1664,7 +1823,7 @@ bool gui_begin_window_internal(
             if (gui.focused == wnd->id) gui_focus(GUI_ID_INVALID);
             if (gui.focused_window == wnd->id) gui_focus_window(GUI_ID_INVALID);
 
-            wnd->command_buffer.commands.count = 0;
+            wnd->draw.commands.commands.count = 0;
             gui_pop_command_buffer(nullptr);
             gui_pop_layout();
             gui_pop_id();
@@ -1765,7 +1924,7 @@ void gui_end_window() EXPORT
     ASSERT(!wnd->state.hidden);
 
     defer {
-        gui_pop_command_buffer(&wnd->command_buffer);
+        gui_pop_command_buffer(&wnd->draw.commands);
         gui_pop_layout();
         gui_pop_id();
 
@@ -1816,7 +1975,7 @@ void gui_end_window() EXPORT
         }
 
         Vector3 resize_bg = gui.hot == resize_id ? gui.style.bg_light0 : gui.style.bg_light1;
-        gfx_draw_triangle(resize_tr, resize_br, resize_bl, resize_bg, array_tail(gui.draw_stack));
+        gui_draw_triangle(resize_tr, resize_br, resize_bl, resize_bg);
     }
 
     if (!(wnd->flags & GUI_NO_VOVERFLOW_SCROLL)) {
@@ -1848,6 +2007,14 @@ void gui_end_window() EXPORT
     }
 }
 
+// NOTE(jesper): the gizmos draw with the gfx_draw functions, whose geometry is only kept for the frame, so the
+// background they're drawn in is rebuilt on every frame that has one
+GfxCommandBuffer* gui_gizmo_command_buffer() INTERNAL
+{
+    gui.windows[GUI_BACKGROUND].state.damaged = true;
+    return array_tail(gui.draw_stack);
+}
+
 GuiAction gui_2d_gizmo_translate_axis_id(
     GuiId id,
     Vector2 *position,
@@ -1861,7 +2028,7 @@ GuiAction gui_2d_gizmo_translate_axis_id(
     defer { gui.current_window = old_window; };
 
     // TODO(jesper): these wigets need to support a rotated and translated camera
-    GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
+    GfxCommandBuffer *cmdbuf = gui_gizmo_command_buffer();
 
     Vector2 n{ axis.y, -axis.x };
     Vector2 p = (ss_from_ws*Vector3{ .xy = *position, 1 }).xy;
@@ -1928,7 +2095,7 @@ GuiAction gui_2d_gizmo_size_axis_id(
     defer { gui.current_window = old_window; };
 
     // TODO(jesper): these wigets need to support a rotated camera
-    GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
+    GfxCommandBuffer *cmdbuf = gui_gizmo_command_buffer();
 
     Vector2 n{ axis.y, -axis.x };
     Vector2 p = (ss_from_ws*Vector3{ .xy = position, 1 }).xy;
@@ -2004,7 +2171,7 @@ GuiAction gui_2d_gizmo_translate_plane_id(
     gui.current_window = GUI_BACKGROUND;
     defer { gui.current_window = old_window; };
 
-    GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
+    GfxCommandBuffer *cmdbuf = gui_gizmo_command_buffer();
 
     Vector2 size = { 20, 20 };
     Vector2 p = (ss_from_ws*Vector3{ .xy = *position, 1 }).xy;
@@ -2118,7 +2285,7 @@ GuiAction gui_2d_gizmo_size_square_id(
     gui.current_window = GUI_BACKGROUND;
     defer { gui.current_window = old_window; };
 
-    GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
+    GfxCommandBuffer *cmdbuf = gui_gizmo_command_buffer();
 
     Vector2 rsize = multiple ? round_to(*size, multiple) : *size;
     Vector2 rcenter = multiple ? round_to(*center, multiple) : *center;
@@ -2462,8 +2629,8 @@ void gui_end_menu(GuiId id /*= GUI_ID_INVALID */) EXPORT
 
     if (menu->active) {
         Vector3 bg = bgr_unpack(0xFF212121);
-        gui_draw_rect(menu->pos, menu->size, bg, &gui_current_window()->command_buffer);
-        gui_pop_command_buffer(&gui_current_window()->command_buffer);
+        gui_draw_rect(menu->pos, menu->size, bg, &gui_current_window()->draw.commands);
+        gui_pop_command_buffer(&gui_current_window()->draw.commands);
     } else {
         gui_pop_command_buffer(nullptr);
     }
@@ -2775,6 +2942,11 @@ GuiAction gui_lister_id(GuiId id, Array<String> items, i32 *selected_item) EXPOR
     Rect border = shrink_rect(&view_r, 1);
     Rect vscroll_r = split_right(&view_r, gui.style.scrollbar.thickness);
 
+    // NOTE(jesper): the offset is clamped by the scrollbar, but only after the rows are laid out. The item count
+    // may have shrunk since last frame
+    f32 total_height = items.count*item_height;
+    scroll_area->offset.y = CLAMP(scroll_area->offset.y, 0.0f, MAX(total_height - view_r.size().y, 0.0f));
+
     Rect rect = view_r;
     rect.tl.y -= scroll_area->offset.y;
 
@@ -2799,7 +2971,12 @@ GuiAction gui_lister_id(GuiId id, Array<String> items, i32 *selected_item) EXPOR
         gui_push_clip_rect(view_r);
         defer { gui_pop_clip_rect(); };
 
-        i32 start = 0, end = items.count;
+        // NOTE(jesper): only the rows intersecting the view are laid out, the rows above it are skipped by moving
+        // the layout past them. Listers can hold hundreds of thousands of items, e.g. the files of a project
+        i32 start = CLAMP((i32)(scroll_area->offset.y / item_height), 0, items.count);
+        i32 end = CLAMP((i32)ceilf((scroll_area->offset.y + view_r.size().y) / item_height), start, items.count);
+        gui_current_layout()->rem.tl.y += start*item_height;
+
         for (i32 i = start; i < end; i++) {
             Rect item_r = split_row({ item_height });
             GuiId item_id = gui_gen_id(i);
@@ -2821,13 +2998,14 @@ GuiAction gui_lister_id(GuiId id, Array<String> items, i32 *selected_item) EXPOR
         }
     }
 
-    f32 total_height = gui_current_layout()->rem.br.y+scroll_area->offset.y - view_r.tl.y;
     gui_vscrollbar(&scroll_area->offset.y, total_height, item_height, vscroll_r, view_r);
     return result;
 }
 
 bool gui_input(WindowEvent event) EXPORT
 {
+    gui.input = true;
+
     switch (event.type) {
     case WE_MOUSE_MOVE:
         gui.mouse.dx += event.mouse.dx;
@@ -2948,10 +3126,33 @@ void gui_draw_icon(String icon, Rect rect) INTERNAL
     gui_draw_text(td, pos, gui.style.fg);
 }
 
+void gui_draw_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector3 color) INTERNAL
+{
+    GuiDrawList *list = gui_draw_target();
+    if (!list) return;
+
+    color = linear_from_sRGB(color);
+
+    f32 vertices[] = {
+        p0.x, p0.y, color.r, color.g, color.b, 1.0f,
+        p1.x, p1.y, color.r, color.g, color.b, 1.0f,
+        p2.x, p2.y, color.r, color.g, color.b, 1.0f,
+    };
+
+    GfxCommand cmd = gui_command(GFX_COMMAND_COLORED_PRIM, list);
+    cmd.colored_prim.vertex_count = 3;
+
+    if (gfx_stream_add(list->vertices, vertices, ARRAY_COUNT(vertices)) < 0) return;
+    gfx_push_command(cmd, array_tail(gui.draw_stack));
+}
+
 void gui_draw_rect(Rect rect, AssetHandle handle) EXPORT
 {
     if (!apply_clip_rect(&rect, array_tail(gui.clip_stack))) return;
 
+    GuiDrawList *list = gui_draw_target();
+    if (!list) return;
+
     GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
     auto *texture = get_asset<TextureAsset>(handle);
 
@@ -2965,12 +3166,12 @@ void gui_draw_rect(Rect rect, AssetHandle handle) EXPORT
         rect.br.x, rect.tl.y, 1.0f, 0.0f,
     };
 
-    GfxCommand cmd = gui_command(GFX_COMMAND_GUI_PRIM_TEXTURE);
+    GfxCommand cmd = gui_command(GFX_COMMAND_GUI_PRIM_TEXTURE, list);
     cmd.gui_prim_texture.texture = texture->texture_handle;
     cmd.gui_prim_texture.vertex_count = ARRAY_COUNT(vertices);
-    gui_push_command(cmdbuf, cmd);
 
-    array_add(&gui.vertices, vertices, ARRAY_COUNT(vertices));
+    if (gfx_stream_add(list->vertices, vertices, ARRAY_COUNT(vertices)) < 0) return;
+    gui_push_command(cmdbuf, cmd);
 }
 
 void gui_draw_rect(
@@ -2980,21 +3181,21 @@ void gui_draw_rect(
 {
     if (!apply_clip_rect(&rect, array_tail(gui.clip_stack))) return;
 
-    color = linear_from_sRGB(color);
+    GuiDrawList *list = gui_draw_target();
+    if (!list) return;
 
-    f32 vertices[] = {
-        rect.br.x, rect.tl.y, color.r, color.g, color.b, 1.0f,
-        rect.tl.x, rect.tl.y, color.r, color.g, color.b, 1.0f,
-        rect.tl.x, rect.br.y, color.r, color.g, color.b, 1.0f,
+    GfxCommand cmd = gui_command(GFX_COMMAND_QUADS, list);
+    cmd.quads.count = 1;
 
-        rect.tl.x, rect.br.y, color.r, color.g, color.b, 1.0f,
-        rect.br.x, rect.br.y, color.r, color.g, color.b, 1.0f,
-        rect.br.x, rect.tl.y, color.r, color.g, color.b, 1.0f,
-    };
+    GfxQuad *quad = (GfxQuad*)gfx_stream_push(list->quads, 1);
+    if (!quad) return;
 
-    GfxCommand cmd = gui_command(GFX_COMMAND_COLORED_PRIM);
-    cmd.colored_prim.vertex_count = ARRAY_COUNT(vertices) / 6;
-    array_add(&gui.vertices, vertices, ARRAY_COUNT(vertices));
+    *quad = {
+        .x0 = rect.tl.x, .y0 = rect.tl.y,
+        .x1 = rect.br.x, .y1 = rect.br.y,
+        .uv = GFX_QUAD_SOLID,
+        .color = bgr_pack(linear_from_sRGB(color)) | 0xFF000000,
+    };
 
     gfx_push_command(cmd, cmdbuf);
 }
@@ -3014,6 +3215,21 @@ void gui_draw_rect(Vector2 pos, Vector2 size, Vector3 color, GfxCommandBuffer *c
 }
 
 
+// NOTE(jesper): the quad only needs the texel of its top left corner, the extent is its own size times the
+// texel scale of the command, which is the font's
+GfxQuad gui_glyph_quad(GlyphRect g, Vector2 atlas_size, u32 color) INTERNAL
+{
+    u32 s = (u32)(g.s0*atlas_size.x + 0.5f);
+    u32 t = (u32)(g.t0*atlas_size.y + 0.5f);
+
+    return {
+        .x0 = g.x0, .y0 = g.y0,
+        .x1 = g.x1, .y1 = g.y1,
+        .uv = s | (t << 12) | ((u32)g.layer << 24),
+        .color = color,
+    };
+}
+
 Vector2 gui_draw_text(
     GlyphsData data,
     Vector2 pos,
@@ -3025,10 +3241,15 @@ Vector2 gui_draw_text(
     Vector2 cursor = pos;
     cursor.y += data.font->baseline;
 
-    GfxCommand cmd = gui_command(GFX_COMMAND_GUI_TEXT);
-    cmd.gui_text.font_atlas = data.font->texture;
-    cmd.gui_text.color = color;
+    GuiDrawList *list = gui_draw_target();
+    if (!list) return cursor;
 
+    GfxCommand cmd = gui_command(GFX_COMMAND_QUADS, list);
+    cmd.quads.texture = data.font->texture;
+    cmd.quads.texel_scale = font_texel_scale(data.font);
+    cmd.quads.sdf_width = font_sdf_width(data.font);
+
+    u32 packed_color = bgr_pack(color) | 0xFF000000;
     Rect *clip_rect = array_tail(gui.clip_stack);
 
     for (GlyphRect g : data.glyphs) {
@@ -3039,21 +3260,14 @@ Vector2 gui_draw_text(
 
         if (!apply_clip_rect(&g, clip_rect)) continue;
 
-        f32 verts[] = {
-            g.x0, g.y0, g.s0, g.t0,
-            g.x0, g.y1, g.s0, g.t1,
-            g.x1, g.y1, g.s1, g.t1,
+        GfxQuad *quad = (GfxQuad*)gfx_stream_push(list->quads, 1);
+        if (!quad) break;
 
-            g.x1, g.y1, g.s1, g.t1,
-            g.x1, g.y0, g.s1, g.t0,
-            g.x0, g.y0, g.s0, g.t0,
-        };
-
-        array_add(&gui.vertices, verts, ARRAY_COUNT(verts));
-        cmd.gui_text.vertex_count += ARRAY_COUNT(verts);
+        *quad = gui_glyph_quad(g, data.font->size, packed_color);
+        cmd.quads.count++;
     }
 
-    gui_push_command(array_tail(gui.draw_stack), cmd);
+    if (cmd.quads.count > 0) gfx_push_command(cmd, array_tail(gui.draw_stack));
     return cursor;
 }
 
@@ -3069,37 +3283,38 @@ Vector2 gui_draw_text(
     Vector2 cursor = pos;
     cursor.y += font->baseline;
 
-    GfxCommand cmd = gui_command(GFX_COMMAND_GUI_TEXT);
-    cmd.gui_text.font_atlas = font->texture;
-    cmd.gui_text.color = color;
+    // NOTE(jesper): the glyphs are still walked when the draws are dropped, as the cursor is returned for layout
+    GuiDrawList *list = gui_draw_target();
+    GfxCommand cmd = list ? gui_command(GFX_COMMAND_QUADS, list) : GfxCommand{ .type = GFX_COMMAND_QUADS };
+    cmd.quads.texel_scale = font_texel_scale(font);
+    cmd.quads.sdf_width = font_sdf_width(font);
 
+    u32 packed_color = bgr_pack(color) | 0xFF000000;
     Rect *clip_rect = array_tail(gui.clip_stack);
 
     char *p = text.data;
     char *end = text.data+text.length;
     while (p < end) {
         i32 c = utf32_it_next(&p, end);
-        if (c == 0) return cursor;
+        if (c == 0) break;
 
         GlyphRect g = get_glyph_rect(font, c, &cursor);
-        if (!apply_clip_rect(&g, clip_rect)) continue;
+        if (!list || !apply_clip_rect(&g, clip_rect)) continue;
 
-        f32 vertices[] = {
-            g.x0, g.y0, g.s0, g.t0,
-            g.x0, g.y1, g.s0, g.t1,
-            g.x1, g.y1, g.s1, g.t1,
-
-            g.x1, g.y1, g.s1, g.t1,
-            g.x1, g.y0, g.s1, g.t0,
-            g.x0, g.y0, g.s0, g.t0,
-        };
+        GfxQuad *quad = (GfxQuad*)gfx_stream_push(list->quads, 1);
+        if (!quad) {
+            list = nullptr;
+            continue;
+        }
 
-        array_add(&gui.vertices, vertices, ARRAY_COUNT(vertices));
-        cmd.gui_text.vertex_count += ARRAY_COUNT(vertices);
+        *quad = gui_glyph_quad(g, font->size, packed_color);
+        cmd.quads.count++;
     }
 
-    GfxCommandBuffer *cmdbuf = array_tail(gui.draw_stack);
-    gui_push_command(cmdbuf, cmd);
+    // NOTE(jesper): the atlas texture may have been replaced by a larger one while creating the glyphs. The
+    // quads address it by texel and layer, which the copy into the larger texture preserves
+    cmd.quads.texture = font->texture;
+    if (cmd.quads.count > 0) gfx_push_command(cmd, array_tail(gui.draw_stack));
 
     return cursor;
 }
@@ -157,12 +157,26 @@ struct SplitDesc {
 };
 
 
+// NOTE(jesper): draw commands along with the streams their geometry is written into. The streams belong to the list
+// and only move to their next region when the list is recorded again, so the commands can be submitted as they are
+// on later frames. They're allocated on the first recording, and kept at a fixed address for the gfx backend
+struct GuiDrawList {
+    GfxCommandBuffer commands;
+    GfxStream *quads;
+    GfxStream *vertices;
+};
+
 struct GuiWindowStateFlags {
     u32 active        : 1 = false;
     u32 was_active    : 1 = false;
     u32 hidden        : 1 = true;
     u32 has_voverflow : 1 = false;
     u32 has_hoverflow : 1 = false;
+
+    // NOTE(jesper): damaged windows are rebuilt the next time they're drawn, and rebuilt is set for the frame they
+    // were. A window that isn't keeps drawing the draw list it was last rebuilt with
+    u32 damaged       : 1 = true;
+    u32 rebuilt       : 1 = false;
 };
 
 struct GuiWindow {
@@ -171,7 +185,7 @@ struct GuiWindow {
     Rect client_rect;
     Vector2 scroll_offset;
 
-    GfxCommandBuffer command_buffer;
+    GuiDrawList draw;
 
     String title;
     Vector2 pos;
@@ -220,9 +234,7 @@ struct GuiScrollArea {
 };
 
 struct GuiContext {
-    DynamicArray<f32> vertices;
-    GLuint vbo;
-    GLuint text_vao;
+    GfxHandle text_vao;
 
     GuiId hot;
     GuiId next_hot;
@@ -237,6 +249,27 @@ struct GuiContext {
     GuiId focused_window;
 
     i32 current_window;
+
+    // NOTE(jesper): the draw list being recorded in place of the current window's, see gui_begin_draw_list
+    GuiDrawList *draw_list;
+
+    // NOTE(jesper): input is set by gui_input for any window event since the last frame, and by gui_end_frame if
+    // the hot or focused widget changed after the frame was drawn, which is what rebuilds the windows under the
+    // mouse or with focus. frame_damaged is whether any window was rebuilt, shown, or hidden by the last frame
+    bool input;
+    bool frame_damaged;
+    bool overlay_open;
+
+    struct {
+        GuiId hot, pressed, focused;
+        GuiId hot_window, focused_window;
+    } frame_state;
+
+    struct {
+        GfxHandle texture;
+        u32 generation;
+    } drawn_fonts[2];
+
     DynamicArray<GuiId> id_stack;
     DynamicArray<Rect> clip_stack;
     DynamicArray<LayoutRect> layout_stack;
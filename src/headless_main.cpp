@@ -0,0 +1,52 @@
+#include "MurmurHash/MurmurHash3.cpp"
+
+#include "core/core.h"
+#include "core/array.h"
+#include "core/string.h"
+#include "core/memory.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+extern int app_main(Array<String> args);
+extern Allocator mem_frame;
+
+#if defined(__linux__)
+extern String exe_path;
+#endif
+
+// NOTE(jesper): entry point of the software render backend. It never opens a window, so unlike linux_main.cpp
+// and win32_main.cpp nothing here, or in what it's linked with, depends on the window system or a GL driver
+int main(int argc, char **argv)
+{
+    init_default_allocators();
+    mem_frame = linear_allocator(10*MiB);
+
+#if defined(__linux__)
+    char *p = last_of(argv[0], '/');
+    if (argv[0][0] == '/') {
+        exe_path = { argv[0], (i32)(p-argv[0]) };
+    } else {
+        char buffer[PATH_MAX];
+        char *wd = getcwd(buffer, sizeof buffer);
+        PANIC_IF(wd == nullptr, "current working dir exceeds PATH_MAX");
+
+        exe_path = join_path(
+            { wd, (i32)strlen(wd) },
+            { argv[0], (i32)(p-argv[0]) },
+            mem_dynamic);
+    }
+#endif
+
+    Array<String> args{};
+    if (argc > 1) {
+        array_create(&args, argc-1, mem_dynamic);
+        for (i32 i = 1; i < argc; i++) {
+            args[i-1] = String{ argv[i], (i32)strlen(argv[i]) };
+        }
+    }
+
+    return app_main(args);
+}
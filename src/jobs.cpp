@@ -0,0 +1,133 @@
+#include "jobs.h"
+
+#include "core/core.h"
+#include "core/thread.h"
+
+#include <thread>
+
+// NOTE(jesper): created on first use, and destroyed with shutdown_job_pool when the application exits
+JobPool *job_pool;
+
+// NOTE(jesper): the batches are small, a handful of views or wrap chunks, so a linear scan for the next job
+// whose dependency is done is cheaper than tracking it
+i32 job_pool_next(JobPool *pool)
+{
+    for (i32 i = 0; i < pool->jobs.count; i++) {
+        if (pool->state[i] != JOB_PENDING) continue;
+
+        i32 after = pool->jobs[i].after;
+        if (after == -1 || pool->state[after] == JOB_DONE) return i;
+    }
+
+    return -1;
+}
+
+// NOTE(jesper): takes and runs jobs of the batch until there are none left that can be started. Called with the
+// pool's lock held, which is released while the jobs are running
+void job_pool_work(std::unique_lock<std::mutex> &lk)
+{
+    i32 index;
+    while ((index = job_pool_next(job_pool)) != -1) {
+        Job job = job_pool->jobs[index];
+        job_pool->state[index] = JOB_RUNNING;
+
+        lk.unlock();
+        job.proc(job.data);
+        lk.lock();
+
+        job_pool->state[index] = JOB_DONE;
+        if (++job_pool->jobs_done == job_pool->jobs.count) job_pool->done_cv.notify_all();
+        else job_pool->cv.notify_all();
+    }
+}
+
+int job_worker_thread(void *)
+{
+    std::unique_lock lk(job_pool->m);
+    while (true) {
+        job_pool->cv.wait(lk, [] {
+            return job_pool->quit || job_pool->queue.count > 0 || job_pool_next(job_pool) != -1;
+        });
+        if (job_pool->quit) break;
+
+        job_pool_work(lk);
+
+        if (job_pool->queue.count > 0) {
+            Job job = job_pool->queue[job_pool->queue.count-1];
+            job_pool->queue.count--;
+
+            lk.unlock();
+            job.proc(job.data);
+            lk.lock();
+        }
+    }
+
+    job_pool->threads_running--;
+    job_pool->done_cv.notify_all();
+    return 0;
+}
+
+JobPool* get_job_pool() EXPORT
+{
+    if (!job_pool) {
+        job_pool = ALLOC_T(mem_dynamic, JobPool) {};
+        job_pool->queue.alloc = mem_dynamic;
+        job_pool->thread_count = MAX((i32)std::thread::hardware_concurrency()-1, 1);
+        job_pool->threads_running = job_pool->thread_count;
+        for (i32 i = 0; i < job_pool->thread_count; i++) create_thread(job_worker_thread, nullptr);
+    }
+
+    return job_pool;
+}
+
+// NOTE(jesper): runs the jobs on the job pool and the calling thread, and returns once all of them are done.
+// Only the main thread runs batches, and jobs don't submit jobs of their own
+void run_jobs(Array<Job> jobs) EXPORT
+{
+    if (jobs.count == 0) return;
+
+    SArena scratch = tl_scratch_arena();
+    JobPool *pool = get_job_pool();
+
+    DynamicArray<JobState> state{ .alloc = scratch };
+    array_resize(&state, jobs.count);
+    memset(state.data, 0, state.count * sizeof state[0]);
+
+    std::unique_lock lk(pool->m);
+    pool->jobs = jobs;
+    pool->state = state;
+    pool->jobs_done = 0;
+    pool->cv.notify_all();
+
+    job_pool_work(lk);
+    pool->done_cv.wait(lk, [pool] { return pool->jobs_done == pool->jobs.count; });
+    pool->jobs = {};
+    pool->state = {};
+}
+
+// NOTE(jesper): queues a job to run on the job pool's workers and returns straight away. The job has to signal
+// its own completion, and its data has to outlive it
+void submit_job(Job job) EXPORT
+{
+    ASSERT(job.after == -1);
+
+    JobPool *pool = get_job_pool();
+
+    std::lock_guard lk(pool->m);
+    array_add(&pool->queue, job);
+    pool->cv.notify_one();
+}
+
+// NOTE(jesper): stops the workers once they're done with the job they're running. Jobs still queued are
+// dropped, along with their data, as this is only called when the application exits. A later run_jobs runs
+// its batch on the calling thread alone
+void shutdown_job_pool() EXPORT
+{
+    if (!job_pool) return;
+
+    std::unique_lock lk(job_pool->m);
+    job_pool->quit = true;
+    job_pool->queue.count = 0;
+    job_pool->cv.notify_all();
+    job_pool->done_cv.wait(lk, [] { return job_pool->threads_running == 0; });
+}
@@ -0,0 +1,43 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "core/array.h"
+
+#include <mutex>
+#include <condition_variable>
+
+// NOTE(jesper): a job runs on the job pool's workers or the thread that submitted it. It can depend on one
+// earlier job of the same batch, and isn't started until that one is done
+struct Job {
+    void (*proc)(void *data);
+    void *data;
+    i32 after = -1;
+};
+
+enum JobState : u8 {
+    JOB_PENDING = 0,
+    JOB_RUNNING,
+    JOB_DONE,
+};
+
+struct JobPool {
+    std::mutex m;
+    std::condition_variable cv;
+    std::condition_variable done_cv;
+
+    // NOTE(jesper): the batch of run_jobs, which the submitting thread waits on
+    Array<Job> jobs;
+    Array<JobState> state;
+    i32 jobs_done;
+
+    // NOTE(jesper): jobs of submit_job, which nothing waits on. The batch is preferred over these
+    DynamicArray<Job> queue;
+
+    i32 thread_count;
+    i32 threads_running;
+    bool quit;
+};
+
+#include "generated/jobs.h"
+
+#endif // JOBS_H
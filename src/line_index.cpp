@@ -0,0 +1,445 @@
+// NOTE(jesper): line index for buffers. Lines are stored as their lengths in bytes, including the newline,
+// in blocks of at most LINE_BLOCK_SIZE lines. A pair of Fenwick trees over the blocks' byte and line
+// counts gives O(log n) lookups from byte offset to line and from line to byte offset, and an edit only
+// has to touch the lengths of the block it lands in instead of every line after it.
+//
+// Line 0 starts at offset 0, and every subsequent line starts at the byte after the previous line's newline.
+// The last line has no newline, and may be empty. An index always has at least one line.
+
+#define LINE_BLOCK_SIZE 256
+
+struct LineBlock {
+    i64 *lengths;
+    i32 count;
+    i64 size;
+};
+
+struct LineIndex {
+    DynamicArray<LineBlock> blocks;
+
+    // NOTE(jesper): 1-indexed Fenwick trees over the blocks' size and line count
+    DynamicArray<i64> tree_size;
+    DynamicArray<i32> tree_lines;
+
+    i64 size;
+    i32 line_count;
+};
+
+void line_index_rebuild_tree(LineIndex *li)
+{
+    i32 n = li->blocks.count;
+    array_resize(&li->tree_size, n+1);
+    array_resize(&li->tree_lines, n+1);
+
+    for (i32 i = 0; i <= n; i++) {
+        li->tree_size[i] = 0;
+        li->tree_lines[i] = 0;
+    }
+
+    for (i32 i = 1; i <= n; i++) {
+        li->tree_size[i] += li->blocks[i-1].size;
+        li->tree_lines[i] += li->blocks[i-1].count;
+
+        i32 parent = i + (i & -i);
+        if (parent <= n) {
+            li->tree_size[parent] += li->tree_size[i];
+            li->tree_lines[parent] += li->tree_lines[i];
+        }
+    }
+}
+
+void line_index_tree_add(LineIndex *li, i32 block, i64 size, i32 lines)
+{
+    for (i32 i = block+1; i < li->tree_size.count; i += i & -i) {
+        li->tree_size[i] += size;
+        li->tree_lines[i] += lines;
+    }
+}
+
+// NOTE(jesper): adds the tree node for a block that was just appended to the end of the blocks array.
+// The node covers the range ]i - lowbit(i), i], so it's the block itself plus the nodes covering the rest
+void line_index_tree_append(LineIndex *li)
+{
+    if (li->tree_size.count == 0) {
+        array_add(&li->tree_size, i64(0));
+        array_add(&li->tree_lines, i32(0));
+    }
+
+    i32 i = li->tree_size.count;
+    i64 size = li->blocks[i-1].size;
+    i32 lines = li->blocks[i-1].count;
+
+    for (i32 j = i-1; j > i - (i & -i); j -= j & -j) {
+        size += li->tree_size[j];
+        lines += li->tree_lines[j];
+    }
+
+    array_add(&li->tree_size, size);
+    array_add(&li->tree_lines, lines);
+}
+
+i32 line_index_tree_step(i32 n)
+{
+    i32 step = 1;
+    while (step*2 <= n) step *= 2;
+    return step;
+}
+
+// NOTE(jesper): returns the block containing offset, and the offset and line at which the block starts.
+// Offsets at or past the end of the index resolve to the last block
+i32 line_index_find_block_by_offset(LineIndex *li, i64 offset, i64 *block_start, i32 *block_line)
+{
+    i32 n = li->blocks.count;
+    if (n == 0) return -1;
+
+    i32 pos = 0;
+    i64 size = 0;
+    i32 lines = 0;
+
+    for (i32 step = line_index_tree_step(n); step > 0; step /= 2) {
+        if (pos+step <= n && size + li->tree_size[pos+step] <= offset) {
+            pos += step;
+            size += li->tree_size[pos];
+            lines += li->tree_lines[pos];
+        }
+    }
+
+    if (pos == n) {
+        pos = n-1;
+        size -= li->blocks[pos].size;
+        lines -= li->blocks[pos].count;
+    }
+
+    *block_start = size;
+    *block_line = lines;
+    return pos;
+}
+
+// NOTE(jesper): returns the block containing line, and the offset and line at which the block starts.
+// Lines past the end of the index resolve to the last block
+i32 line_index_find_block_by_line(LineIndex *li, i32 line, i64 *block_start, i32 *block_line)
+{
+    i32 n = li->blocks.count;
+    if (n == 0) return -1;
+
+    i32 pos = 0;
+    i64 size = 0;
+    i32 lines = 0;
+
+    for (i32 step = line_index_tree_step(n); step > 0; step /= 2) {
+        if (pos+step <= n && lines + li->tree_lines[pos+step] <= line) {
+            pos += step;
+            size += li->tree_size[pos];
+            lines += li->tree_lines[pos];
+        }
+    }
+
+    if (pos == n) {
+        pos = n-1;
+        size -= li->blocks[pos].size;
+        lines -= li->blocks[pos].count;
+    }
+
+    *block_start = size;
+    *block_line = lines;
+    return pos;
+}
+
+// NOTE(jesper): replaces the lines of a block, splitting it into several blocks if they no longer fit
+void line_index_replace_block(LineIndex *li, i32 block_index, Array<i64> lengths)
+{
+    SArena scratch = tl_scratch_arena();
+
+    LineBlock *block = &li->blocks[block_index];
+
+    i32 num_blocks = MAX(1, (lengths.count + LINE_BLOCK_SIZE-1) / LINE_BLOCK_SIZE);
+    i32 per_block = lengths.count / num_blocks;
+    i32 remainder = lengths.count % num_blocks;
+
+    i64 old_size = block->size;
+    i32 old_count = block->count;
+
+    DynamicArray<LineBlock> new_blocks{ .alloc = scratch };
+
+    for (i32 i = 0, start = 0; i < num_blocks; i++) {
+        i32 count = per_block + (i < remainder ? 1 : 0);
+
+        LineBlock nb{ .count = count };
+        nb.lengths = i == 0 ? block->lengths : ALLOC_ARR(mem_dynamic, i64, LINE_BLOCK_SIZE);
+        for (i32 j = 0; j < count; j++) {
+            nb.lengths[j] = lengths[start+j];
+            nb.size += lengths[start+j];
+        }
+
+        array_add(&new_blocks, nb);
+        start += count;
+    }
+
+    li->size += (new_blocks[0].size - old_size);
+    li->line_count += (new_blocks[0].count - old_count);
+    *block = new_blocks[0];
+
+    if (num_blocks == 1) {
+        line_index_tree_add(li, block_index, block->size - old_size, block->count - old_count);
+        return;
+    }
+
+    for (i32 i = 1; i < num_blocks; i++) {
+        li->size += new_blocks[i].size;
+        li->line_count += new_blocks[i].count;
+    }
+
+    if (block_index == li->blocks.count-1) {
+        // NOTE(jesper): appending blocks is the common case when building the index, and can be done
+        // without rebuilding the trees
+        line_index_tree_add(li, block_index, block->size - old_size, block->count - old_count);
+        for (i32 i = 1; i < num_blocks; i++) {
+            array_add(&li->blocks, new_blocks[i]);
+            line_index_tree_append(li);
+        }
+    } else {
+        for (i32 i = 1; i < num_blocks; i++) array_insert(&li->blocks, block_index+i, new_blocks[i]);
+        line_index_rebuild_tree(li);
+    }
+}
+
+// NOTE(jesper): replaces a line with one or more lines. The line is given as the block it's in and its
+// index within that block
+void line_index_replace_line(LineIndex *li, i32 block_index, i32 line, Array<i64> lengths)
+{
+    LineBlock *block = &li->blocks[block_index];
+
+    if (lengths.count == 1) {
+        i64 delta = lengths[0] - block->lengths[line];
+        block->lengths[line] = lengths[0];
+        block->size += delta;
+        li->size += delta;
+        line_index_tree_add(li, block_index, delta, 0);
+        return;
+    }
+
+    SArena scratch = tl_scratch_arena();
+    DynamicArray<i64> new_lengths{ .alloc = scratch };
+    array_reserve(&new_lengths, block->count-1 + lengths.count);
+
+    for (i32 i = 0; i < line; i++) array_add(&new_lengths, block->lengths[i]);
+    for (i64 length : lengths) array_add(&new_lengths, length);
+    for (i32 i = line+1; i < block->count; i++) array_add(&new_lengths, block->lengths[i]);
+
+    line_index_replace_block(li, block_index, new_lengths);
+}
+
+// NOTE(jesper): appends a line to the end of the index
+void line_index_push(LineIndex *li, i64 length)
+{
+    if (li->blocks.count == 0 || li->blocks[li->blocks.count-1].count == LINE_BLOCK_SIZE) {
+        array_add(&li->blocks, LineBlock{ .lengths = ALLOC_ARR(mem_dynamic, i64, LINE_BLOCK_SIZE) });
+        line_index_tree_append(li);
+    }
+
+    i32 block_index = li->blocks.count-1;
+    LineBlock *block = &li->blocks[block_index];
+    block->lengths[block->count++] = length;
+    block->size += length;
+
+    li->size += length;
+    li->line_count++;
+    line_index_tree_add(li, block_index, length, 1);
+}
+
+i32 line_index_line_count(LineIndex *li)
+{
+    return MAX(1, li->line_count);
+}
+
+// NOTE(jesper): returns the line containing offset, with offsets at or past the end of the index
+// resolving to the last line
+i32 line_from_offset(LineIndex *li, i64 offset, i64 *line_start = nullptr)
+{
+    i64 start;
+    i32 line;
+    i32 block_index = line_index_find_block_by_offset(li, offset, &start, &line);
+    if (block_index == -1) {
+        if (line_start) *line_start = 0;
+        return 0;
+    }
+
+    LineBlock *block = &li->blocks[block_index];
+
+    i32 i = 0;
+    while (i < block->count-1 && start + block->lengths[i] <= offset) start += block->lengths[i++];
+
+    if (line_start) *line_start = start;
+    return line + i;
+}
+
+i64 line_start(LineIndex *li, i32 line)
+{
+    i64 start;
+    i32 block_line;
+    i32 block_index = line_index_find_block_by_line(li, line, &start, &block_line);
+    if (block_index == -1) return 0;
+
+    LineBlock *block = &li->blocks[block_index];
+    i32 end = MIN(line - block_line, block->count-1);
+    for (i32 i = 0; i < end; i++) start += block->lengths[i];
+    return start;
+}
+
+// NOTE(jesper): returns the length of the line in bytes, including its newline
+i64 line_length(LineIndex *li, i32 line)
+{
+    i64 start;
+    i32 block_line;
+    i32 block_index = line_index_find_block_by_line(li, line, &start, &block_line);
+    if (block_index == -1) return 0;
+
+    LineBlock *block = &li->blocks[block_index];
+    return block->lengths[MIN(line - block_line, block->count-1)];
+}
+
+// NOTE(jesper): splits the line containing offset such that a new line starts at offset. Used when
+// lines are discovered in existing text, i.e. when indexing a file in the background
+void line_index_split(LineIndex *li, i64 offset)
+{
+    if (li->blocks.count == 0) return;
+
+    i32 block_index = li->blocks.count-1;
+    LineBlock *block = &li->blocks[block_index];
+    i64 last_length = block->lengths[block->count-1];
+
+    if (offset > li->size - last_length) {
+        // NOTE(jesper): splitting the last line, which is always the case when indexing sequentially
+        i64 head = offset - (li->size - last_length);
+        i64 tail = last_length - head;
+
+        block->lengths[block->count-1] = head;
+        block->size -= tail;
+        li->size -= tail;
+        line_index_tree_add(li, block_index, -tail, 0);
+
+        line_index_push(li, tail);
+        return;
+    }
+
+    i64 start;
+    i32 line;
+    block_index = line_index_find_block_by_offset(li, offset, &start, &line);
+    block = &li->blocks[block_index];
+
+    i32 i = 0;
+    while (i < block->count-1 && start + block->lengths[i] <= offset) start += block->lengths[i++];
+    if (start == offset) return;
+
+    i64 lengths[] = { offset - start, block->lengths[i] - (offset - start) };
+    line_index_replace_line(li, block_index, i, { .data = lengths, .count = 2 });
+}
+
+// NOTE(jesper): updates the index for text inserted at offset, splitting the line it's inserted into
+// at each of the text's newlines
+void line_index_insert(LineIndex *li, i64 offset, String text)
+{
+    if (text.length <= 0) return;
+    if (li->blocks.count == 0) line_index_push(li, 0);
+
+    SArena scratch = tl_scratch_arena();
+
+    i64 start;
+    i32 line;
+    i32 block_index = line_index_find_block_by_offset(li, offset, &start, &line);
+    LineBlock *block = &li->blocks[block_index];
+
+    i32 i = 0;
+    while (i < block->count-1 && start + block->lengths[i] <= offset) start += block->lengths[i++];
+
+    i64 head = offset - start;
+    i64 tail = block->lengths[i] - head;
+
+    DynamicArray<i64> lengths{ .alloc = scratch };
+
+    i64 current = head;
+    for (i32 j = 0; j < text.length; j++) {
+        char c = text[j];
+        current++;
+
+        if (c == '\n' || c == '\r') {
+            if (j+1 < text.length &&
+                ((c == '\n' && text[j+1] == '\r') ||
+                 (c == '\r' && text[j+1] == '\n')))
+            {
+                j++;
+                current++;
+            }
+
+            array_add(&lengths, current);
+            current = 0;
+        }
+    }
+
+    array_add(&lengths, current + tail);
+    line_index_replace_line(li, block_index, i, lengths);
+}
+
+// NOTE(jesper): removes lines [first, first+count[
+void line_index_remove_lines(LineIndex *li, i32 first, i32 count)
+{
+    i64 block_start;
+    i32 block_line;
+    i32 block_index = line_index_find_block_by_line(li, first, &block_start, &block_line);
+    if (block_index == -1) return;
+
+    bool blocks_emptied = false;
+
+    i32 local = first - block_line;
+    for (i32 b = block_index; count > 0 && b < li->blocks.count; b++, local = 0) {
+        LineBlock *block = &li->blocks[b];
+
+        i32 n = MIN(count, block->count - local);
+        i64 removed = 0;
+        for (i32 i = local; i < local+n; i++) removed += block->lengths[i];
+
+        memmove(block->lengths+local, block->lengths+local+n, (block->count-local-n) * sizeof *block->lengths);
+        block->count -= n;
+        block->size -= removed;
+
+        li->size -= removed;
+        li->line_count -= n;
+        count -= n;
+
+        line_index_tree_add(li, b, -removed, -n);
+        blocks_emptied = blocks_emptied || block->count == 0;
+    }
+
+    if (blocks_emptied) {
+        for (i32 b = 0; b < li->blocks.count; b++) {
+            if (li->blocks[b].count > 0) continue;
+            FREE(mem_dynamic, li->blocks[b].lengths);
+            array_remove(&li->blocks, b--);
+        }
+
+        line_index_rebuild_tree(li);
+    }
+}
+
+// NOTE(jesper): updates the index for the removal of the bytes in [start, end[, joining the lines that
+// contain start and end
+void line_index_remove(LineIndex *li, i64 start, i64 end)
+{
+    if (end <= start || li->blocks.count == 0) return;
+
+    i64 first_start;
+    i32 first = line_from_offset(li, start, &first_start);
+
+    i64 last_start;
+    i32 last = line_from_offset(li, end, &last_start);
+    i64 last_end = last_start + line_length(li, last);
+
+    if (last > first) line_index_remove_lines(li, first+1, last-first);
+
+    i64 block_start;
+    i32 block_line;
+    i32 block_index = line_index_find_block_by_line(li, first, &block_start, &block_line);
+
+    i64 length = (start - first_start) + (last_end - end);
+    line_index_replace_line(li, block_index, first - block_line, { .data = &length, .count = 1 });
+}
@@ -0,0 +1,63 @@
+#include "core/core.h"
+#include "core/string.h"
+#include "core/memory.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char* map_file_readonly(String path, i64 *size)
+{
+    SArena scratch = tl_scratch_arena();
+
+    int fd = open(sz_string(path, scratch), O_RDONLY);
+    if (fd == -1) {
+        LOG_ERROR("failed to open file '%.*s'", STRFMT(path));
+        return nullptr;
+    }
+    defer { close(fd); };
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) return nullptr;
+
+    // NOTE(jesper): private and read-only, the pages are only faulted in as they are read and are
+    // backed by the page cache, so resident memory follows whatever part of the file has been viewed
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("failed to map file '%.*s'", STRFMT(path));
+        return nullptr;
+    }
+
+    *size = st.st_size;
+    return (char*)data;
+}
+
+void unmap_file(char *data, i64 size)
+{
+    munmap(data, size);
+}
+
+i64 get_file_size(String path)
+{
+    SArena scratch = tl_scratch_arena();
+
+    struct stat st;
+    if (stat(sz_string(path, scratch), &st) == -1) return -1;
+
+    return st.st_size;
+}
+
+bool replace_file(String dst, String src)
+{
+    SArena scratch = tl_scratch_arena();
+
+    // NOTE(jesper): rename replaces the directory entry, any existing mappings of dst keep referring
+    // to the old contents until they're unmapped
+    if (rename(sz_string(src, scratch), sz_string(dst, scratch)) != 0) {
+        LOG_ERROR("failed to replace file '%.*s' with '%.*s'", STRFMT(dst), STRFMT(src));
+        return false;
+    }
+
+    return true;
+}
@@ -6,6 +6,7 @@
 #include "core/memory.h"
 
 #include <unistd.h>
+#include <stdio.h>
 
 extern int app_main(Array<String> args);
 extern Allocator mem_frame;
@@ -8,6 +8,10 @@
 
 #include "gui.cpp"
 #include "fzy.cpp"
+#include "piece_table.cpp"
+#include "line_index.cpp"
+#include "view_lines.cpp"
+#include "jobs.h"
 
 #include "tree_sitter/api.h"
 extern "C" const TSLanguage* tree_sitter_cpp();
@@ -17,17 +21,62 @@ extern "C" const TSLanguage* tree_sitter_c_sharp();
 extern "C" const TSLanguage* tree_sitter_lua();
 extern "C" const TSLanguage* tree_sitter_comment();
 
+extern char* map_file_readonly(String path, i64 *size);
+extern void unmap_file(char *data, i64 size);
+extern bool replace_file(String dst, String src);
+extern i64 get_file_size(String path);
+
 #include "external/subprocess/subprocess.h"
 #include "external/mjson/src/mjson.h"
 
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define DEBUG_LINE_WRAP_RECALC 0
 #define DEBUG_TREE_SITTER_SYNTAX_TREE 0
 #define DEBUG_TREE_SITTER_COLORS 0
 #define DEBUG_TREE_SITTER_INJECTIONS 0
 
+// NOTE(jesper): files at or above this size are opened with a piece table backend instead of a flat
+// buffer, to avoid memmoving the entire tail of the buffer on every edit
+#define BUFFER_PIECE_THRESHOLD (4*MiB)
+
+// NOTE(jesper): files at or above this size are memory mapped instead of read, and their line index is
+// built on a background thread, so that opening them doesn't stall on reading and scanning the whole file
+#define BUFFER_MAPPED_THRESHOLD (64*MiB)
+#define LINE_INDEX_CHUNK_SIZE (1*MiB)
+
+#define SYNTAX_COLOR_NONE 0xFFFFFFFF
+
+// NOTE(jesper): parses taking longer than the budget, or buffers larger than the language's size limit,
+// give up on tree-sitter and fall back to fallback_highlight for the visible window
+#define SYNTAX_PARSE_BUDGET_MICROS (2*1000*1000)
+#define SYNTAX_SIZE_LIMIT (16*MiB)
+#define FALLBACK_HIGHLIGHT_MAX_BYTES (256*1024)
+
+// NOTE(jesper): the number of buffer lines a view keeps wrapped while scrolling before the wrapped window is
+// replaced instead of extended
+#define VIEW_WRAP_MAX_LINES 16384
+
+// NOTE(jesper): ranges of lines at least this large are split into chunks at buffer lines and wrapped in
+// parallel on the wrap workers
+#define WRAP_PARALLEL_MIN_BYTES (256*1024)
+#define WRAP_CHUNK_MIN_BYTES (64*1024)
+#define WRAP_MAX_CHUNKS 32
+
+// NOTE(jesper): the pixel height the text of views is drawn at, and the range it can be zoomed in. Only SDF fonts
+// can be zoomed, as they're drawn at any size from the same atlas
+#define MONO_FONT_PIXEL_HEIGHT 18
+#define MONO_FONT_MIN_PIXEL_HEIGHT 8
+#define MONO_FONT_MAX_PIXEL_HEIGHT 72
+#define MONO_FONT_ZOOM_STEP 2
+
 enum {
     APP_INPUT = APP_INPUT_ID_START,
 
@@ -38,6 +87,9 @@ enum {
 
     GOTO_DEFINITION,
 
+    ZOOM_IN,
+    ZOOM_OUT,
+
     COPY_RANGE,
     CUT_RANGE,
     DELETE_RANGE,
@@ -71,6 +123,39 @@ enum Language {
 struct SyntaxTree {
     Language language;
     TSTree *tree;
+
+    // NOTE(jesper): the host range an injected tree was parsed from
+    TSRange range;
+
+    // NOTE(jesper): the bytes the tree has been moved by, by edits before its range, since its nodes were last
+    // edited. Its nodes are at the buffer offsets minus the shift until ts_subtree_apply_shift edits them
+    i64 shift;
+
+    // NOTE(jesper): identifies the tree across the syntax worker's trees and the copies the buffer has of them
+    u32 id;
+};
+
+struct SyntaxEdit {
+    u64 version;
+    TSInputEdit edit;
+};
+
+struct SyntaxWorker;
+
+struct RangeColor {
+    i64 start, end;
+    u32 color;
+
+    bool operator>(const RangeColor &rhs) { return start > rhs.start; }
+    bool operator<(const RangeColor &rhs) { return start < rhs.start; }
+};
+
+// NOTE(jesper): resolved highlight spans of a buffer line, relative to the start of the line, so that the
+// spans of lines unaffected by an edit remain valid as the lines are shifted around
+struct HighlightLine {
+    RangeColor *spans;
+    i32 count;
+    bool valid;
 };
 
 enum ViewFlags : u32 {
@@ -85,12 +170,6 @@ struct Range_i32 {
     i32 start, end;
 };
 
-
-struct ViewLine {
-    i64 offset : 63;
-    i64 wrapped : 1;
-};
-
 enum NewlineMode {
     NEWLINE_LF = 0,
     NEWLINE_CR,
@@ -100,6 +179,35 @@ enum NewlineMode {
 
 enum BufferType {
     BUFFER_FLAT,
+    BUFFER_PIECE,
+    BUFFER_MAPPED,
+};
+
+// NOTE(jesper): an edit made to a buffer while its line index job is running, replacing the bytes in [start, end[
+// with new_end-start bytes
+struct LineIndexEdit {
+    i64 start, end, new_end;
+};
+
+struct LineIndexJob {
+    char *path;
+
+    std::mutex m;
+    std::condition_variable cv;
+    DynamicArray<i64> line_starts;
+    bool done;
+
+    // NOTE(jesper): the job finds the lines of the file as it was opened, so the edits made since are kept to move
+    // the lines it finds to where they are in the buffer. Only accessed by the main thread
+    DynamicArray<LineIndexEdit> edits;
+};
+
+// NOTE(jesper): the contents of a flat buffer while syntax snapshots reference them. The buffer and each snapshot
+// hold a reference, and the data is freed by the snapshot that releases the last one once the buffer has let go
+// of it, see buffer_unshare_flat
+struct FlatShare {
+    char *data;
+    i32 refs;
 };
 
 #define BUFFER_INVALID BufferId{ -1 }
@@ -118,6 +226,9 @@ struct BufferHistory {
         struct {
             i64 offset;
             String text;
+            // NOTE(jesper): text references immutable buffer storage, i.e. a piece table's original
+            // or add blocks, instead of a copy owned by the history
+            bool text_ref;
         };
         struct {
             i32 view_id;
@@ -137,6 +248,16 @@ struct Buffer {
     TSTree *syntax_tree;
     DynamicArray<SyntaxTree> subtrees;
 
+    // NOTE(jesper): version is bumped on every edit, syntax_version is the version the displayed syntax
+    // trees were parsed from, and syntax_edits the edits made since that need re-applying on adoption
+    SyntaxWorker *syntax_worker;
+    u64 version;
+    u64 syntax_version;
+    DynamicArray<SyntaxEdit> syntax_edits;
+
+    DynamicArray<HighlightLine> highlights;
+    bool syntax_degraded;
+
     DynamicArray<BufferHistory> history;
     i32 history_index;
     i32 saved_at;
@@ -147,10 +268,18 @@ struct Buffer {
 
     BufferType type;
     union {
-        struct { char *data; i64 size; i64 capacity; } flat;
+        struct { char *data; i64 size; i64 capacity; FlatShare *shared; } flat;
+        PieceTable *piece;
     };
 
-    DynamicArray<i64> line_offsets;
+    // NOTE(jesper): the read-only file mapping of BUFFER_MAPPED buffers, which remains the original
+    // contents of the piece table they're converted to on first edit
+    struct { char *data; i64 size; } mapping;
+
+    LineIndex line_index;
+    LineIndexJob *line_index_job;
+
+    bool line_wrap = true;
 };
 
 struct ProcessCommand {
@@ -171,6 +300,22 @@ struct Caret {
     i32 wrapped_line = 0;
 };
 
+// NOTE(jesper): the lines of a view are only wrapped for the buffer lines in [first, last[, which covers
+// the visible part of the view plus a margin. Every other buffer line counts as a single line taken from
+// the buffer's line index, so count is an estimate of the total that's refined as the view is scrolled
+struct ViewLines {
+    BufferId buffer;
+    ViewLineBlocks wrapped;
+
+    i32 first, last;
+    i64 wrapped_end;
+
+    i32 line_count;
+    i32 count;
+
+    ViewLine operator[](i32 line) const;
+};
+
 struct ViewBufferState {
     BufferId buffer;
     Caret caret, mark;
@@ -179,22 +324,98 @@ struct ViewBufferState {
     i32 line_offset;
 };
 
+struct GlyphCell {
+    u32 glyph_index;
+    u32 fg;
+};
+
+// NOTE(jesper): what a row of the glyph grid was last encoded from. A row is only rewritten when the view line
+// it shows, the bytes of that line, or its highlight spans change
+struct GlyphGridRow {
+    i32 line;
+    i64 start, end;
+    u32 colors_hash;
+};
+
+// NOTE(jesper): everything the rows of a view's glyph grid are derived from other than the grid's own parameters.
+// If none of it changed since the last frame the view's highlight query and row checks are skipped entirely
+struct GlyphGridSource {
+    u64 version;
+    u64 syntax_version;
+    bool syntax_degraded;
+
+    i32 line_offset;
+    i32 line_count;
+    i32 first, last;
+    i64 wrapped_end;
+    i32 count;
+
+    bool operator==(const GlyphGridSource &rhs) const = default;
+};
+
+// NOTE(jesper): the glyph cells of a view, in a persistently and coherently mapped SSBO. View line i is kept in
+// row i % rows, and the shader applies the same mapping using the view's line offset, so scrolling only has to
+// encode the rows that came into view
+struct GlyphGrid {
+    GfxHandle ssbo;
+    GfxFence fence;
+    GlyphCell *cells;
+    i32 capacity;
+
+    i32 columns, rows;
+    BufferId buffer;
+    u32 atlas_generation;
+    u32 fg;
+    i32 tab_width;
+
+    GlyphGridSource source;
+    DynamicArray<GlyphGridRow> row_state;
+};
+
+// NOTE(jesper): everything a view's draw list is recorded from, other than the contents of its glyph grid, whose
+// re-encoded rows mark the view dirty instead. The draw list is only re-recorded if this changed since it last was
+struct ViewDrawSource {
+    f32 x0, y0, x1, y1;
+    f32 voffset;
+    i32 line_offset;
+    i32 lines_visible;
+
+    i32 caret_line, mark_line;
+    i64 caret_column, mark_column;
+
+    GfxHandle glyph_atlas;
+    GfxHandle glyph_ssbo;
+    f32 cell_width, cell_height;
+    f32 atlas_cell_width, atlas_cell_height;
+    f32 sdf_width;
+    i32 columns, rows;
+    bool has_buffer;
+
+    bool operator==(const ViewDrawSource &rhs) const = default;
+};
+
 struct View {
     i32 id = -1;
     GuiId gui_id;
 
-    GLuint glyph_data_ssbo;
+    GlyphGrid glyphs;
     DynamicArray<BufferId> buffers;
     DynamicArray<ViewBufferState> saved_buffer_state;
-    DynamicArray<ViewLine> lines;
+    ViewLines lines;
 
     f32 voffset;
     i32 line_offset;
     i32 lines_visible;
+    f32 wrap_width;
 
     Rect rect;
     Rect text_rect;
 
+    // NOTE(jesper): the view's draw commands, kept across frames and submitted in view order. They're re-recorded
+    // when draw_dirty is set or drawn differs from what the view would draw now
+    GuiDrawList draw;
+    ViewDrawSource drawn;
+
     BufferId buffer;
     Caret caret, mark;
 
@@ -202,6 +423,7 @@ struct View {
         u64 lines_dirty : 1;
         u64 caret_dirty : 1;
         u64 defer_move_view_to_caret : 1;
+        u64 draw_dirty : 1;
     };
 };
 
@@ -324,8 +546,20 @@ enum LspTextDocumentSaveReason {
 struct Application {
     AppWindow *wnd;
     FontAtlas mono;
+    f32 mono_pixel_height = MONO_FONT_PIXEL_HEIGHT;
+
+    // NOTE(jesper): draw the text from signed distance field atlases, set with --sdf-fonts
+    bool sdf_fonts;
+
     bool animating = true;
 
+    // NOTE(jesper): a frame in which no view was re-recorded, no GUI window was rebuilt, shown, or hidden, and no
+    // glyphs were written to the atlases is neither submitted nor presented, and idle is set
+    struct {
+        bool glyphs_written;
+        bool idle;
+    } damage;
+
     struct {
         bool active;
         DynamicArray<String> values;
@@ -348,6 +582,7 @@ struct Application {
     const TSLanguage *languages[LANGUAGE_COUNT];
     TSQuery *highlights[LANGUAGE_COUNT];
     TSQuery *injections[LANGUAGE_COUNT];
+    i64 syntax_size_limit[LANGUAGE_COUNT];
 
     struct {
         InputMapId insert;
@@ -371,19 +606,15 @@ struct Application {
 
     DynamicMap<String, u32> syntax_colors;
 
+    // NOTE(jesper): syntax_colors resolved for each capture id of the highlight queries, rebuilt by
+    // ts_build_capture_colors when the colors change
+    DynamicArray<u32> capture_colors[LANGUAGE_COUNT];
+
     struct {
-        GLuint build;
+        GfxHandle build;
     } icons;
 };
 
-struct RangeColor {
-    i64 start, end;
-    u32 color;
-
-    bool operator>(const RangeColor &rhs) { return start > rhs.start; }
-    bool operator<(const RangeColor &rhs) { return start < rhs.start; }
-};
-
 #include "generated/internal/mimir.h"
 
 u32 hash32(BufferId buffer, u32 seed /*= MURMUR3_SEED */) INTERNAL
@@ -437,10 +668,17 @@ struct {
     struct {
         GuiId wnd;
     } buffer_history;
+
+    struct {
+        GuiId wnd;
+    } syntax_memory;
 } debug{};
 
 
 void move_view_to_caret(View *view);
+void view_lines_update(ViewLines *lines);
+void view_lines_reset(ViewLines *lines, BufferId buffer);
+i64 line_start_offset(i32 line, ViewLines lines);
 
 
 Buffer* get_buffer(BufferId buffer_id)
@@ -460,6 +698,56 @@ bool buffer_valid(BufferId buffer_id)
     return buffer_id.index >= 0;
 }
 
+i64 buffer_end(Buffer *buffer)
+{
+    switch (buffer->type) {
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return buffer->flat.size;
+    case BUFFER_PIECE: return buffer->piece->size;
+    }
+}
+
+ViewLine ViewLines::operator[](i32 line) const
+{
+    if (line >= first && line < first + wrapped.count) return view_line_get(&wrapped, line-first);
+
+    Buffer *b = get_buffer(buffer);
+    if (!b) return {};
+
+    i32 buffer_line = line < first ? line : line - wrapped.count + last - first;
+    return { line_start(&b->line_index, buffer_line), 0 };
+}
+
+// NOTE(jesper): returns the contiguous run of bytes in the buffer's storage starting at offset. For
+// flat and mapped buffers this is the remainder of the buffer, for piece buffers it's the remainder of the piece
+String buffer_chunk_at(Buffer *buffer, i64 offset)
+{
+    if (offset >= buffer_end(buffer)) return {};
+
+    switch (buffer->type) {
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return { buffer->flat.data+offset, (i32)MIN(buffer->flat.size-offset, i32_MAX) };
+    case BUFFER_PIECE: return piece_chunk_at(buffer->piece, offset);
+    }
+}
+
+// NOTE(jesper): returns the contiguous run of bytes in the buffer's storage ending at offset
+String buffer_chunk_before(Buffer *buffer, i64 offset)
+{
+    if (offset <= 0 || offset > buffer_end(buffer)) return {};
+
+    switch (buffer->type) {
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED: {
+            i32 length = (i32)MIN(offset, i32_MAX);
+            return { buffer->flat.data+offset-length, length };
+        }
+    case BUFFER_PIECE: return piece_chunk_before(buffer->piece, offset);
+    }
+}
+
 TSLogger ts_logger  {
     .payload = nullptr,
     .log = [](void */*payload*/, TSLogType type, const char *msg) {
@@ -472,52 +760,164 @@ TSLogger ts_logger  {
     }
 };
 
-Allocator ts_custom_alloc;
+// NOTE(jesper): tree-sitter allocations are made from the heap of the buffer whose syntax trees are being
+// parsed or edited on the current thread, so each buffer's parse worker allocates without contending with
+// the others, and all of a buffer's tree memory can be released at once by destroying its heap. Allocations
+// made outside of any heap, e.g. queries, fall back to libc. The header records the owning heap, so memory
+// can be freed from any thread
+#define TS_HEAP_BLOCK_SIZE (1*MiB)
+#define TS_HEAP_MIN_CLASS 5
+#define TS_HEAP_CLASS_COUNT 48
+
+struct TsHeap {
+    std::mutex m;
+    Language language;
+
+    DynamicArray<char*> blocks;
+    char *head;
+    i64 remaining;
 
-struct ts_alloc_header {
-    size_t size;
-    size_t pad;
+    void *free_lists[TS_HEAP_CLASS_COUNT];
+    i64 in_use;
 };
 
-void* ts_custom_malloc(size_t size)
-{
-    if (size == 0) return nullptr;
+struct TsAllocHeader {
+    TsHeap *heap;
+    u64 size;
+};
 
-    void *ptr = ALLOC(ts_custom_alloc, size+sizeof(ts_alloc_header));
-    auto header = (ts_alloc_header*)ptr;
-    header->size = size;
-    return (u8*)header + sizeof *header;
+thread_local TsHeap *tl_ts_heap;
+
+TsHeap* create_ts_heap(Language language)
+{
+    TsHeap *heap = ALLOC_T(mem_dynamic, TsHeap) {};
+    heap->language = language;
+    return heap;
 }
 
-void* ts_custom_calloc(size_t count, size_t size)
+void destroy_ts_heap(TsHeap *heap)
 {
-    if (size == 0) return nullptr;
+    for (char *block : heap->blocks) FREE(mem_dynamic, block);
+    FREE(mem_dynamic, heap->blocks.data);
+    FREE(mem_dynamic, heap);
+}
 
-    void *ptr = ts_custom_malloc(count*size);
-    memset(ptr, 0, count*size);
-    return ptr;
+i32 ts_heap_class(u64 size)
+{
+    i32 c = TS_HEAP_MIN_CLASS;
+    while ((1ull << c) < size) c++;
+    return c;
 }
 
-void* ts_custom_realloc(void *ptr, size_t size)
+void* ts_heap_malloc(size_t size)
 {
     if (size == 0) return nullptr;
-    if (ptr == nullptr) return ts_custom_malloc(size);
 
-    auto header = (ts_alloc_header*)((u8*)ptr - sizeof(ts_alloc_header));
-    void *nptr = REALLOC(ts_custom_alloc, header, header->size+sizeof(ts_alloc_header), size+sizeof(ts_alloc_header));
+    TsHeap *heap = tl_ts_heap;
+    TsAllocHeader *header;
 
-    header = (ts_alloc_header*)nptr;
+    if (!heap) {
+        header = (TsAllocHeader*)malloc(size + sizeof *header);
+        PANIC_IF(!header, "tree-sitter failed to allocate");
+    } else {
+        i32 c = ts_heap_class(size + sizeof *header);
+        i64 class_size = 1ll << c;
+
+        std::lock_guard lk(heap->m);
+        if (void *p = heap->free_lists[c]; p) {
+            heap->free_lists[c] = *(void**)p;
+            header = (TsAllocHeader*)p;
+        } else if (class_size > TS_HEAP_BLOCK_SIZE/4) {
+            header = (TsAllocHeader*)ALLOC(mem_dynamic, class_size);
+            array_add(&heap->blocks, (char*)header);
+        } else {
+            if (heap->remaining < class_size) {
+                heap->head = ALLOC_ARR(mem_dynamic, char, TS_HEAP_BLOCK_SIZE);
+                heap->remaining = TS_HEAP_BLOCK_SIZE;
+                array_add(&heap->blocks, heap->head);
+            }
+
+            header = (TsAllocHeader*)heap->head;
+            heap->head += class_size;
+            heap->remaining -= class_size;
+        }
+
+        heap->in_use += size;
+    }
+
+    header->heap = heap;
     header->size = size;
-    return (u8*)header + sizeof *header;
+    return header+1;
+}
 
+void* ts_heap_calloc(size_t count, size_t size)
+{
+    void *ptr = ts_heap_malloc(count*size);
+    if (ptr) memset(ptr, 0, count*size);
+    return ptr;
 }
 
-void ts_custom_free(void *ptr)
+void ts_heap_free(void *ptr)
 {
     if (!ptr) return;
 
-    auto header = (ts_alloc_header*)((u8*)ptr - sizeof(ts_alloc_header));
-    FREE(ts_custom_alloc, header);
+    TsAllocHeader *header = (TsAllocHeader*)ptr - 1;
+    TsHeap *heap = header->heap;
+
+    if (!heap) {
+        free(header);
+        return;
+    }
+
+    i32 c = ts_heap_class(header->size + sizeof *header);
+
+    std::lock_guard lk(heap->m);
+    heap->in_use -= header->size;
+    *(void**)header = heap->free_lists[c];
+    heap->free_lists[c] = header;
+}
+
+void* ts_heap_realloc(void *ptr, size_t size)
+{
+    if (!ptr) return ts_heap_malloc(size);
+    if (size == 0) {
+        ts_heap_free(ptr);
+        return nullptr;
+    }
+
+    TsAllocHeader *header = (TsAllocHeader*)ptr - 1;
+    TsHeap *heap = header->heap;
+
+    if (!heap) {
+        header = (TsAllocHeader*)realloc(header, size + sizeof *header);
+        PANIC_IF(!header, "tree-sitter failed to reallocate");
+
+        header->size = size;
+        return header+1;
+    }
+
+    if (ts_heap_class(size + sizeof *header) == ts_heap_class(header->size + sizeof *header)) {
+        std::lock_guard lk(heap->m);
+        heap->in_use += (i64)size - (i64)header->size;
+        header->size = size;
+        return ptr;
+    }
+
+    // NOTE(jesper): grow within the heap the memory belongs to, regardless of the current thread's heap
+    TsHeap *current = tl_ts_heap;
+    tl_ts_heap = heap;
+    void *nptr = ts_heap_malloc(size);
+    tl_ts_heap = current;
+
+    memcpy(nptr, ptr, MIN(size, header->size));
+    ts_heap_free(ptr);
+    return nptr;
+}
+
+i64 ts_heap_in_use(TsHeap *heap)
+{
+    std::lock_guard lk(heap->m);
+    return heap->in_use;
 }
 
 TSQuery* ts_create_query(const TSLanguage *lang, String highlights)
@@ -549,25 +949,49 @@ TSQuery* ts_create_query(const TSLanguage *lang, String highlights)
     return nullptr;
 }
 
-DynamicMap<Language, DynamicArray<TSRange>> ts_get_injection_ranges(
-    Buffer *buffer,
-    TSQuery *injection_query,
-    Allocator mem)
+// NOTE(jesper): returns the index of the first tree whose range starts at or after offset
+i32 ts_subtree_lower_bound(DynamicArray<SyntaxTree> *subtrees, u32 offset)
 {
-    if (!buffer) return {};
-    if (!buffer->syntax_tree) return {};
-
-    SArena scratch = tl_scratch_arena(mem);
+    i32 lo = 0, hi = subtrees->count;
+    while (lo < hi) {
+        i32 mid = lo + (hi-lo)/2;
+        if (subtrees->at(mid).range.start_byte < offset) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
 
-    ASSERT(injection_query);
+// NOTE(jesper): whether the trees have one for the injected language that starts at start_byte
+bool ts_subtree_exists(DynamicArray<SyntaxTree> *subtrees, u32 start_byte, Language language)
+{
+    for (i32 i = ts_subtree_lower_bound(subtrees, start_byte);
+         i < subtrees->count && subtrees->at(i).range.start_byte == start_byte;
+         i++)
+    {
+        if (subtrees->at(i).language == language) return true;
+    }
+    return false;
+}
 
-    DynamicMap<Language, DynamicArray<TSRange>> lang_range_map{ .alloc = mem };
+// NOTE(jesper): adds the injected ranges captured in [start_byte, end_byte[ of the tree to injections,
+// keeping them sorted by start and skipping any that have already been captured, or that are in kept. The
+// query returns the injections that start at start_byte when the range is empty, which can be injections
+// that were kept because an empty range doesn't intersect them
+void ts_get_injection_ranges(
+    DynamicArray<SyntaxTree> *injections,
+    DynamicArray<SyntaxTree> *kept,
+    TSTree *syntax_tree,
+    TSQuery *injection_query,
+    TSQueryCursor *cursor,
+    u32 start_byte,
+    u32 end_byte)
+{
+    if (!syntax_tree) return;
 
-    TSNode root = ts_tree_root_node(buffer->syntax_tree);
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    defer { ts_query_cursor_delete(cursor); };
+    ASSERT(injection_query);
 
-    ts_query_cursor_set_byte_range(cursor, 0, buffer->flat.size);
+    TSNode root = ts_tree_root_node(syntax_tree);
+    ts_query_cursor_set_byte_range(cursor, start_byte, MAX(end_byte, start_byte+1));
     ts_query_cursor_exec(cursor, injection_query, root);
 
     TSQueryMatch match;
@@ -580,135 +1004,789 @@ DynamicMap<Language, DynamicArray<TSRange>> ts_get_injection_ranges(
         String capture_name{ (char*)tmp, (i32)capture_name_length };
 
         if (Language *l = map_find(&app.language_map, capture_name); l) {
-            DynamicArray<TSRange> *ranges = map_find_emplace(&lang_range_map, *l, { .alloc = mem });
-
-            u32 start_byte = ts_node_start_byte(capture->node);
-            u32 end_byte = ts_node_end_byte(capture->node);
-
-            array_add(ranges, {
+            TSRange range{
                 .start_point = ts_node_start_point(capture->node),
                 .end_point = ts_node_end_point(capture->node),
-                .start_byte = start_byte,
-                .end_byte = end_byte,
-            });
+                .start_byte = ts_node_start_byte(capture->node),
+                .end_byte = ts_node_end_byte(capture->node),
+            };
+
+            if (ts_subtree_exists(injections, range.start_byte, *l) ||
+                ts_subtree_exists(kept, range.start_byte, *l))
+            {
+                continue;
+            }
+
+            i32 i = ts_subtree_lower_bound(injections, range.start_byte);
+            array_insert(injections, i, { .language = *l, .range = range });
         }
     }
-
-    return lang_range_map;
 }
 
-void ts_parse_buffer(Buffer *buffer, TSInputEdit edit = {}) INTERNAL
-{
-    SArena scratch = tl_scratch_arena();
-
-    auto lang = app.languages[buffer->language];
-    if (!lang) return;
+// NOTE(jesper): the buffer contents as of a given edit, handed to the syntax worker so that it can parse while
+// the main thread keeps editing the buffer. The text itself isn't copied: piece buffers are referenced through the
+// table's immutable storage, and flat buffers through a shared reference to their contents, which the buffer
+// copies before editing them if a snapshot that's being parsed still references them
+struct SyntaxSnapshot {
+    DynamicArray<Piece> pieces;
+    DynamicArray<i64> starts;
+    FlatShare *shared;
+    i64 size;
 
-    TSParser *parser = ts_parser_new();
-    defer { ts_parser_delete(parser); };
-    ts_parser_set_language(parser, lang);
-    buffer->syntax_tree = ts_parser_parse_string(parser, buffer->syntax_tree, buffer->flat.data, buffer->flat.size);
-
-    if (auto inj = app.injections[buffer->language]; inj) {
-        DynamicMap<Language, DynamicArray<TSRange>> lang_range_map = ts_get_injection_ranges(buffer, inj, scratch);
-
-        for (auto it : lang_range_map) {
-            SyntaxTree *subtree = nullptr;
-            for (auto &st : buffer->subtrees) {
-                if (st.language == it.key) {
-                    subtree = &st;
-                    break;
-                }
-            }
+    i32 last;
+};
 
-            if (!subtree) {
-                i32 i = array_add(&buffer->subtrees, {
-                    .language = (Language)it.key,
-                });
-                subtree = &buffer->subtrees[i];
-            }
+SyntaxSnapshot* create_syntax_snapshot(Buffer *buffer)
+{
+    SyntaxSnapshot *snapshot = ALLOC_T(mem_dynamic, SyntaxSnapshot) {};
+    snapshot->size = buffer_end(buffer);
 
-            DynamicArray<TSRange> invalid_ranges{ .alloc = scratch };
-            array_reserve(&invalid_ranges, it->count);
+    switch (buffer->type) {
+    case BUFFER_FLAT:
+        if (!buffer->flat.shared) {
+            buffer->flat.shared = ALLOC_T(mem_dynamic, FlatShare) { .data = buffer->flat.data, .refs = 1 };
+        }
 
-            if (edit.old_end_byte == edit.new_end_byte) {
-                array_copy(&invalid_ranges, *it);
-            } else {
-                for (auto range : *it) {
-                    if (range.start_byte >= edit.old_end_byte) continue;
-                    if (range.end_byte <= edit.start_byte) continue;
-                    array_add(&invalid_ranges, range);
-                }
-            }
+        __atomic_add_fetch(&buffer->flat.shared->refs, 1, __ATOMIC_SEQ_CST);
+        snapshot->shared = buffer->flat.shared;
+        array_add(&snapshot->pieces, Piece{ buffer->flat.data, buffer->flat.size });
+        break;
+    case BUFFER_MAPPED:
+        array_add(&snapshot->pieces, Piece{ buffer->flat.data, buffer->flat.size });
+        break;
+    case BUFFER_PIECE:
+        piece_collect(buffer->piece, buffer->piece->root, &snapshot->pieces);
+        break;
+    }
 
-            if (invalid_ranges.count) {
-                LOG_INFO("updating %d (%d) injected %.*s ranges", invalid_ranges.count, it->count, STRFMT(string_from_enum((Language)it.key)));
-                for (auto range : invalid_ranges) LOG_INFO("injected range: [%u, %u]", range.start_byte, range.end_byte);
+    array_reserve(&snapshot->starts, snapshot->pieces.count);
 
-                ts_parser_set_language(parser, app.languages[it.key]);
-                ts_parser_set_included_ranges(parser, invalid_ranges.data, invalid_ranges.count);
-                subtree->tree = ts_parser_parse_string(parser,  subtree->tree, buffer->flat.data, buffer->flat.size);
-            }
-        }
+    i64 start = 0;
+    for (Piece piece : snapshot->pieces) {
+        array_add(&snapshot->starts, start);
+        start += piece.length;
     }
+
+    return snapshot;
 }
 
-void ts_update_buffer(Buffer *buffer, TSInputEdit edit)
+void flat_share_release(FlatShare *shared)
 {
-    if (auto lang = app.languages[buffer->language]; lang) {
-        if (buffer->syntax_tree) ts_tree_edit(buffer->syntax_tree, &edit);
-        for (auto st : buffer->subtrees) ts_tree_edit(st.tree, &edit);
+    if (__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_SEQ_CST) == 0) {
+        FREE(mem_dynamic, shared->data);
+        FREE(mem_dynamic, shared);
     }
+}
 
-    ts_parse_buffer(buffer, edit);
+void destroy_syntax_snapshot(SyntaxSnapshot *snapshot)
+{
+    if (snapshot->shared) flat_share_release(snapshot->shared);
+    FREE(mem_dynamic, snapshot->pieces.data);
+    FREE(mem_dynamic, snapshot->starts.data);
+    FREE(mem_dynamic, snapshot);
 }
 
+TSInput ts_snapshot_input(SyntaxSnapshot *snapshot)
+{
+    return {
+        .payload = snapshot,
+        .read = [](void *payload, u32 byte_index, TSPoint /*position*/, u32 *bytes_read) -> const char*
+        {
+            auto snapshot = (SyntaxSnapshot*)payload;
+            *bytes_read = 0;
+            if (byte_index >= snapshot->size) return nullptr;
+
+            // NOTE(jesper): tree-sitter reads mostly sequentially, so check the last and next piece
+            // before falling back to a binary search
+            i32 i = snapshot->last;
+            if (byte_index < snapshot->starts[i] ||
+                byte_index >= snapshot->starts[i] + snapshot->pieces[i].length)
+            {
+                i32 lo = 0, hi = snapshot->pieces.count-1;
+                while (lo < hi) {
+                    i32 mid = lo + (hi-lo+1)/2;
+                    if (snapshot->starts[mid] <= byte_index) lo = mid;
+                    else hi = mid-1;
+                }
+
+                i = snapshot->last = lo;
+            }
 
-void ts_get_syntax_colors(
-    DynamicArray<RangeColor> *colors,
-    i64 byte_start,
-    i64 byte_end,
-    TSTree *syntax_tree,
-    Language language)
+            i64 offset = byte_index - snapshot->starts[i];
+            *bytes_read = (u32)MIN(snapshot->pieces[i].length - offset, i32_MAX);
+            return snapshot->pieces[i].data + offset;
+        },
+        .encoding = TSInputEncodingUTF8,
+    };
+}
+
+// NOTE(jesper): maps a byte offset from before the edit to after it. Offsets inside of the replaced bytes
+// are moved to the end of the new bytes
+u32 ts_edit_offset(u32 offset, TSInputEdit *edit)
 {
-    auto query = app.highlights[language];
-    if (!query || !syntax_tree) return;
+    if (offset >= edit->old_end_byte) return offset + edit->new_end_byte - edit->old_end_byte;
+    if (offset > edit->start_byte) return edit->new_end_byte;
+    return offset;
+}
 
-    i32 insert_at = 0;
-    i32 parent_index = 0;
+void ts_edit_range(TSRange *range, TSInputEdit *edit)
+{
+    range->start_byte = ts_edit_offset(range->start_byte, edit);
+    range->end_byte = ts_edit_offset(range->end_byte, edit);
+}
 
-    TSNode root = ts_tree_root_node(syntax_tree);
+// NOTE(jesper): edits the tree's nodes by the shift accumulated in ts_edit_subtrees, as a single edit in front of
+// its range that inserts or removes that many bytes
+void ts_subtree_apply_shift(SyntaxTree *st)
+{
+    if (st->shift == 0) return;
 
-    TSQueryCursor *cursor = ts_query_cursor_new();
-    defer { ts_query_cursor_delete(cursor); };
+    u32 start = (u32)(st->range.start_byte - st->shift);
+    TSInputEdit edit{
+        .start_byte = MIN(start, st->range.start_byte),
+        .old_end_byte = start,
+        .new_end_byte = st->range.start_byte,
+    };
 
-    ts_query_cursor_set_byte_range(cursor, (u32)byte_start, (u32)byte_end);
-    ts_query_cursor_exec(cursor, query, root);
+    ts_tree_edit(st->tree, &edit);
+    st->shift = 0;
+}
 
-    TSQueryMatch match;
-    u32 capture_index;
+// NOTE(jesper): edits the injected trees along with their ranges. Trees whose range ends before the edit are
+// unaffected by it, and the ones that start after it are only moved, which is recorded in their shift instead of
+// walking their nodes. Only the trees the edit falls into are edited
+void ts_edit_subtrees(DynamicArray<SyntaxTree> *subtrees, TSInputEdit *edit)
+{
+    i64 delta = (i64)edit->new_end_byte - edit->old_end_byte;
 
-    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) {
-        auto *capture = &match.captures[capture_index];
-        u32 start_byte = ts_node_start_byte(capture->node);
-        u32 end_byte = ts_node_end_byte(capture->node);
+    for (SyntaxTree &st : *subtrees) {
+        if (st.range.end_byte < edit->start_byte) continue;
 
-        i32 old_parent_index = parent_index;
-        while (parent_index < colors->count &&
-               (start_byte < colors->at(parent_index).start || end_byte > colors->at(parent_index).end))
-        {
-            parent_index++;
+        if (st.range.start_byte > edit->old_end_byte) {
+            st.range.start_byte = (u32)(st.range.start_byte + delta);
+            st.range.end_byte = (u32)(st.range.end_byte + delta);
+            st.shift += delta;
+            continue;
         }
 
-        if (old_parent_index != parent_index) {
-            insert_at = MIN(colors->count, parent_index+1);
-        }
+        ts_subtree_apply_shift(&st);
+        ts_tree_edit(st.tree, edit);
+        ts_edit_range(&st.range, edit);
+    }
+}
 
+// NOTE(jesper): returns a single edit covering the bytes touched by a followed by b, used to decide which
+// injected ranges to reparse when the worker coalesces several edits into one parse
+TSInputEdit ts_edit_union(TSInputEdit a, TSInputEdit b)
+{
+    i64 delta = (i64)a.new_end_byte - a.old_end_byte + (i64)b.new_end_byte - b.old_end_byte;
+
+    TSInputEdit result{};
+    result.start_byte = MIN(a.start_byte, b.start_byte);
+    result.new_end_byte = MAX(ts_edit_offset(a.new_end_byte, &b), b.new_end_byte);
+    result.old_end_byte = (u32)MAX((i64)result.new_end_byte - delta, (i64)result.start_byte);
+    return result;
+}
+
+// NOTE(jesper): per-buffer background parser. The main thread posts the latest snapshot along with the
+// edits made since the previous post, replacing any snapshot the worker hasn't picked up yet. The worker
+// parses with its own trees and publishes a copy of the host tree and of the injected trees it reparsed, along
+// with the ids of the injected trees those replaced, which the main thread adopts in ts_poll_buffer
+struct SyntaxWorker {
+    Language language;
+    TsHeap *heap;
+
+    std::mutex m;
+    std::condition_variable cv;
+
+    // NOTE(jesper): written by the main thread
+    SyntaxSnapshot *snapshot;
+    DynamicArray<TSInputEdit> edits;
+    u64 snapshot_version;
+    bool reset;
+    bool quit;
+    bool exited;
+    size_t cancel;
+
+    // NOTE(jesper): written by the worker thread. subtrees, removed_subtrees, and changed accumulate the
+    // reparsed trees, the ids of the trees they replaced or that were removed, and the byte ranges whose syntax
+    // changed, in the parses published since the main thread last adopted one. subtrees_reset is set if any of
+    // those parses started over, in which case every tree the main thread has is gone
+    TSTree *tree;
+    DynamicArray<SyntaxTree> subtrees;
+    DynamicArray<u32> removed_subtrees;
+    bool subtrees_reset;
+    DynamicArray<TSRange> changed;
+    u64 tree_version;
+    bool degraded;
+};
+
+void ts_delete_subtrees(DynamicArray<SyntaxTree> *subtrees)
+{
+    for (auto st : *subtrees) if (st.tree) ts_tree_delete(st.tree);
+    subtrees->count = 0;
+}
+
+void ts_delete_trees(TSTree **tree, DynamicArray<SyntaxTree> *subtrees)
+{
+    if (*tree) ts_tree_delete(*tree);
+    *tree = nullptr;
+
+    ts_delete_subtrees(subtrees);
+}
+
+i32 ts_subtree_find(DynamicArray<SyntaxTree> *subtrees, u32 id)
+{
+    for (i32 i = 0; i < subtrees->count; i++) {
+        if (subtrees->at(i).id == id) return i;
+    }
+    return -1;
+}
+
+// NOTE(jesper): ranges that only touch don't intersect, matching the byte range filter of the injection query.
+// Otherwise an injection next to an edit would be marked stale without the query returning it again
+bool ts_range_intersects(DynamicArray<TSRange> *ranges, TSRange range)
+{
+    for (TSRange r : *ranges) {
+        if (r.start_byte < range.end_byte && r.end_byte > range.start_byte) return true;
+    }
+    return false;
+}
+
+// NOTE(jesper): parses the snapshot with the host language, and then reparses only the injected trees whose
+// range intersects the bytes changed by the edit or by the host parse. Each injected range has its own tree,
+// so that the included ranges of a reparse are limited to the affected ranges. The changed byte ranges are
+// appended to changed. Reparsed trees are given ids from next_id, and the ids of the trees they replaced, or
+// that were removed, are appended to removed. Returns false if the host parse was cancelled or ran out of its
+// time budget
+bool ts_parse_snapshot(
+    TSParser *parser,
+    TSQueryCursor *cursor,
+    Language language,
+    SyntaxSnapshot *snapshot,
+    TSTree **tree,
+    DynamicArray<SyntaxTree> *subtrees,
+    TSInputEdit *edit,
+    DynamicArray<TSRange> *changed,
+    u32 *next_id,
+    DynamicArray<u32> *removed)
+{
+    SArena scratch = tl_scratch_arena();
+
+    ts_parser_set_language(parser, app.languages[language]);
+    ts_parser_set_included_ranges(parser, nullptr, 0);
+
+    TSTree *old_tree = *tree;
+    TSTree *new_tree = ts_parser_parse(parser, old_tree, ts_snapshot_input(snapshot));
+    if (!new_tree) {
+        ts_parser_reset(parser);
+        return false;
+    }
+
+    DynamicArray<TSRange> dirty{ .alloc = scratch };
+    if (old_tree && edit) {
+        u32 count;
+        TSRange *ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &count);
+        for (u32 i = 0; i < count; i++) array_add(&dirty, ranges[i]);
+        ts_heap_free(ranges);
+
+        array_add(&dirty, TSRange{ .start_byte = edit->start_byte, .end_byte = edit->new_end_byte });
+    } else {
+        array_add(&dirty, TSRange{ .start_byte = 0, .end_byte = (u32)snapshot->size });
+    }
+
+    if (old_tree) ts_tree_delete(old_tree);
+    *tree = new_tree;
+
+    for (TSRange r : dirty) array_add(changed, r);
+
+    auto inj = app.injections[language];
+    if (!inj) return true;
+
+    DynamicArray<SyntaxTree> stale{ .alloc = scratch };
+
+    i32 keep = 0;
+    for (SyntaxTree st : *subtrees) {
+        if (ts_range_intersects(&dirty, st.range)) array_add(&stale, st);
+        else subtrees->at(keep++) = st;
+    }
+    subtrees->count = keep;
+
+    DynamicArray<SyntaxTree> injections{ .alloc = scratch };
+    for (TSRange r : dirty) ts_get_injection_ranges(&injections, subtrees, new_tree, inj, cursor, r.start_byte, r.end_byte);
+
+    if (DEBUG_TREE_SITTER_INJECTIONS && injections.count) {
+        LOG_INFO("updating %d (%d) injected ranges", injections.count, injections.count + subtrees->count);
+    }
+
+    for (SyntaxTree &st : injections) {
+        // NOTE(jesper): reparse from the stale tree of the same injection, if there is one, so that
+        // editing inside of a large injected range is incremental as well
+        TSTree *old = nullptr;
+        for (SyntaxTree &it : stale) {
+            if (it.tree && it.language == st.language &&
+                it.range.start_byte <= st.range.end_byte &&
+                it.range.end_byte >= st.range.start_byte)
+            {
+                ts_subtree_apply_shift(&it);
+                old = it.tree;
+                it.tree = nullptr;
+                array_add(removed, it.id);
+                break;
+            }
+        }
+
+        ts_parser_set_language(parser, app.languages[st.language]);
+        ts_parser_set_included_ranges(parser, &st.range, 1);
+        st.tree = ts_parser_parse(parser, old, ts_snapshot_input(snapshot));
+        st.id = (*next_id)++;
+
+        if (old) ts_tree_delete(old);
+        array_add(changed, st.range);
+
+        if (st.tree) array_insert(subtrees, ts_subtree_lower_bound(subtrees, st.range.start_byte), st);
+    }
+
+    // NOTE(jesper): a stale tree the query didn't return again is put back as it was edited, rather than losing
+    // its highlighting until a later edit falls inside of it. Its range collapsing means the edit removed the
+    // injected content
+    for (SyntaxTree st : stale) {
+        if (!st.tree) continue;
+
+        if (st.range.start_byte < st.range.end_byte) {
+            array_insert(subtrees, ts_subtree_lower_bound(subtrees, st.range.start_byte), st);
+        } else {
+            array_add(changed, st.range);
+            array_add(removed, st.id);
+            ts_tree_delete(st.tree);
+        }
+    }
+
+    return true;
+}
+
+int syntax_worker_thread(void *data)
+{
+    SyntaxWorker *worker = (SyntaxWorker*)data;
+    tl_ts_heap = worker->heap;
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_timeout_micros(parser, SYNTAX_PARSE_BUDGET_MICROS);
+    ts_parser_set_cancellation_flag(parser, &worker->cancel);
+
+    TSQueryCursor *cursor = ts_query_cursor_new();
+
+    TSTree *tree = nullptr;
+    DynamicArray<SyntaxTree> subtrees{};
+    DynamicArray<TSInputEdit> edits{};
+    DynamicArray<TSRange> changed{};
+    DynamicArray<u32> removed{};
+    u32 next_id = 0;
+
+    while (true) {
+        SyntaxSnapshot *snapshot;
+        u64 version;
+        bool reset;
+
+        {
+            std::unique_lock lk(worker->m);
+            worker->cv.wait(lk, [worker] { return worker->snapshot != nullptr || worker->quit; });
+
+            if (worker->quit) {
+                // NOTE(jesper): the parser, cursor, and trees all live in the worker's heap, which is
+                // released as a whole by destroy_syntax_worker
+                FREE(mem_dynamic, subtrees.data);
+                FREE(mem_dynamic, edits.data);
+                FREE(mem_dynamic, changed.data);
+                FREE(mem_dynamic, removed.data);
+
+                worker->exited = true;
+                worker->cv.notify_all();
+                return 0;
+            }
+
+            snapshot = worker->snapshot;
+            version = worker->snapshot_version;
+            reset = worker->reset;
+
+            worker->snapshot = nullptr;
+            worker->reset = false;
+            SWAP(edits, worker->edits);
+        }
+
+        if (worker->degraded) {
+            destroy_syntax_snapshot(snapshot);
+            edits.count = 0;
+            continue;
+        }
+
+        if (reset) ts_delete_trees(&tree, &subtrees);
+
+        TSInputEdit edit{};
+        for (i32 i = 0; i < edits.count; i++) {
+            if (tree) ts_tree_edit(tree, &edits[i]);
+            ts_edit_subtrees(&subtrees, &edits[i]);
+            edit = i == 0 ? edits[i] : ts_edit_union(edit, edits[i]);
+        }
+
+        changed.count = 0;
+        removed.count = 0;
+        u32 first_id = next_id;
+
+        bool parsed = ts_parse_snapshot(
+            parser, cursor, worker->language, snapshot,
+            &tree, &subtrees, edits.count ? &edit : nullptr,
+            &changed, &next_id, &removed);
+        destroy_syntax_snapshot(snapshot);
+
+        if (!parsed) {
+            // NOTE(jesper): the trees are left unedited by the failed parse, so they're of no further use
+            ts_delete_trees(&tree, &subtrees);
+            edits.count = 0;
+
+            std::lock_guard lk(worker->m);
+            worker->degraded = !worker->quit;
+            continue;
+        }
+
+        // NOTE(jesper): the published trees are copies, so that the main thread can edit and delete them
+        // independently of the trees we keep parsing incrementally from. The injected trees that weren't
+        // reparsed are the same as the copies the main thread already has, so only the reparsed ones are copied
+        std::lock_guard lk(worker->m);
+        if (worker->tree) ts_tree_delete(worker->tree);
+        worker->tree = tree ? ts_tree_copy(tree) : nullptr;
+        worker->tree_version = version;
+
+        // NOTE(jesper): what was published earlier but not yet adopted is brought up to date with this parse
+        for (TSInputEdit &e : edits) ts_edit_subtrees(&worker->subtrees, &e);
+        for (TSRange &r : worker->changed) {
+            for (TSInputEdit &e : edits) ts_edit_range(&r, &e);
+        }
+        for (TSRange r : changed) array_add(&worker->changed, r);
+
+        if (reset) {
+            ts_delete_subtrees(&worker->subtrees);
+            worker->removed_subtrees.count = 0;
+            worker->subtrees_reset = true;
+        }
+
+        for (u32 id : removed) {
+            if (i32 i = ts_subtree_find(&worker->subtrees, id); i != -1) {
+                ts_tree_delete(worker->subtrees[i].tree);
+                array_remove(&worker->subtrees, i);
+            } else {
+                array_add(&worker->removed_subtrees, id);
+            }
+        }
+
+        for (SyntaxTree st : subtrees) {
+            if (st.id < first_id) continue;
+
+            st.tree = ts_tree_copy(st.tree);
+            array_insert(&worker->subtrees, ts_subtree_lower_bound(&worker->subtrees, st.range.start_byte), st);
+        }
+
+        edits.count = 0;
+    }
+}
+
+void destroy_syntax_worker(Buffer *buffer);
+
+void ts_request_parse(Buffer *buffer, TSInputEdit *edit, bool reset = false)
+{
+    if (!app.languages[buffer->language]) return;
+    if (buffer->syntax_degraded) return;
+
+    if (buffer_end(buffer) > app.syntax_size_limit[buffer->language]) {
+        LOG_INFO("buffer '%.*s' exceeds the syntax size limit, falling back to lexer highlighting", STRFMT(buffer->name));
+        destroy_syntax_worker(buffer);
+        buffer->syntax_degraded = true;
+        return;
+    }
+
+    SyntaxWorker *worker = buffer->syntax_worker;
+    if (!worker) {
+        worker = buffer->syntax_worker = ALLOC_T(mem_dynamic, SyntaxWorker) {};
+        worker->language = buffer->language;
+        worker->heap = create_ts_heap(buffer->language);
+        create_thread(syntax_worker_thread, worker);
+    }
+
+    SyntaxSnapshot *snapshot = create_syntax_snapshot(buffer);
+    {
+        std::lock_guard lk(worker->m);
+        if (worker->snapshot) destroy_syntax_snapshot(worker->snapshot);
+
+        worker->snapshot = snapshot;
+        worker->snapshot_version = buffer->version;
+        worker->reset |= reset;
+        if (edit) array_add(&worker->edits, *edit);
+    }
+    worker->cv.notify_one();
+}
+
+void ts_parse_buffer(Buffer *buffer) INTERNAL
+{
+    buffer->version++;
+    ts_request_parse(buffer, nullptr, true);
+}
+
+void ts_update_buffer(Buffer *buffer, TSInputEdit edit)
+{
+    buffer->version++;
+    if (!app.languages[buffer->language] || buffer->syntax_degraded) return;
+
+    TsHeap *current_heap = tl_ts_heap;
+    if (buffer->syntax_worker) tl_ts_heap = buffer->syntax_worker->heap;
+    defer { tl_ts_heap = current_heap; };
+
+    // NOTE(jesper): keep the displayed trees in sync with the buffer until the worker publishes a new
+    // parse, and remember the edit so it can be re-applied to that parse if it predates this edit
+    if (buffer->syntax_tree) ts_tree_edit(buffer->syntax_tree, &edit);
+    ts_edit_subtrees(&buffer->subtrees, &edit);
+    array_add(&buffer->syntax_edits, { buffer->version, edit });
+
+    ts_request_parse(buffer, &edit);
+}
+
+void highlight_invalidate_lines(Buffer *buffer, i32 first, i32 last)
+{
+    first = MAX(first, 0);
+    last = MIN(last, buffer->highlights.count-1);
+
+    for (i32 i = first; i <= last; i++) {
+        HighlightLine *line = &buffer->highlights[i];
+        FREE(mem_dynamic, line->spans);
+        *line = {};
+    }
+}
+
+void highlight_invalidate_range(Buffer *buffer, i64 start, i64 end)
+{
+    i32 first = line_from_offset(&buffer->line_index, start);
+    i32 last = line_from_offset(&buffer->line_index, MAX(start, end-1));
+    highlight_invalidate_lines(buffer, first, last);
+}
+
+// NOTE(jesper): lines [line, line+old_count] of the buffer were replaced by lines [line, line+new_count].
+// The cache entries of the lines following the edit are moved along with them
+void highlight_replace_lines(Buffer *buffer, i32 line, i32 old_count, i32 new_count)
+{
+    if (line >= buffer->highlights.count) return;
+
+    SArena scratch = tl_scratch_arena();
+
+    i32 end = MIN(line+old_count+1, buffer->highlights.count);
+    highlight_invalidate_lines(buffer, line, end-1);
+
+    DynamicArray<HighlightLine> new_lines{ .alloc = scratch };
+    for (i32 i = 0; i <= new_count; i++) array_add(&new_lines, {});
+    array_replace(&buffer->highlights, line, end, new_lines);
+}
+
+// NOTE(jesper): adopts the most recently published parse, if any, and brings it up to date with the
+// edits made since its snapshot was taken
+void ts_poll_buffer(Buffer *buffer)
+{
+    SyntaxWorker *worker = buffer->syntax_worker;
+    if (!worker) return;
+
+    bool degraded;
+    {
+        std::lock_guard lk(worker->m);
+        degraded = worker->degraded;
+    }
+
+    if (degraded) {
+        LOG_INFO("buffer '%.*s' exceeded the parse budget, falling back to lexer highlighting", STRFMT(buffer->name));
+        destroy_syntax_worker(buffer);
+        buffer->syntax_degraded = true;
+        return;
+    }
+
+    TSTree *tree;
+    DynamicArray<SyntaxTree> subtrees{};
+    DynamicArray<u32> removed{};
+    DynamicArray<TSRange> changed{};
+    bool reset;
+    {
+        std::lock_guard lk(worker->m);
+        if (!worker->tree || worker->tree_version <= buffer->syntax_version) return;
+
+        tree = worker->tree;
+        buffer->syntax_version = worker->tree_version;
+        SWAP(subtrees, worker->subtrees);
+        SWAP(removed, worker->removed_subtrees);
+        SWAP(changed, worker->changed);
+        reset = worker->subtrees_reset;
+
+        worker->tree = nullptr;
+        worker->subtrees_reset = false;
+    }
+
+    TsHeap *current_heap = tl_ts_heap;
+    tl_ts_heap = worker->heap;
+    defer { tl_ts_heap = current_heap; };
+
+    i32 pending = 0;
+    for (SyntaxEdit e : buffer->syntax_edits) {
+        if (e.version <= buffer->syntax_version) continue;
+
+        ts_tree_edit(tree, &e.edit);
+        ts_edit_subtrees(&subtrees, &e.edit);
+        for (TSRange &r : changed) ts_edit_range(&r, &e.edit);
+        buffer->syntax_edits[pending++] = e;
+    }
+    buffer->syntax_edits.count = pending;
+
+    for (TSRange r : changed) highlight_invalidate_range(buffer, r.start_byte, r.end_byte);
+
+    if (buffer->syntax_tree) ts_tree_delete(buffer->syntax_tree);
+    buffer->syntax_tree = tree;
+
+    if (reset) ts_delete_subtrees(&buffer->subtrees);
+    for (u32 id : removed) {
+        if (i32 i = ts_subtree_find(&buffer->subtrees, id); i != -1) {
+            ts_tree_delete(buffer->subtrees[i].tree);
+            array_remove(&buffer->subtrees, i);
+        }
+    }
+
+    for (SyntaxTree st : subtrees) {
+        array_insert(&buffer->subtrees, ts_subtree_lower_bound(&buffer->subtrees, st.range.start_byte), st);
+    }
+
+    FREE(mem_dynamic, subtrees.data);
+    FREE(mem_dynamic, removed.data);
+    FREE(mem_dynamic, changed.data);
+}
+
+// NOTE(jesper): stops the buffer's parse worker and releases all of the buffer's syntax trees by destroying
+// the heap they were allocated from, instead of deleting each tree
+void destroy_syntax_worker(Buffer *buffer)
+{
+    SyntaxWorker *worker = buffer->syntax_worker;
+    if (!worker) return;
+
+    {
+        std::unique_lock lk(worker->m);
+        worker->quit = true;
+        __atomic_store_n(&worker->cancel, 1, __ATOMIC_SEQ_CST);
+        worker->cv.notify_all();
+        worker->cv.wait(lk, [worker] { return worker->exited; });
+    }
+
+    if (worker->snapshot) destroy_syntax_snapshot(worker->snapshot);
+    FREE(mem_dynamic, worker->edits.data);
+    FREE(mem_dynamic, worker->subtrees.data);
+    FREE(mem_dynamic, worker->removed_subtrees.data);
+    FREE(mem_dynamic, worker->changed.data);
+
+    destroy_ts_heap(worker->heap);
+    FREE(mem_dynamic, worker);
+
+    buffer->syntax_worker = nullptr;
+    buffer->syntax_tree = nullptr;
+    buffer->subtrees.count = 0;
+    buffer->syntax_edits.count = 0;
+    buffer->syntax_version = buffer->version;
+    highlight_invalidate_lines(buffer, 0, buffer->highlights.count-1);
+}
+
+i64 ts_bytes_in_use(Language language)
+{
+    i64 bytes = 0;
+    for (Buffer &buffer : buffers) {
+        if (buffer.syntax_worker && buffer.language == language) bytes += ts_heap_in_use(buffer.syntax_worker->heap);
+    }
+    return bytes;
+}
+
+
+// NOTE(jesper): resolves the color of every capture of the highlight queries, falling back to the parent
+// capture by stripping .suffix segments until a color is found. The cached highlight spans of buffers hold
+// resolved colors, so they're invalidated as well
+void ts_build_capture_colors()
+{
+    for (i32 i = 0; i < LANGUAGE_COUNT; i++) {
+        TSQuery *query = app.highlights[i];
+        if (!query) continue;
+
+        u32 count = ts_query_capture_count(query);
+        array_resize(&app.capture_colors[i], count);
+
+        for (u32 id = 0; id < count; id++) {
+            u32 length;
+            const char *name = ts_query_capture_name_for_id(query, id, &length);
+
+            String str{ (char*)name, (i32)length };
+            u32 *color = nullptr;
+            do {
+                color = map_find(&app.syntax_colors, str);
+                i32 p = last_of(str, '.');
+                if (p > 0) str = slice(str, 0, p);
+                else str.length = 0;
+            } while(color == nullptr && str.length > 0);
+
+            app.capture_colors[i][id] = color ? *color : SYNTAX_COLOR_NONE;
+        }
+    }
+
+    for (Buffer &buffer : buffers) highlight_invalidate_lines(&buffer, 0, buffer.highlights.count-1);
+}
+
+// NOTE(jesper): the views are highlighted on the job pool, so each thread gets its own cursor
+thread_local TSQueryCursor *tl_highlight_cursor;
+
+void ts_get_syntax_colors(
+    DynamicArray<RangeColor> *colors,
+    i64 byte_start,
+    i64 byte_end,
+    TSTree *syntax_tree,
+    Language language,
+    i64 shift = 0)
+{
+    auto query = app.highlights[language];
+    if (!query || !syntax_tree) return;
+
+    DynamicArray<u32> *capture_colors = &app.capture_colors[language];
+
+    i32 insert_at = 0;
+    i32 parent_index = 0;
+
+    TSNode root = ts_tree_root_node(syntax_tree);
+
+    if (!tl_highlight_cursor) tl_highlight_cursor = ts_query_cursor_new();
+    TSQueryCursor *cursor = tl_highlight_cursor;
+
+    // NOTE(jesper): the nodes of a shifted tree are queried at their own offsets, and moved to the buffer's
+    ts_query_cursor_set_byte_range(cursor, (u32)MAX(byte_start - shift, 0), (u32)MAX(byte_end - shift, 0));
+    ts_query_cursor_exec(cursor, query, root);
+
+    TSQueryMatch match;
+    u32 capture_index;
+
+    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) {
+        auto *capture = &match.captures[capture_index];
+        u32 start_byte = (u32)(ts_node_start_byte(capture->node) + shift);
+        u32 end_byte = (u32)(ts_node_end_byte(capture->node) + shift);
+
+        i32 old_parent_index = parent_index;
+        while (parent_index < colors->count &&
+               (start_byte < colors->at(parent_index).start || end_byte > colors->at(parent_index).end))
+        {
+            parent_index++;
+        }
+
+        if (old_parent_index != parent_index) {
+            insert_at = MIN(colors->count, parent_index+1);
+        }
+
+#if DEBUG_TREE_SITTER_COLORS
         u32 capture_name_length;
         const char *tmp = ts_query_capture_name_for_id(query, capture->index, &capture_name_length);
         String capture_name{ (char*)tmp, (i32)capture_name_length };
 
-#if DEBUG_TREE_SITTER_COLORS
         {
             const char *node_type = ts_node_type(capture->node);
             LOG_INFO("query match id: %d, pattern_index: %d, capture_index: %d", match.id, match.pattern_index, capture_index);
@@ -716,20 +1794,13 @@ void ts_get_syntax_colors(
             LOG_INFO("capture name: %.*s", STRFMT(capture_name));
         }
 #endif
-        String str = capture_name;
-        u32 *color = nullptr;
-        do {
-            color = map_find(&app.syntax_colors, str);
-            i32 p = last_of(str, '.');
-            if (p > 0) str = slice(str, 0, p);
-            else str.length = 0;
-        } while(color == nullptr && str.length > 0);
+        u32 color = capture->index < (u32)capture_colors->count ? capture_colors->at(capture->index) : SYNTAX_COLOR_NONE;
 
-        if (color) {
+        if (color != SYNTAX_COLOR_NONE) {
 #if DEBUG_TREE_SITTER_COLORS
             LOG_INFO("highlight color[%d] '%.*s' in [%d, %d]", insert_at, STRFMT(capture_name), start_byte, end_byte);
 #endif
-            array_insert(colors, insert_at++, { start_byte, end_byte, *color });
+            array_insert(colors, insert_at++, { start_byte, end_byte, color });
 
             if (parent_index < colors->count && parent_index != insert_at-1) {
                 if (colors->at(parent_index).end> start_byte) {
@@ -747,6 +1818,91 @@ void ts_get_syntax_colors(
     }
 }
 
+// NOTE(jesper): appends the highlight spans of the lines covering [byte_start, byte_end[ to colors. Lines
+// are only queried if they've been invalidated by an edit or reparse since they were last resolved, so
+// idle frames and scrolling over already highlighted lines don't touch the syntax trees at all
+void buffer_highlight_lines(DynamicArray<RangeColor> *colors, Buffer *buffer, i64 byte_start, i64 byte_end)
+{
+    if (!buffer->syntax_tree || !app.highlights[buffer->language]) return;
+
+    SArena scratch = tl_scratch_arena(colors->alloc);
+
+    LineIndex *li = &buffer->line_index;
+    if (buffer->highlights.count != line_index_line_count(li)) {
+        highlight_invalidate_lines(buffer, 0, buffer->highlights.count-1);
+        array_resize(&buffer->highlights, line_index_line_count(li));
+        memset(buffer->highlights.data, 0, buffer->highlights.count * sizeof buffer->highlights[0]);
+    }
+
+    i64 first_start;
+    i32 first = line_from_offset(li, byte_start, &first_start);
+    i32 last = line_from_offset(li, MAX(byte_start, byte_end-1));
+
+    DynamicArray<RangeColor> spans{ .alloc = scratch };
+
+    i64 run_start = first_start;
+    for (i32 line = first; line <= last;) {
+        if (buffer->highlights[line].valid) {
+            run_start += line_length(li, line++);
+            continue;
+        }
+
+        i32 run_last = line;
+        i64 run_end = run_start + line_length(li, line);
+        while (run_last < last && !buffer->highlights[run_last+1].valid) {
+            run_end += line_length(li, ++run_last);
+        }
+
+        spans.count = 0;
+        ts_get_syntax_colors(&spans, run_start, run_end, buffer->syntax_tree, buffer->language);
+        for (auto st : buffer->subtrees) {
+            if (st.range.start_byte >= run_end) break;
+            if (st.range.end_byte <= run_start) continue;
+
+#if DEBUG_TREE_SITTER_COLORS
+            String l = string_from_enum(st.language);
+            LOG_INFO("highlight colors for language '%.*s'", STRFMT(l));
+#endif
+            ts_get_syntax_colors(&spans, run_start, run_end, st.tree, st.language, st.shift);
+        }
+
+        i32 s = 0;
+        for (i64 ls = run_start; line <= run_last; line++) {
+            i64 le = ls + line_length(li, line);
+            while (s < spans.count && spans[s].end <= ls) s++;
+
+            i32 count = 0;
+            for (i32 i = s; i < spans.count && spans[i].start < le; i++) count += spans[i].end > ls;
+
+            HighlightLine *hl = &buffer->highlights[line];
+            hl->spans = count > 0 ? ALLOC_ARR(mem_dynamic, RangeColor, count) : nullptr;
+            hl->valid = true;
+
+            for (i32 i = s; i < spans.count && spans[i].start < le; i++) {
+                if (spans[i].end <= ls) continue;
+                hl->spans[hl->count++] = {
+                    MAX(spans[i].start, ls) - ls,
+                    MIN(spans[i].end, le) - ls,
+                    spans[i].color
+                };
+            }
+
+            ls = le;
+        }
+
+        run_start = run_end;
+    }
+
+    i64 ls = first_start;
+    for (i32 line = first; line <= last; line++) {
+        HighlightLine *hl = &buffer->highlights[line];
+        for (i32 i = 0; i < hl->count; i++) {
+            array_add(colors, { ls + hl->spans[i].start, ls + hl->spans[i].end, hl->spans[i].color });
+        }
+        ls += line_length(li, line);
+    }
+}
+
 void buffer_history(BufferId buffer_id, BufferHistory entry)
 {
     Buffer *buffer = get_buffer(buffer_id);
@@ -806,8 +1962,20 @@ void buffer_history(BufferId buffer_id, BufferHistory entry)
                 if (prev_insert != -1) {
                     auto *prev = &buffer->history[prev_insert];
                     if (it->offset+it->text.length == prev->offset) {
-                        it->text.data = REALLOC_ARR(mem_dynamic, char, it->text.data, it->text.length, it->text.length+prev->text.length);
-                        memcpy(it->text.data+it->text.length, prev->text.data, prev->text.length);
+                        if (it->text_ref && prev->text_ref && it->text.data+it->text.length == prev->text.data) {
+                            // NOTE(jesper): both entries reference consecutive bytes in the piece table's
+                            // add blocks, so we can merge them without copying anything
+                        } else if (it->text_ref) {
+                            char *data = ALLOC_ARR(mem_dynamic, char, it->text.length+prev->text.length);
+                            memcpy(data, it->text.data, it->text.length);
+                            memcpy(data+it->text.length, prev->text.data, prev->text.length);
+                            it->text.data = data;
+                            it->text_ref = false;
+                        } else {
+                            it->text.data = REALLOC_ARR(mem_dynamic, char, it->text.data, it->text.length, it->text.length+prev->text.length);
+                            memcpy(it->text.data+it->text.length, prev->text.data, prev->text.length);
+                        }
+
                         it->text.length += prev->text.length;
                         array_remove(&buffer->history, prev_insert);
                     }
@@ -830,7 +1998,7 @@ void buffer_history(BufferId buffer_id, BufferHistory entry)
     switch (entry.type) {
     case BUFFER_REMOVE:
     case BUFFER_INSERT:
-        entry.text = duplicate_string(entry.text, mem_dynamic);
+        if (!entry.text_ref) entry.text = duplicate_string(entry.text, mem_dynamic);
         break;
     case BUFFER_GROUP_START:
     case BUFFER_GROUP_END:
@@ -843,71 +2011,459 @@ void buffer_history(BufferId buffer_id, BufferHistory entry)
     buffer->history_index = buffer->history.count-1;
 }
 
+enum CharClass : u8 {
+    CHAR_WORD          = 1 << 0,
+    CHAR_SPACE         = 1 << 1,
+    CHAR_WORD_BOUNDARY = 1 << 2,
+};
+
+struct CharClassTable {
+    u8 classes[256];
+    constexpr u8 operator[](u8 c) const { return classes[c]; }
+};
+
+// NOTE(jesper): classes of the ASCII characters. Bytes >= 0x80 are part of multi-byte code points, which
+// are never word boundaries, but are left unclassified so that the run scanners fall back to decoding them
+constexpr CharClassTable make_char_class_table()
+{
+    CharClassTable table{};
+    for (i32 c = 'a'; c <= 'z'; c++) table.classes[c] |= CHAR_WORD;
+    for (i32 c = 'A'; c <= 'Z'; c++) table.classes[c] |= CHAR_WORD;
+    for (i32 c = '0'; c <= '9'; c++) table.classes[c] |= CHAR_WORD;
+    table.classes['_'] |= CHAR_WORD;
+
+    table.classes[' '] |= CHAR_SPACE;
+
+    for (const char *c = " \t\n\r*!@$&#^+-=.,;:?<>%[]{}()'\"`/\\|"; *c; c++) {
+        table.classes[(u8)*c] |= CHAR_WORD_BOUNDARY;
+    }
+    return table;
+}
+
+constexpr CharClassTable char_class_table = make_char_class_table();
+
 bool is_word_boundary(i32 c)
 {
-    switch(c) {
-    case ' ':
-    case '\t':
-    case '\n':
-    case '\r':
-    case '*':
-    case '!':
-    case '@':
-    case '$':
-    case '&':
-    case '#':
-    case '^':
-    case '+':
-    case '-':
-    case '=':
-    case '.':
-    case ',':
-    case ';':
-    case ':':
-    case '?':
-    case '<': case '>':
-    case '%':
-    case '[': case ']':
-    case '{': case '}':
-    case '(': case ')':
-    case '\'': case '\"': case '`':
-    case '/':
-    case '\\':
-    case '|':
-        return true;
-    default:
-        return false;
+    return c >= 0 && c < 128 && (char_class_table[c] & CHAR_WORD_BOUNDARY);
+}
+
+#if defined(__SSE2__)
+// NOTE(jesper): returns a mask with bit n set if byte n is of the given class, which must be either CHAR_WORD
+// or CHAR_SPACE. The compares are signed, so bytes >= 0x80 never match a range
+u32 char_class_mask(__m128i v, u8 char_class)
+{
+    if (char_class == CHAR_SPACE) return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(
+        _mm_cmpgt_epi8(lower, _mm_set1_epi8('a'-1)),
+        _mm_cmplt_epi8(lower, _mm_set1_epi8('z'+1)));
+    __m128i digit = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1)));
+    __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+
+    return _mm_movemask_epi8(_mm_or_si128(alpha, _mm_or_si128(digit, underscore)));
+}
+#endif
+
+// NOTE(jesper): returns the number of leading bytes of data that are all of char_class, 16 bytes at a time
+// where we can
+i32 char_class_run(const char *data, i32 length, u8 char_class)
+{
+    i32 i = 0;
+
+#if defined(__SSE2__)
+    for (; i+16 <= length; i += 16) {
+        u32 mask = char_class_mask(_mm_loadu_si128((const __m128i*)(data+i)), char_class);
+        if (mask != 0xFFFF) return i + __builtin_ctz(~mask);
+    }
+#endif
+
+    while (i < length && (char_class_table[data[i]] & char_class)) i++;
+    return i;
+}
+
+// NOTE(jesper): returns the number of trailing bytes of data that are all of char_class
+i32 char_class_run_back(const char *data, i32 length, u8 char_class)
+{
+    i32 i = length;
+
+#if defined(__SSE2__)
+    for (; i >= 16; i -= 16) {
+        u32 mask = char_class_mask(_mm_loadu_si128((const __m128i*)(data+i-16)), char_class);
+        if (mask != 0xFFFF) return length-i + __builtin_clz(~mask << 16);
+    }
+#endif
+
+    while (i > 0 && (char_class_table[data[i-1]] & char_class)) i--;
+    return length-i;
+}
+
+// NOTE(jesper): returns the end of the run of char_class bytes starting at offset, up to end
+i64 buffer_skip_class(Buffer *buffer, i64 offset, i64 end, u8 char_class)
+{
+    while (offset < end) {
+        String chunk = buffer_chunk_at(buffer, offset);
+        i32 length = (i32)MIN(chunk.length, end-offset);
+        if (length <= 0) break;
+
+        i32 count = char_class_run(chunk.data, length, char_class);
+        offset += count;
+        if (count < length) break;
     }
 
+    return offset;
 }
 
+// NOTE(jesper): returns the start of the run of char_class bytes ending at offset, down to start
+i64 buffer_skip_class_back(Buffer *buffer, i64 offset, i64 start, u8 char_class)
+{
+    while (offset > start) {
+        String chunk = buffer_chunk_before(buffer, offset);
+        i32 length = (i32)MIN(chunk.length, offset-start);
+        if (length <= 0) break;
+
+        i32 count = char_class_run_back(chunk.data + chunk.length - length, length, char_class);
+        offset -= count;
+        if (count < length) break;
+    }
+
+    return offset;
+}
 
 char char_at(Buffer *b, i64 i)
 {
     switch (b->type) {
-    case BUFFER_FLAT: return b->flat.data[i];
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return b->flat.data[i];
+    case BUFFER_PIECE: return piece_char_at(b->piece, i);
     }
 }
 
 i64 next_byte(Buffer *b, i64 i)
 {
     switch (b->type) {
-    case BUFFER_FLAT: return i+1;
+    case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED:
+        return i+1;
     }
 }
 
 i64 prev_byte(Buffer *b, i64 i)
 {
     switch (b->type) {
-    case BUFFER_FLAT: return i-1;
+    case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED:
+        return i-1;
+    }
+}
+
+bool buffer_matches(Buffer *buffer, i64 offset, i64 end, String str)
+{
+    if (str.length == 0 || offset + str.length > end) return false;
+    for (i32 i = 0; i < str.length; i++) {
+        if (char_at(buffer, offset+i) != str[i]) return false;
+    }
+    return true;
+}
+
+// NOTE(jesper): cheap highlighting of comments, strings, and numbers for buffers that have fallen back from
+// tree-sitter. Only the visible window is scanned, starting at its first byte, so a comment or string that
+// starts above the window isn't recognised as such.
+// This doesn't go through core/lexer, which lexes a contiguous string. The buffers that fall back are the
+// large ones, i.e. piece tables and file mappings, so the window would have to be copied out on every change to
+// it. Reading through char_at also lets each language pick its own comment syntax
+void fallback_highlight(DynamicArray<RangeColor> *colors, Buffer *buffer, i64 byte_start, i64 byte_end)
+{
+    u32 *comment_color = map_find(&app.syntax_colors, "comment");
+    u32 *string_color = map_find(&app.syntax_colors, "string");
+    u32 *number_color = map_find(&app.syntax_colors, "constant");
+
+    String line_comment = "//";
+    String block_start = "/*";
+    String block_end = "*/";
+    bool char_literals = true;
+
+    switch (buffer->language) {
+    case LANGUAGE_BASH:
+        line_comment = "#";
+        block_start = block_end = "";
+        char_literals = false;
+        break;
+    case LANGUAGE_LUA:
+        line_comment = "--";
+        block_start = block_end = "";
+        break;
+    case LANGUAGE_RUST:
+        // NOTE(jesper): lifetimes would be mistaken for unterminated char literals
+        char_literals = false;
+        break;
+    default: break;
+    }
+
+    i64 end = MIN(byte_end, byte_start + FALLBACK_HIGHLIGHT_MAX_BYTES);
+    for (i64 p = byte_start; p < end;) {
+        i64 start = p;
+        char c = char_at(buffer, p);
+
+        if (buffer_matches(buffer, p, end, line_comment)) {
+            while (p < end && char_at(buffer, p) != '\n' && char_at(buffer, p) != '\r') p++;
+            if (comment_color) array_add(colors, { start, p, *comment_color });
+        } else if (buffer_matches(buffer, p, end, block_start)) {
+            p += block_start.length;
+            while (p < end && !buffer_matches(buffer, p, end, block_end)) p++;
+            p = MIN(p + block_end.length, end);
+            if (comment_color) array_add(colors, { start, p, *comment_color });
+        } else if (c == '"' || (c == '\'' && char_literals)) {
+            for (p++; p < end;) {
+                char n = char_at(buffer, p++);
+                if (n == '\\') p++;
+                else if (n == c || n == '\n') break;
+            }
+            p = MIN(p, end);
+            if (string_color) array_add(colors, { start, p, *string_color });
+        } else if (c >= '0' && c <= '9') {
+            while (p < end) {
+                char n = char_at(buffer, p);
+                if (!(n >= '0' && n <= '9') && !(n >= 'a' && n <= 'z') && !(n >= 'A' && n <= 'Z') && n != '.' && n != '_') break;
+                p++;
+            }
+            if (number_color) array_add(colors, { start, p, *number_color });
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            while (p < end) {
+                char n = char_at(buffer, p);
+                if (!(n >= '0' && n <= '9') && !(n >= 'a' && n <= 'z') && !(n >= 'A' && n <= 'Z') && n != '_') break;
+                p++;
+            }
+        } else {
+            p++;
+        }
+    }
+}
+
+// NOTE(jesper): builds the line offsets of a mapped buffer in the background. The file is read through
+// its own handle instead of the mapping so that indexing doesn't fault the entire file into our working set
+int line_index_thread(void *data)
+{
+    LineIndexJob *job = (LineIndexJob*)data;
+
+    FILE *f = fopen(job->path, "rb");
+    if (!f) LOG_ERROR("failed to open file '%s' for line indexing", job->path);
+
+    char *chunk = ALLOC_ARR(mem_dynamic, char, LINE_INDEX_CHUNK_SIZE);
+    defer { FREE(mem_dynamic, chunk); };
+
+    i64 base = 0, count = 0;
+    bool eof = !f;
+
+    do {
+        if (f) {
+            i64 bytes = fread(chunk+count, 1, LINE_INDEX_CHUNK_SIZE-count, f);
+            eof = bytes < LINE_INDEX_CHUNK_SIZE-count;
+            count += bytes;
+        }
+
+        // NOTE(jesper): hold back the last byte until the next chunk is read, unless we're at the end of
+        // the file, so that we don't split a two-byte newline in half
+        i64 end = eof ? count : count-1;
+
+        i64 i = 0;
+        {
+            std::lock_guard lk(job->m);
+            for (; i < end; i++) {
+                char c = chunk[i];
+                if (c != '\n' && c != '\r') continue;
+
+                if (i+1 < count &&
+                    ((c == '\n' && chunk[i+1] == '\r') ||
+                     (c == '\r' && chunk[i+1] == '\n')))
+                {
+                    i++;
+                }
+
+                array_add(&job->line_starts, base+i+1);
+            }
+
+            job->done = eof;
+        }
+        job->cv.notify_all();
+
+        i = MIN(i, count);
+        memmove(chunk, chunk+i, count-i);
+        base += i;
+        count -= i;
+    } while (!eof);
+
+    if (f) fclose(f);
+    return 0;
+}
+
+LineIndexJob* create_line_index_job(String path)
+{
+    LineIndexJob *job = ALLOC_T(mem_dynamic, LineIndexJob) {};
+    job->path = sz_string(path, mem_dynamic);
+
+    create_thread(line_index_thread, job);
+    return job;
+}
+
+// NOTE(jesper): moves a line start in the file to where it is in the buffer after the edits, or returns -1 if the
+// newline in front of it was removed
+i64 line_index_job_map_offset(LineIndexJob *job, i64 offset)
+{
+    for (LineIndexEdit edit : job->edits) {
+        if (offset <= edit.start) continue;
+        if (offset <= edit.end) return -1;
+        offset += edit.new_end - edit.end;
+    }
+    return offset;
+}
+
+// NOTE(jesper): records an edit made to a buffer whose line index is still being built. The edit has already been
+// applied to the index, which only has the lines found so far, and the lines found after it are moved past it
+void buffer_line_index_edit(Buffer *buffer, i64 start, i64 end, i64 new_end)
+{
+    if (LineIndexJob *job = buffer->line_index_job; job) {
+        array_add(&job->edits, { start, end, new_end });
+    }
+}
+
+// NOTE(jesper): moves the lines indexed so far into the buffer's line index, and updates the line counts of
+// any views showing it
+void buffer_poll_line_index(Buffer *buffer)
+{
+    LineIndexJob *job = buffer->line_index_job;
+    if (!job) return;
+
+    bool done = false;
+    {
+        std::lock_guard lk(job->m);
+        for (i64 offset : job->line_starts) {
+            offset = line_index_job_map_offset(job, offset);
+            if (offset >= 0) line_index_split(&buffer->line_index, offset);
+        }
+
+        for (View &view : app.views) {
+            if (view.lines.buffer == buffer->id) view_lines_update(&view.lines);
+        }
+
+        job->line_starts.count = 0;
+        done = job->done;
+    }
+
+    if (done) {
+        FREE(mem_dynamic, job->line_starts.data);
+        FREE(mem_dynamic, job->edits.data);
+        FREE(mem_dynamic, job->path);
+        FREE(mem_dynamic, job);
+        buffer->line_index_job = nullptr;
+    }
+}
+
+void buffer_wait_line_index(Buffer *buffer)
+{
+    if (LineIndexJob *job = buffer->line_index_job; job) {
+        std::unique_lock lk(job->m);
+        job->cv.wait(lk, [job] { return job->done; });
+    }
+
+    buffer_poll_line_index(buffer);
+}
+
+// NOTE(jesper): lets go of the flat buffer's reference to the contents its syntax snapshots share, copying them if
+// a snapshot still references them. The snapshot that's waiting for the worker is dropped first, as the one taken
+// after the edit replaces it, so the contents are only copied while the worker is parsing them, i.e. at most once
+// a parse. Flat buffers stay flat, and BUFFER_PIECE_THRESHOLD alone decides which buffers are piece tables
+void buffer_unshare_flat(Buffer *buffer)
+{
+    FlatShare *shared = buffer->flat.shared;
+    if (!shared) return;
+
+    buffer->flat.shared = nullptr;
+
+    if (SyntaxWorker *worker = buffer->syntax_worker; worker) {
+        std::lock_guard lk(worker->m);
+        if (worker->snapshot) {
+            destroy_syntax_snapshot(worker->snapshot);
+            worker->snapshot = nullptr;
+        }
+    }
+
+    // NOTE(jesper): only the main thread takes references, so the buffer's being the last one can't change
+    if (__atomic_load_n(&shared->refs, __ATOMIC_SEQ_CST) == 1) {
+        FREE(mem_dynamic, shared);
+        return;
+    }
+
+    char *data = ALLOC_ARR(mem_dynamic, char, MAX(buffer->flat.capacity, 1));
+    memcpy(data, buffer->flat.data, buffer->flat.size);
+    buffer->flat.data = data;
+
+    flat_share_release(shared);
+}
+
+// NOTE(jesper): mapped buffers are read-only views of the file until they're first edited, at which point
+// they're converted to a piece table with the mapping as its original contents, i.e. copy-on-write. Flat buffers
+// are copied if their syntax snapshots still reference them
+void buffer_make_editable(Buffer *buffer)
+{
+    if (buffer->type == BUFFER_FLAT) buffer_unshare_flat(buffer);
+    if (buffer->type != BUFFER_MAPPED) return;
+
+    // NOTE(jesper): the line index doesn't have to be complete, see buffer_line_index_edit
+    buffer->type = BUFFER_PIECE;
+    buffer->piece = create_piece_table(buffer->mapping.data, buffer->mapping.size, mem_dynamic);
+}
+
+// NOTE(jesper): moves the buffer onto a mapping of path, which has to have the buffer's contents, i.e. be the file it
+// was just saved to, and unmaps the file it was opened from. The history entries that reference the old mapping are
+// copied, which is only the text they removed from it
+bool buffer_remap_file(Buffer *buffer, String path)
+{
+    buffer_make_editable(buffer);
+    ASSERT(buffer->type == BUFFER_PIECE);
+
+    i64 size = 0;
+    char *data = map_file_readonly(path, &size);
+    if (!data || size != buffer->piece->size) {
+        LOG_ERROR("failed to map saved file '%.*s'", STRFMT(path));
+        if (data) unmap_file(data, size);
+        return false;
+    }
+
+    char *mapped = buffer->mapping.data;
+    i64 mapped_size = buffer->mapping.size;
+
+    for (BufferHistory &entry : buffer->history) {
+        if (entry.type != BUFFER_INSERT && entry.type != BUFFER_REMOVE) continue;
+        if (!entry.text_ref) continue;
+
+        if (entry.text.data >= mapped && entry.text.data < mapped+mapped_size) {
+            entry.text = duplicate_string(entry.text, mem_dynamic);
+            entry.text_ref = false;
+        }
     }
+
+    piece_reset(buffer->piece, data, size);
+
+    unmap_file(mapped, mapped_size);
+    buffer->mapping = { data, size };
+    return true;
 }
 
 void calculate_num_visible_lines(View *view)
 {
-    i32 lines_visible = (i32)ceilf(view->rect.size().y / (f32)app.mono.line_height);
-    view->lines_dirty = view->lines_dirty || lines_visible != view->lines_visible;
-    view->lines_visible = lines_visible;
+    view->lines_visible = (i32)ceilf(view->rect.size().y / (f32)app.mono.line_height);
+
+    // NOTE(jesper): line wrapping only depends on the width of the view, resizing it vertically
+    // doesn't need the lines to be rewrapped
+    f32 wrap_width = view->rect.size().x;
+    view->lines_dirty = view->lines_dirty || wrap_width != view->wrap_width;
+    view->wrap_width = wrap_width;
 }
 
 BufferId create_buffer(String file)
@@ -926,10 +2482,29 @@ BufferId create_buffer(String file)
     buffer.name = filename_of(buffer.file_path);
     buffer.newline_mode = NEWLINE_LF;
 
-    FileInfo f = read_file(file, mem_dynamic);
-    buffer.flat.data = (char*)f.data;
-    buffer.flat.size = f.size;
-    buffer.flat.capacity = f.size;
+    FileInfo f{};
+
+    i64 mapped_size = 0;
+    char *mapped = nullptr;
+    if (get_file_size(buffer.file_path) >= BUFFER_MAPPED_THRESHOLD) {
+        mapped = map_file_readonly(buffer.file_path, &mapped_size);
+    }
+
+    if (mapped) {
+        buffer.type = BUFFER_MAPPED;
+        buffer.mapping = { mapped, mapped_size };
+        buffer.flat = { mapped, mapped_size, mapped_size };
+    } else {
+        f = read_file(file, mem_dynamic);
+        if (f.size >= BUFFER_PIECE_THRESHOLD) {
+            buffer.type = BUFFER_PIECE;
+            buffer.piece = create_piece_table((char*)f.data, f.size, mem_dynamic);
+        } else {
+            buffer.flat.data = (char*)f.data;
+            buffer.flat.size = f.size;
+            buffer.flat.capacity = f.size;
+        }
+    }
 
     String ext = extension_of(buffer.file_path);
     if (ext == ".cpp" || ext == ".c" ||
@@ -947,11 +2522,33 @@ BufferId create_buffer(String file)
         buffer.language = LANGUAGE_LUA;
     }
 
-    if (f.data) {
-        array_add(&buffer.line_offsets, i64(0));
+    if (buffer.type == BUFFER_MAPPED) {
+        // NOTE(jesper): syntax highlighting, language servers, and line wrapping all require processing the
+        // entire file up front, which is exactly what we're trying to avoid for mapped buffers
+        buffer.language = LANGUAGE_NONE;
+        buffer.line_wrap = false;
+
+        // NOTE(jesper): guess the newline mode from the first newline instead of scanning the whole file
+        for (i64 offset = 0; offset < MIN(mapped_size, 64*1024); offset++) {
+            char c = mapped[offset];
+            if (c != '\n' && c != '\r') continue;
+
+            char n = offset < mapped_size-1 ? mapped[offset+1] : 0;
+            if (c == '\n' && n == '\r') buffer.newline_mode = NEWLINE_LFCR;
+            else if (c == '\n') buffer.newline_mode = NEWLINE_LF;
+            else if (c == '\r' && n == '\n') buffer.newline_mode = NEWLINE_CRLF;
+            else buffer.newline_mode = NEWLINE_CR;
+            break;
+        }
 
+        // NOTE(jesper): the index starts out as a single line spanning the file, which is split as the
+        // background job finds its newlines
+        line_index_push(&buffer.line_index, mapped_size);
+        buffer.line_index_job = create_line_index_job(buffer.file_path);
+    } else if (f.data) {
         // TODO(jesper): guess tabs/spaces based on file content?
 
+        i64 line_start = 0;
         bool found_newline_mode = false;
         for (i64 offset = 0; offset < f.size; offset++) {
             char n = offset < f.size-1 ? char(f.data[offset+1]) : 0;
@@ -974,18 +2571,22 @@ BufferId create_buffer(String file)
                     found_newline_mode = true;
                 }
 
-                array_add(&buffer.line_offsets, offset);
+                line_index_push(&buffer.line_index, offset+1 - line_start);
+                line_start = offset+1;
             }
         }
 
+        line_index_push(&buffer.line_index, f.size - line_start);
         ts_parse_buffer(&buffer);
+    } else {
+        line_index_push(&buffer.line_index, 0);
     }
 
     String newline_str = string_from_enum(buffer.newline_mode);
     LOG_INFO("created buffer: %.*s, newline mode: %.*s", STRFMT(file), STRFMT(newline_str));
 
     array_add(&buffers, buffer);
-    lsp_open(&app.lsp[buffer.language], buffer.id, "cpp", String{ buffer.flat.data, (i32)buffer.flat.size });
+    lsp_open(&app.lsp[buffer.language], buffer.id, "cpp", String{ (char*)f.data, (i32)f.size });
 
     return buffer.id;
 }
@@ -1011,12 +2612,18 @@ void view_set_buffer(View *view, BufferId buffer)
         return nullptr;
     };
 
+    // NOTE(jesper): the view lines depend on the wrapped window, so the scroll offset is stored as a buffer line
+    i32 top_line = 0;
+    if (Buffer *b = get_buffer(view->buffer); b) {
+        top_line = line_from_offset(&b->line_index, line_start_offset(view->line_offset, view->lines));
+    }
+
     ViewBufferState state{
         .buffer = view->buffer,
         .caret = view->caret,
         .mark = view->mark,
         .voffset = view->voffset,
-        .line_offset = view->line_offset,
+        .line_offset = top_line,
     };
 
     ViewBufferState *it = find_buffer_state(view, view->buffer);
@@ -1036,6 +2643,7 @@ void view_set_buffer(View *view, BufferId buffer)
     }
 
     view->buffer = buffer;
+    view_lines_reset(&view->lines, buffer);
 
     i32 idx = array_find_index(view->buffers, view->buffer);
     if (idx >= 0) array_remove(&view->buffers, idx);
@@ -1776,18 +3384,9 @@ LspRange lsp_range_from_byte_offsets(LspConnection *lsp, BufferId buffer_id, i32
         return {};
     }
 
-    i32 start_line = line_from_offset(offset_start, buffer->line_offsets);
-    i32 end_line = line_from_offset(offset_end ,buffer->line_offsets, start_line);
-
-    i64 start_line_start_offset = buffer->line_offsets[start_line];
-    i64 start_line_end_offset = start_line+1 < buffer->line_offsets.count
-        ? buffer->line_offsets[start_line+1]
-        : *array_tail(buffer->line_offsets);
-
-    i64 end_line_start_offset = buffer->line_offsets[end_line];
-    i64 end_line_end_offset = end_line+1 < buffer->line_offsets.count
-        ? buffer->line_offsets[end_line+1]
-        : *array_tail(buffer->line_offsets);
+    i64 start_line_offset, end_line_offset;
+    i32 start_line = line_from_offset(&buffer->line_index, offset_start, &start_line_offset);
+    i32 end_line = line_from_offset(&buffer->line_index, offset_end, &end_line_offset);
 
     LspRange range{};
     range.start.line = start_line;
@@ -1795,19 +3394,8 @@ LspRange lsp_range_from_byte_offsets(LspConnection *lsp, BufferId buffer_id, i32
 
     switch (lsp->server_capabilities.position_encoding) {
     case LSP_UTF8:
-        for (i32 i = 0; i+start_line_start_offset < start_line_end_offset; i++) {
-            range.start.character = i;
-            if (buffer->line_offsets[start_line] + i >= offset_start) {
-                break;
-            }
-        }
-
-        for (i32 i = range.start.character; i+end_line_start_offset < end_line_end_offset; i++) {
-            range.end.character = i;
-            if (buffer->line_offsets[end_line] + i >= offset_end) {
-                break;
-            }
-        }
+        range.start.character = u32(offset_start - start_line_offset);
+        range.end.character = u32(offset_end - end_line_offset);
         break;
     case LSP_UTF16:
         PANIC("[lsp] unimplemented path: UTF16 position encoding");
@@ -1825,27 +3413,14 @@ LspPosition lsp_position_from_byte_offset(LspConnection *lsp, BufferId buffer_id
         return {};
     }
 
-    i32 line = line_from_offset(offset, buffer->line_offsets);
-    if (line < 0) {
-        LOG_ERROR("unable to get line offset from buffer byte offset");
-        return {};
-    }
-
-    i64 start_offset = buffer->line_offsets[line];
-    i64 end_offset = line+1 < buffer->line_offsets.count
-        ? buffer->line_offsets[line+1]
-        : *array_tail(buffer->line_offsets);
+    i64 line_offset;
+    i32 line = line_from_offset(&buffer->line_index, offset, &line_offset);
 
     LspPosition position{ .line = u32(line) };
 
     switch (lsp->server_capabilities.position_encoding) {
     case LSP_UTF8:
-        for (i32 i = 0; i+start_offset < end_offset; i++) {
-            position.character = i;
-            if (buffer->line_offsets[line] + i >= offset) {
-                break;
-            }
-        }
+        position.character = u32(offset - line_offset);
         break;
     case LSP_UTF16:
         PANIC("[lsp] unimplemented path: UTF16 position encoding");
@@ -1956,6 +3531,81 @@ Array<LspLocation> lsp_request_definition(
 
 
 
+bool headless_work_pending() INTERNAL
+{
+    if (font_glyphs_pending()) return true;
+    for (View &view : app.views) if (view.glyphs.atlas_generation != app.mono.generation) return true;
+    for (Buffer &buffer : buffers) if (buffer.line_index_job) return true;
+    for (Buffer &buffer : buffers) if (buffer.syntax_worker && buffer.syntax_version < buffer.version) return true;
+    return false;
+}
+
+// NOTE(jesper): renders a fixed number of frames without a window or input, which is what the software backend
+// runs instead of the main loop. Every frame is treated as damaged so that each one is drawn in full, and the
+// frame times are logged at the end. With --snapshot, a settled frame is written to a file for pixel comparisons
+int app_run_headless(Array<String> args) INTERNAL
+{
+    i32 frames[1] = { 120 };
+    parse_cmd_argument(args.data, args.count, "--frames", frames);
+
+    String snapshot{};
+    for (i32 i = 0; i+1 < args.count; i++) {
+        if (args[i] == "--snapshot") snapshot = args[i+1];
+    }
+
+    auto headless_frame = []
+    {
+        RESET_ALLOC(mem_frame);
+        for (View &view : app.views) view.draw_dirty = true;
+        gui_damage_windows();
+        update_and_render();
+    };
+
+    f32 total = 0, min_ms = 0, max_ms = 0;
+    for (i32 i = 0; i < frames[0]; i++) {
+        auto start = std::chrono::steady_clock::now();
+        headless_frame();
+        auto end = std::chrono::steady_clock::now();
+
+        f32 ms = std::chrono::duration<f32, std::milli>(end - start).count();
+        total += ms;
+        min_ms = i == 0 ? ms : MIN(min_ms, ms);
+        max_ms = MAX(max_ms, ms);
+    }
+
+    if (frames[0] > 0) {
+        LOG_INFO("headless: %d frames, avg %.3f ms, min %.3f ms, max %.3f ms",
+                 frames[0], total / frames[0], min_ms, max_ms);
+    }
+
+#if defined(GFX_SOFTWARE)
+    if (snapshot.length > 0) {
+        // NOTE(jesper): glyphs are rasterized, and buffers indexed and parsed, on other threads, so what the timed
+        // frames drew depends on how far along those were. Keep drawing until they've all finished, and then one
+        // more frame to draw what the last one uploaded, so that the snapshot only depends on the arguments
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        do {
+            if (std::chrono::steady_clock::now() > deadline) {
+                LOG_ERROR("timed out waiting for background work before snapshot");
+                return 1;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            headless_frame();
+        } while (headless_work_pending());
+
+        headless_frame();
+    }
+
+    if (snapshot.length > 0 && !gfx_write_snapshot(snapshot)) {
+        LOG_ERROR("failed to write snapshot: %.*s", STRFMT(snapshot));
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
 int app_main(Array<String> args)
 {
     Vector2i resolution{ 1280, 720 };
@@ -1966,7 +3616,13 @@ int app_main(Array<String> args)
         resolution[1] = data[1];
     }
 
+    for (String arg : args) {
+        if (arg == "--sdf-fonts") app.sdf_fonts = true;
+    }
+
+#if !defined(GFX_SOFTWARE)
     app.wnd = create_window({"mimir", resolution.x, resolution.y });
+#endif
 
     fzy_init_table();
 
@@ -1995,8 +3651,12 @@ int app_main(Array<String> args)
             }});
     }
 
+#if defined(GFX_SOFTWARE)
+    init_gfx({ (f32)resolution.x, (f32)resolution.y });
+#else
     init_gfx(get_client_resolution(app.wnd));
-    init_gui();
+#endif
+    init_gui(app.sdf_fonts);
 
     init_input_map(app.input.edit, {
         { INSERT_MODE, IKEY(KC_I) },
@@ -2010,6 +3670,9 @@ int app_main(Array<String> args)
 
         { GOTO_DEFINITION, ICHORD(IKEY(KC_G), IKEY(KC_D)) },
 
+        { ZOOM_IN,  IKEY(KC_UP, MF_CTRL) },
+        { ZOOM_OUT, IKEY(KC_DOWN, MF_CTRL) },
+
         { PASTE,        IKEY(KC_P) },
         { COPY_RANGE,   IKEY(KC_Y) },
         { CUT_RANGE,    IKEY(KC_X) },
@@ -2027,6 +3690,10 @@ int app_main(Array<String> args)
     map_set(&app.language_map, "cpp", LANGUAGE_CPP);
     map_set(&app.language_map, "comment", LANGUAGE_COMMENT);
 
+    // NOTE(jesper): every tree-sitter allocation must go through the heap allocator, including the queries
+    // created below, as it relies on the allocation header when freeing
+    ts_set_allocator(ts_heap_malloc, ts_heap_calloc, ts_heap_realloc, ts_heap_free);
+
     app.languages[LANGUAGE_CPP] = tree_sitter_cpp();
     app.languages[LANGUAGE_CS] = tree_sitter_c_sharp();
     app.languages[LANGUAGE_RUST] = tree_sitter_rust();
@@ -2043,9 +3710,8 @@ int app_main(Array<String> args)
 
     app.injections[LANGUAGE_CPP] = ts_create_query(app.languages[LANGUAGE_CPP], "queries/cpp/injections.scm");
 
-    ts_custom_alloc = vm_freelist_allocator(5*1024*1024*1024ull);
-    // TODO(jesper): disabled because I have a leak in ts_custom_malloc
-    // ts_set_allocator(ts_custom_malloc, ts_custom_calloc, ts_custom_realloc, ts_custom_free);
+    for (i64 &limit : app.syntax_size_limit) limit = SYNTAX_SIZE_LIMIT;
+    app.syntax_size_limit[LANGUAGE_CPP] = 32*MiB;
 
     u32 fg = bgr_pack(app.fg);
     map_set(&app.syntax_colors, "unused", fg);
@@ -2083,14 +3749,15 @@ int app_main(Array<String> args)
         app.syntax_colors.slots[i].value = bgr_pack(linear_from_sRGB(c));
     }
 
+    ts_build_capture_colors();
+
     // if (auto a = find_asset("textures/build_16x16.png"); a) app.icons.build = gfx_load_texture(a->data, a->size);
 
-    app.mono = create_font("fonts/UbuntuMono/UbuntuMono-Regular.ttf", 18, true);
+    app.mono = create_font("fonts/UbuntuMono/UbuntuMono-Regular.ttf", app.mono_pixel_height, true, app.sdf_fonts);
 
     for (auto it : iterator(app.views)) {
         it->gui_id = gui_gen_id(it.index);
         it->lines_dirty = true;
-        glGenBuffers(1, &it->glyph_data_ssbo);
     }
     app.current_view->id = 0;
 
@@ -2239,18 +3906,22 @@ int app_main(Array<String> args)
     }
 
     debug.buffer_history.wnd = gui_create_window({ "history", .position = { 0, 40 }, .size = { 300, 200 } });
+    debug.syntax_memory.wnd = gui_create_window({ "syntax memory", .position = { 300, 40 }, .size = { 300, 200 } });
 
+#if defined(GFX_SOFTWARE)
+    int result = app_run_headless(args);
+    shutdown_job_pool();
+    return result;
+#else
     while (true) {
         RESET_ALLOC(mem_frame);
 
-        gfx_begin_frame();
-
         app_gather_input(app.wnd);
-        update_and_render();
-        present_window(app.wnd);
+        if (update_and_render()) present_window(app.wnd);
     }
 
     return 0;
+#endif
 }
 
 bool app_change_resolution(Vector2 resolution)
@@ -2260,40 +3931,87 @@ bool app_change_resolution(Vector2 resolution)
     return true;
 }
 
-i64 utf8_incr(Buffer *buffer, i64 i)
+// NOTE(jesper): the views' lines are wrapped and their glyph grids sized by the font's cells, so they're redone
+// at the new size. The atlas is unchanged, SDF glyphs are drawn at any size from it
+void app_zoom_mono_font(f32 delta)
 {
-    switch (buffer->type) {
-    case BUFFER_FLAT: return utf8_incr(buffer->flat.data, buffer->flat.size, i);
+    if (!app.mono.sdf) {
+        LOG_INFO("the text can only be zoomed with --sdf-fonts");
+        return;
     }
+
+    f32 pixel_height = CLAMP(app.mono_pixel_height + delta, MONO_FONT_MIN_PIXEL_HEIGHT, MONO_FONT_MAX_PIXEL_HEIGHT);
+    if (pixel_height == app.mono_pixel_height) return;
+    if (!font_set_pixel_height(&app.mono, pixel_height)) return;
+
+    app.mono_pixel_height = pixel_height;
+    for (View &view : app.views) view.lines_dirty = true;
+    app.animating = true;
 }
 
-i64 utf8_decr(Buffer *buffer, i64 i)
+i32 utf32_it_next(Buffer *buffer, i64 *byte_offset)
 {
     switch (buffer->type) {
-    case BUFFER_FLAT: return utf8_decr(buffer->flat.data, i);
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return utf32_it_next(buffer->flat.data, buffer->flat.size, byte_offset);
+    case BUFFER_PIECE: {
+            String chunk = piece_chunk_at(buffer->piece, *byte_offset);
+            if (chunk.length == 0) return 0;
+
+            // NOTE(jesper): the code point may straddle two pieces, in which case we gather its bytes
+            // into a temporary to decode it
+            i64 offset = 0;
+            i32 c;
+            if (chunk.length >= 4 || *byte_offset+chunk.length == buffer->piece->size) {
+                c = utf32_it_next(chunk.data, chunk.length, &offset);
+            } else {
+                char tmp[4];
+                i32 count = 0;
+                for (; count < 4 && *byte_offset+count < buffer->piece->size; count++) {
+                    tmp[count] = piece_char_at(buffer->piece, *byte_offset+count);
+                }
+                c = utf32_it_next(tmp, count, &offset);
+            }
+
+            *byte_offset += offset;
+            return c;
+        }
     }
 }
 
-i64 utf8_decr(BufferId buffer_id, i64 i)
+i64 utf8_incr(Buffer *buffer, i64 i)
 {
-    Buffer *buffer = get_buffer(buffer_id);
-    if (!buffer) return i;
-
-    return utf8_decr(buffer, i);
+    switch (buffer->type) {
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return utf8_incr(buffer->flat.data, buffer->flat.size, i);
+    case BUFFER_PIECE:
+        if (i >= buffer->piece->size) return i;
+        utf32_it_next(buffer, &i);
+        return i;
+    }
 }
 
-i32 utf32_it_next(Buffer *buffer, i64 *byte_offset)
+i64 utf8_decr(Buffer *buffer, i64 i)
 {
     switch (buffer->type) {
-    case BUFFER_FLAT: return utf32_it_next(buffer->flat.data, buffer->flat.size, byte_offset);
+    case BUFFER_FLAT:
+    case BUFFER_MAPPED:
+        return utf8_decr(buffer->flat.data, i);
+    case BUFFER_PIECE:
+        if (i <= 0) return 0;
+        do i--; while (i > 0 && (piece_char_at(buffer->piece, i) & 0xC0) == 0x80);
+        return i;
     }
 }
 
-i64 buffer_end(Buffer *buffer)
+i64 utf8_decr(BufferId buffer_id, i64 i)
 {
-    switch (buffer->type) {
-    case BUFFER_FLAT: return buffer->flat.size;
-    }
+    Buffer *buffer = get_buffer(buffer_id);
+    if (!buffer) return i;
+
+    return utf8_decr(buffer, i);
 }
 
 i64 buffer_end(BufferId buffer_id)
@@ -2308,23 +4026,24 @@ i64 buffer_end(BufferId buffer_id)
 i64 buffer_start(Buffer *buffer)
 {
     switch (buffer->type) {
-    case BUFFER_FLAT: return 0;
+    case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED:
+        return 0;
     }
 }
 
-i64 line_start_offset(i32 line, Array<ViewLine> lines)
+i64 line_start_offset(i32 line, ViewLines lines)
 {
     return line < lines.count ? lines[line].offset : 0;
 }
 
-i64 line_end_offset(i32 line, Array<ViewLine> lines, Buffer *buffer)
+i64 line_end_offset(i32 line, ViewLines lines, Buffer *buffer)
 {
-    switch (buffer->type) {
-    case BUFFER_FLAT: return (line+1) < lines.count ? lines[line+1].offset : buffer->flat.size;
-    }
+    return (line+1) < lines.count ? lines[line+1].offset : buffer_end(buffer);
 }
 
-i64 line_end_offset(i32 wrapped_line, Array<ViewLine> lines, BufferId buffer_id)
+i64 line_end_offset(i32 wrapped_line, ViewLines lines, BufferId buffer_id)
 {
     return line_end_offset(wrapped_line, lines, &buffers[buffer_id.index]);
 }
@@ -2372,23 +4091,20 @@ i64 buffer_next_offset(BufferId buffer_id, i64 byte_offset)
 
     i64 next_offset = byte_offset;
 
-    switch (buffer->type) {
-    case BUFFER_FLAT:
-        char c = char_at(buffer, byte_offset);
-        if (c == '\n' || c == '\r') {
-            next_offset = next_byte(buffer, byte_offset);
-            char next_c = char_at(buffer, next_offset);
+    char c = char_at(buffer, byte_offset);
+    if (c == '\n' || c == '\r') {
+        next_offset = next_byte(buffer, byte_offset);
 
-            if (next_offset < buffer->flat.size &&
-                ((c == '\n' && next_c == '\r') ||
-                 (c == '\r' && next_c == '\n')))
+        if (next_offset < end_offset) {
+            char next_c = char_at(buffer, next_offset);
+            if ((c == '\n' && next_c == '\r') ||
+                (c == '\r' && next_c == '\n'))
             {
                 next_offset = next_byte(buffer, next_offset);
             }
-        } else {
-            next_offset = utf8_incr(buffer, byte_offset);
         }
-        break;
+    } else {
+        next_offset = utf8_incr(buffer, byte_offset);
     }
 
     return next_offset;
@@ -2404,6 +4120,8 @@ i64 buffer_increment_offset(BufferId buffer_id, i64 byte_offset, i64 count)
 
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED:
         return MIN(end_offset, byte_offset+count);
     }
 
@@ -2415,7 +4133,7 @@ Range_i32 range_i32(i32 a, i32 b)
     return { .start = MIN(a, b), .end = MAX(a, b) };
 }
 
-Range_i64 caret_range(Caret c0, Caret c1, Array<ViewLine> lines, BufferId buffer, bool lines_block)
+Range_i64 caret_range(Caret c0, Caret c1, ViewLines lines, BufferId buffer, bool lines_block)
 {
     Range_i64 r;
 
@@ -2446,14 +4164,14 @@ i64 caret_nth_offset(BufferId buffer_id, i64 current, i32 n)
     return offset;
 }
 
-i32 calc_unwrapped_line(i32 wrapped_line, Array<ViewLine> lines)
+i32 calc_unwrapped_line(i32 wrapped_line, ViewLines lines)
 {
     i32 line = CLAMP(wrapped_line, 0, lines.count-1);
     while (line > 0 && lines[line].wrapped) line--;
     return line;
 }
 
-i32 wrapped_line_from_offset(i64 offset, Array<ViewLine> lines, i32 guessed_line = 0)
+i32 wrapped_line_from_offset(i64 offset, ViewLines lines, i32 guessed_line = 0)
 {
     i32 line = CLAMP(guessed_line, 0, lines.count-1);
     while (line > 0 && offset < lines[line].offset) line--;
@@ -2461,22 +4179,13 @@ i32 wrapped_line_from_offset(i64 offset, Array<ViewLine> lines, i32 guessed_line
     return line;
 }
 
-i32 line_from_offset(i64 offset, Array<i64> offsets, i32 guessed_line /*= 0*/) INTERNAL
-{
-    // TODO(jesper): these are sorted offsets, use a binary search to find the line
-    i32 line = CLAMP(guessed_line, 0, offsets.count-1);
-    while (line > 0 && offset < offsets[line]) line--;
-    while (line < (offsets.count-2) && offset > offsets[line+1]) line++;
-    return line;
-}
-
-i32 unwrapped_line_from_offset(i64 offset, Array<ViewLine> lines, u32 guessed_line = 0)
+i32 unwrapped_line_from_offset(i64 offset, ViewLines lines, u32 guessed_line = 0)
 {
     i32 line = wrapped_line_from_offset(offset, lines, guessed_line);
     return calc_unwrapped_line(line, lines);
 }
 
-i64 wrapped_column_count(i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer)
+i64 wrapped_column_count(i32 wrapped_line, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2499,7 +4208,7 @@ i64 wrapped_column_count(i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer
     return count;
 }
 
-i64 column_count(i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer)
+i64 column_count(i32 wrapped_line, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2539,7 +4248,7 @@ i64 column_count(i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer)
     return count;
 }
 
-i64 calc_wrapped_column_from_byte_offset(i64 byte_offset, i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer)
+i64 calc_wrapped_column_from_byte_offset(i64 byte_offset, i32 wrapped_line, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2559,7 +4268,7 @@ i64 calc_wrapped_column_from_byte_offset(i64 byte_offset, i32 wrapped_line, Arra
     return column;
 }
 
-i64 calc_wrapped_column(i32 wrapped_line, i64 target_column, Array<ViewLine> lines, Buffer *buffer)
+i64 calc_wrapped_column(i32 wrapped_line, i64 target_column, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2581,7 +4290,7 @@ i64 calc_wrapped_column(i32 wrapped_line, i64 target_column, Array<ViewLine> lin
     return column;
 }
 
-i64 calc_unwrapped_column(i32 wrapped_line, i64 wrapped_column, Array<ViewLine> lines, Buffer *buffer)
+i64 calc_unwrapped_column(i32 wrapped_line, i64 wrapped_column, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2597,7 +4306,7 @@ i64 calc_unwrapped_column(i32 wrapped_line, i64 wrapped_column, Array<ViewLine>
     return column;
 }
 
-i64 unwrapped_column_from_offset(i64 offset, Array<ViewLine> lines, i32 wrapped_line)
+i64 unwrapped_column_from_offset(i64 offset, ViewLines lines, i32 wrapped_line)
 {
     i32 line = calc_unwrapped_line(wrapped_line, lines);
     i64 column = 0;
@@ -2607,7 +4316,7 @@ i64 unwrapped_column_from_offset(i64 offset, Array<ViewLine> lines, i32 wrapped_
 
 
 
-i64 calc_byte_offset(i64 wrapped_column, i32 wrapped_line, Array<ViewLine> lines, Buffer *buffer)
+i64 calc_byte_offset(i64 wrapped_column, i32 wrapped_line, ViewLines lines, Buffer *buffer)
 {
     if (wrapped_line >= lines.count) return 0;
 
@@ -2623,7 +4332,7 @@ i64 calc_byte_offset(i64 wrapped_column, i32 wrapped_line, Array<ViewLine> lines
 
 
 // NOTE(jesper): returns >= lines.count if line >= lines.count-1
-i32 next_unwrapped_line(i32 line, Array<ViewLine> lines)
+i32 next_unwrapped_line(i32 line, ViewLines lines)
 {
     i32 l = line;
     while (l < lines.count-1 && lines[l+1].wrapped) l++;
@@ -2631,7 +4340,7 @@ i32 next_unwrapped_line(i32 line, Array<ViewLine> lines)
 }
 
 // NOTE(jesper): returns -1 if line == 0
-i32 prev_unwrapped_line(i32 line, Array<ViewLine> lines)
+i32 prev_unwrapped_line(i32 line, ViewLines lines)
 {
     i32 l = line-1;
     while (l > 0 && lines[l].wrapped) l--;
@@ -2639,7 +4348,7 @@ i32 prev_unwrapped_line(i32 line, Array<ViewLine> lines)
 }
 
 
-void recalc_caret_line(i32 new_wrapped_line, i32 *wrapped_line, i32 *line, Array<ViewLine> lines)
+void recalc_caret_line(i32 new_wrapped_line, i32 *wrapped_line, i32 *line, ViewLines lines)
 {
     if (new_wrapped_line == 0) {
         *wrapped_line = 0;
@@ -2666,22 +4375,13 @@ void recalc_caret_line(i32 new_wrapped_line, i32 *wrapped_line, i32 *line, Array
     }
 }
 
-void recalc_line_wrap(View *view, DynamicArray<ViewLine> *lines, i32 start_line, i32 end_line, BufferId buffer_id)
+// NOTE(jesper): appends the start of every view line in ]start, end] to lines, wrapping the text to the width
+// of the view. Start must be the start of a buffer line
+void wrap_lines(View *view, Buffer *buffer, i64 start, i64 end, DynamicArray<ViewLine> *lines)
 {
-    Buffer *buffer = get_buffer(buffer_id);
-    if (!buffer) return;
-
-    SArena scratch = tl_scratch_arena(lines->alloc);
-
     Rect r = view->rect;
     f32 base_x = r.tl.x;
 
-    start_line = MAX(start_line, 0);
-    end_line = MIN(end_line, lines->count);
-
-    i64 start = line_start_offset(start_line, *lines);
-    i64 end = line_end_offset(end_line, *lines, buffer);
-
     i32 prev_c = ' ';
     i64 vcolumn = 0;
 
@@ -2689,21 +4389,33 @@ void recalc_line_wrap(View *view, DynamicArray<ViewLine> *lines, i32 start_line,
     i64 word_start = p;
     i64 line_start = p;
 
-    DynamicArray<ViewLine> tmp_lines{ .alloc = scratch };
-    DynamicArray<ViewLine> *new_lines = &tmp_lines;
-
-    if (lines->count == 0 || (start_line == 0 && end_line == lines->count)) {
-        new_lines = lines;
-        lines->count = start_line = end_line = 0;
-        array_add(new_lines, ViewLine{ start, 0 });
-    } else {
-        end_line = MIN(lines->count, end_line+1);
-        start_line = MIN(lines->count, start_line+1);
-
-        if (start_line == lines->count) new_lines = lines;
+    // NOTE(jesper): the last column a character can be placed in without being wrapped
+    i64 wrap_column = -1;
+    if (buffer->line_wrap && app.mono.space_width > 0) {
+        wrap_column = (i64)((r.br.x - base_x) / app.mono.space_width);
+        while (wrap_column >= 0 && base_x + (wrap_column+1) * app.mono.space_width >= r.br.x) wrap_column--;
+        while (base_x + (wrap_column+2) * app.mono.space_width < r.br.x) wrap_column++;
     }
 
     while (p < end) {
+        // NOTE(jesper): runs of ASCII word characters following a word character, or spaces following a space,
+        // don't move the word start and only advance the column, so skip them in bulk up until the wrap column
+        if (prev_c == ' ' || (prev_c >= 0 && prev_c < 128 && (char_class_table[prev_c] & CHAR_WORD))) {
+            i64 run_end = end;
+            u8 char_class = CHAR_SPACE;
+            if (prev_c != ' ') {
+                char_class = CHAR_WORD;
+                if (buffer->line_wrap) run_end = MIN(end, p + wrap_column - vcolumn + 1);
+            }
+
+            i64 skipped = buffer_skip_class(buffer, p, run_end, char_class);
+            if (skipped > p) {
+                vcolumn += skipped-p;
+                p = skipped;
+                continue;
+            }
+        }
+
         i64 pn = p;
         i32 c = utf32_it_next(buffer, &p);
 
@@ -2723,7 +4435,7 @@ void recalc_line_wrap(View *view, DynamicArray<ViewLine> *lines, i32 start_line,
             }
 
             line_start = word_start = p;
-            array_add(new_lines, { line_start, 0 });
+            array_add(lines, { line_start, 0 });
 
             vcolumn = 0;
             continue;
@@ -2741,7 +4453,7 @@ void recalc_line_wrap(View *view, DynamicArray<ViewLine> *lines, i32 start_line,
         }
 
         f32 x1 = base_x + (vcolumn+1) * app.mono.space_width;
-        if (x1 >= r.br.x) {
+        if (buffer->line_wrap && x1 >= r.br.x) {
             if (!is_word_boundary(c) && line_start != word_start) {
                 p = line_start = word_start;
             } else {
@@ -2749,35 +4461,391 @@ void recalc_line_wrap(View *view, DynamicArray<ViewLine> *lines, i32 start_line,
             }
             vcolumn = 0;
 
-            array_add(new_lines, { (i64)line_start, .wrapped = true });
+            array_add(lines, { (i64)line_start, .wrapped = true });
         }
 
         vcolumn++;
     }
+}
 
-    if (new_lines != lines) {
-        if (end != buffer_end(buffer) && new_lines->at(new_lines->count-1).offset == end) new_lines->count--;
+struct WrapJob {
+    View *view;
+    i64 start, end;
 
-#if DEBUG_LINE_WRAP_RECALC
-        LOG_INFO("start line: %d, end line: %d, start offset: %lld, end offset: %lld", start_line, end_line, start, end);
-        for (i32 i = MAX(0, start_line-5); i < MIN(end_line+5, lines->count); i++) {
-            LOG_RAW("\t existing line[%d]: %lld, wrapped: %d\n", i, lines->at(i).offset, lines->at(i).wrapped);
+    // NOTE(jesper): shallow copies of the buffer and its piece table, so that each job has its own piece
+    // lookup cache. The buffer isn't modified while the jobs are running
+    Buffer buffer;
+    PieceTable piece;
+
+    DynamicArray<ViewLine> lines;
+};
+
+void wrap_job(void *data)
+{
+    WrapJob *job = (WrapJob*)data;
+    wrap_lines(job->view, &job->buffer, job->start, job->end, &job->lines);
+}
+
+// NOTE(jesper): wraps ]start, end] in chunks split at the buffer lines, on the job pool and the calling
+// thread, and appends the concatenated view lines
+void wrap_lines_parallel(View *view, Buffer *buffer, i64 start, i64 end, DynamicArray<ViewLine> *lines)
+{
+    SArena scratch = tl_scratch_arena(lines->alloc);
+
+    JobPool *pool = get_job_pool();
+    i32 chunk_count = MIN((end-start) / WRAP_CHUNK_MIN_BYTES, MIN(pool->thread_count+1, WRAP_MAX_CHUNKS));
+    DynamicArray<WrapJob> jobs{ .alloc = scratch };
+
+    i64 chunk_start = start;
+    for (i32 i = 1; i <= chunk_count && chunk_start < end; i++) {
+        i64 chunk_end = end;
+        if (i < chunk_count) {
+            i32 line = line_from_offset(&buffer->line_index, start + (end-start) * i / chunk_count);
+            chunk_end = MIN(line_start(&buffer->line_index, line+1), end);
         }
+        if (chunk_end <= chunk_start) continue;
 
-        LOG_INFO("replacing lines [%d, %d[ with %d lines:", start_line, end_line, new_lines->count);
-        for (i32 i = 0; i < new_lines->count; i++) {
-            LOG_RAW("\t new line[%d]: %lld, wrapped: %d\n", i, new_lines->at(i).offset, new_lines->at(i).wrapped);
+        WrapJob job{ .view = view, .start = chunk_start, .end = chunk_end, .buffer = *buffer };
+        job.lines.alloc = mem_dynamic;
+        if (buffer->type == BUFFER_PIECE) {
+            job.piece = *buffer->piece;
+            job.piece.cache = {};
         }
+
+        array_add(&jobs, job);
+        chunk_start = chunk_end;
+    }
+
+    // NOTE(jesper): the piece table copies are pointed at once the jobs are at their final address
+    DynamicArray<Job> graph{ .alloc = scratch };
+    for (WrapJob &job : jobs) {
+        if (buffer->type == BUFFER_PIECE) job.buffer.piece = &job.piece;
+        array_add(&graph, { .proc = wrap_job, .data = &job });
+    }
+
+    run_jobs(graph);
+
+    for (WrapJob &job : jobs) {
+        array_replace(lines, lines->count, lines->count, job.lines);
+        FREE(mem_dynamic, job.lines.data);
+    }
+}
+
+// NOTE(jesper): appends the view lines of the buffer lines [first, last[
+void wrap_buffer_lines(View *view, Buffer *buffer, i32 first, i32 last, DynamicArray<ViewLine> *lines)
+{
+    if (first >= last) return;
+
+    i32 line_count = line_index_line_count(&buffer->line_index);
+    i64 start = line_start(&buffer->line_index, first);
+    i64 end = last < line_count ? line_start(&buffer->line_index, last) : buffer_end(buffer);
+
+    i32 count = lines->count;
+    array_add(lines, ViewLine{ start, 0 });
+
+    if (end-start >= WRAP_PARALLEL_MIN_BYTES && last-first > 1) wrap_lines_parallel(view, buffer, start, end, lines);
+    else wrap_lines(view, buffer, start, end, lines);
+
+    if (last < line_count && lines->count > count+1 && lines->at(lines->count-1).offset == end) lines->count--;
+}
+
+// NOTE(jesper): updates the line counts after the buffer's line index or the wrapped window changed
+void view_lines_update(ViewLines *lines)
+{
+    Buffer *buffer = get_buffer(lines->buffer);
+    lines->line_count = buffer ? line_index_line_count(&buffer->line_index) : 0;
+
+    if (lines->last > lines->line_count) {
+        view_line_blocks_clear(&lines->wrapped);
+        lines->first = lines->last = 0;
+    }
+
+    lines->count = lines->first + lines->wrapped.count + lines->line_count - lines->last;
+
+    if (!buffer) lines->wrapped_end = 0;
+    else if (lines->last < lines->line_count) lines->wrapped_end = line_start(&buffer->line_index, lines->last);
+    else lines->wrapped_end = buffer_end(buffer);
+}
+
+void view_lines_reset(ViewLines *lines, BufferId buffer)
+{
+    lines->buffer = buffer;
+    view_line_blocks_clear(&lines->wrapped);
+    lines->first = lines->last = 0;
+    view_lines_update(lines);
+}
+
+void recalc_line_wrap(View *view, ViewLines *lines, i32 start_line, i32 end_line)
+{
+    Buffer *buffer = get_buffer(lines->buffer);
+    if (!buffer) return;
+
+    SArena scratch = tl_scratch_arena();
+
+    // NOTE(jesper): only the lines in the wrapped window are stored, everything else is a buffer line
+    start_line = MAX(start_line, lines->first);
+    end_line = MIN(end_line, lines->first + lines->wrapped.count - 1);
+    if (end_line < start_line) return;
+
+    i64 start = line_start_offset(start_line, *lines);
+    i64 end = line_end_offset(end_line, *lines, buffer);
+
+    DynamicArray<ViewLine> new_lines{ .alloc = scratch };
+    wrap_lines(view, buffer, start, end, &new_lines);
+
+    start_line++;
+    end_line++;
+
+    // NOTE(jesper): the line following the range is kept, drop the line we added for its start
+    if (end_line < lines->count && new_lines.count > 0 && new_lines[new_lines.count-1].offset == end) {
+        new_lines.count--;
+    }
+
+#if DEBUG_LINE_WRAP_RECALC
+    LOG_INFO("start line: %d, end line: %d, start offset: %lld, end offset: %lld", start_line, end_line, start, end);
+    for (i32 i = MAX(lines->first, start_line-5); i < MIN(end_line+5, lines->first + lines->wrapped.count); i++) {
+        LOG_RAW("\t existing line[%d]: %lld, wrapped: %d\n", i, (*lines)[i].offset, (*lines)[i].wrapped);
+    }
+
+    LOG_INFO("replacing lines [%d, %d[ with %d lines:", start_line, end_line, new_lines.count);
+    for (i32 i = 0; i < new_lines.count; i++) {
+        LOG_RAW("\t new line[%d]: %lld, wrapped: %d\n", i, new_lines[i].offset, new_lines[i].wrapped);
+    }
 #endif
 
-        array_replace(lines, start_line, end_line, *new_lines);
+    view_line_blocks_replace(&lines->wrapped, start_line - lines->first, end_line - lines->first, new_lines);
+    view_lines_update(lines);
 
 #if DEBUG_LINE_WRAP_RECALC
-        for (i32 i = MAX(0, start_line-5); i < MIN(end_line+5, lines->count); i++) {
-                LOG_RAW("resulting line[%d]: %lld, wrapped: %d\n", i, lines->at(i).offset, lines->at(i).wrapped);
-        }
+    for (i32 i = MAX(lines->first, start_line-5); i < MIN(end_line+5, lines->first + lines->wrapped.count); i++) {
+        LOG_RAW("resulting line[%d]: %lld, wrapped: %d\n", i, (*lines)[i].offset, (*lines)[i].wrapped);
+    }
 #endif
+}
+
+i32 wrapped_line_at_offset(i64 offset, ViewLines lines)
+{
+    if (lines.wrapped.count > 0 && offset >= view_line_get(&lines.wrapped, 0).offset &&
+        (offset < lines.wrapped_end || lines.last == lines.line_count))
+    {
+        return lines.first + view_line_at_offset(&lines.wrapped, offset);
+    }
+
+    Buffer *buffer = get_buffer(lines.buffer);
+    if (!buffer) return 0;
+
+    i32 line = line_from_offset(&buffer->line_index, offset);
+    return line < lines.first ? line : line - (lines.last - lines.first) + lines.wrapped.count;
+}
+
+// NOTE(jesper): moves the view's scroll offset and carets to their new line numbers after the wrapped window changed
+void view_remap_lines(View *view, i64 top)
+{
+    Buffer *buffer = get_buffer(view->buffer);
+    if (!buffer) return;
+
+    view->line_offset = wrapped_line_at_offset(top, view->lines);
+
+    view->caret.wrapped_line = wrapped_line_at_offset(view->caret.byte_offset, view->lines);
+    view->caret.wrapped_column = calc_wrapped_column_from_byte_offset(view->caret.byte_offset, view->caret.wrapped_line, view->lines, buffer);
+
+    view->mark.wrapped_line = wrapped_line_at_offset(view->mark.byte_offset, view->lines);
+    view->mark.wrapped_column = calc_wrapped_column_from_byte_offset(view->mark.byte_offset, view->mark.wrapped_line, view->lines, buffer);
+}
+
+// NOTE(jesper): makes sure the buffer lines around the given view line are wrapped. The wrapped window is
+// extended if they're adjacent to it, up to VIEW_WRAP_MAX_LINES, and replaced otherwise, so that the cost is
+// proportional to the number of visible lines instead of the size of the buffer
+void view_wrap_lines_around(View *view, i32 wrapped_line)
+{
+    Buffer *buffer = get_buffer(view->buffer);
+    if (!buffer || !buffer->line_wrap) return;
+
+    ViewLines *lines = &view->lines;
+    i64 offset = line_start_offset(CLAMP(wrapped_line, 0, lines->count-1), *lines);
+    i32 line = line_from_offset(&buffer->line_index, offset);
+
+    i32 margin = MAX(view->lines_visible, 1);
+    i32 first = MAX(line - margin, 0);
+    i32 last = MIN(line + 2*margin, lines->line_count);
+    if (lines->wrapped.count > 0 && first >= lines->first && last <= lines->last) return;
+
+    i64 top = line_start_offset(view->line_offset, *lines);
+
+    if (lines->wrapped.count > 0 && first <= lines->last && last >= lines->first &&
+        MAX(last, lines->last) - MIN(first, lines->first) <= VIEW_WRAP_MAX_LINES)
+    {
+        SArena scratch = tl_scratch_arena();
+        DynamicArray<ViewLine> new_lines{ .alloc = scratch };
+
+        if (last > lines->last) {
+            wrap_buffer_lines(view, buffer, lines->last, last, &new_lines);
+            view_line_blocks_replace(&lines->wrapped, lines->wrapped.count, lines->wrapped.count, new_lines);
+            lines->last = last;
+        }
+
+        if (first < lines->first) {
+            new_lines.count = 0;
+            wrap_buffer_lines(view, buffer, first, lines->first, &new_lines);
+            view_line_blocks_replace(&lines->wrapped, 0, 0, new_lines);
+            lines->first = first;
+        }
+    } else {
+        SArena scratch = tl_scratch_arena();
+        DynamicArray<ViewLine> new_lines{ .alloc = scratch };
+        wrap_buffer_lines(view, buffer, first, last, &new_lines);
+
+        view_line_blocks_clear(&lines->wrapped);
+        view_line_blocks_replace(&lines->wrapped, 0, 0, new_lines);
+        lines->first = first;
+        lines->last = last;
+    }
+
+    view_lines_update(lines);
+    view_remap_lines(view, top);
+}
+
+// NOTE(jesper): discards the wrapped lines, e.g. when the view was resized, and wraps the lines around the
+// view's scroll offset
+void view_rewrap_lines(View *view)
+{
+    i64 top = line_start_offset(view->line_offset, view->lines);
+
+    view_lines_reset(&view->lines, view->buffer);
+    view->line_offset = wrapped_line_at_offset(top, view->lines);
+    view_wrap_lines_around(view, view->line_offset);
+}
+
+// NOTE(jesper): waits for the GPU to finish drawing the grid from the previous frame, so that its rows can be
+// rewritten
+void glyph_grid_wait(GlyphGrid *grid)
+{
+    gfx_wait_fence(&grid->fence);
+}
+
+void glyph_grid_invalidate(GlyphGrid *grid)
+{
+    for (GlyphGridRow &row : grid->row_state) row.line = -1;
+    grid->source = { .line_offset = -1 };
+}
+
+// NOTE(jesper): invalidates every row if the dimensions of the grid or anything else the rows are encoded from
+// changed. The storage of the SSBO is immutable, so it's recreated if it's too small
+void glyph_grid_prepare(GlyphGrid *grid, i32 columns, i32 rows, BufferId buffer, u32 atlas_generation, u32 fg, i32 tab_width)
+{
+    if (columns*rows > grid->capacity) {
+        glyph_grid_wait(grid);
+        if (grid->ssbo) gfx_destroy_mapped_buffer(grid->ssbo);
+
+        grid->capacity = MAX(columns*rows, grid->capacity*2);
+        i64 size = grid->capacity * sizeof grid->cells[0];
+
+        grid->ssbo = gfx_create_mapped_buffer(size, (void**)&grid->cells);
+        grid->rows = 0;
+    }
+
+    if (columns != grid->columns || rows != grid->rows || buffer != grid->buffer ||
+        atlas_generation != grid->atlas_generation || fg != grid->fg || tab_width != grid->tab_width)
+    {
+        grid->columns = columns;
+        grid->rows = rows;
+        grid->buffer = buffer;
+        grid->atlas_generation = atlas_generation;
+        grid->fg = fg;
+        grid->tab_width = tab_width;
+
+        array_resize(&grid->row_state, rows);
+        glyph_grid_invalidate(grid);
+    }
+}
+
+// NOTE(jesper): invalidates the rows whose bytes were touched by replacing [start, old_end[ with [start, new_end[,
+// and moves the rows following it along. The byte either side is included as it may pair up into a newline
+void glyph_grid_edit(GlyphGrid *grid, i64 start, i64 old_end, i64 new_end)
+{
+    grid->source = { .line_offset = -1 };
+    for (GlyphGridRow &row : grid->row_state) {
+        if (row.line == -1 || row.end < start-1) continue;
+
+        if (row.start > old_end+1) {
+            row.start += new_end - old_end;
+            row.end += new_end - old_end;
+        } else {
+            row.line = -1;
+        }
+    }
+}
+
+// NOTE(jesper): updates the view's lines after [start, old_end[ of its buffer was replaced with
+// [start, new_end[, after the buffer's line index has been updated. Edits outside of the wrapped window
+// are covered by the line index, edits inside of it rewrap only the lines they touched
+void view_splice_lines(View *view, i64 start, i64 old_end, i64 new_end)
+{
+    glyph_grid_edit(&view->glyphs, start, old_end, new_end);
+    if (view->lines_dirty) return;
+
+    ViewLines *lines = &view->lines;
+    Buffer *buffer = get_buffer(lines->buffer);
+    if (!buffer) return;
+
+    i64 delta = new_end - old_end;
+    i32 line_delta = line_index_line_count(&buffer->line_index) - lines->line_count;
+
+    if (lines->wrapped.count == 0 || (start >= lines->wrapped_end && lines->last < lines->line_count)) {
+        view_lines_update(lines);
+        return;
+    }
+
+    i64 wrapped_start = view_line_get(&lines->wrapped, 0).offset;
+    if (old_end < wrapped_start) {
+        lines->first += line_delta;
+        lines->last += line_delta;
+        view_line_blocks_shift(&lines->wrapped, 0, delta);
+        view_lines_update(lines);
+        return;
+    }
+
+    if (start < wrapped_start || (old_end >= lines->wrapped_end && lines->last < lines->line_count)) {
+        // NOTE(jesper): the edit straddles the edge of the wrapped window. Drop it and let the lines around
+        // the scroll offset be wrapped again on the next frame
+        i64 top = line_start_offset(view->line_offset, *lines);
+        if (view->line_offset >= lines->first && view->line_offset < lines->first + lines->wrapped.count) {
+            if (top >= old_end) top += delta;
+            else if (top > start) top = start;
+        }
+
+        view_lines_reset(lines, lines->buffer);
+        view->line_offset = wrapped_line_at_offset(top, *lines);
+        view->caret_dirty = true;
+        return;
+    }
+
+    lines->last += line_delta;
+    view_lines_update(lines);
+
+    // NOTE(jesper): a line's start depends on the two bytes preceding it, as they may form a two-byte newline,
+    // so the edit can change where the lines ending right before it and starting right after it begin
+    i32 first = calc_unwrapped_line(lines->first + view_line_at_offset(&lines->wrapped, MAX(start-1, 0)), *lines);
+    i32 last = lines->first + view_line_at_offset(&lines->wrapped, old_end+1);
+    i32 next = next_unwrapped_line(last, *lines);
+
+    i32 window_end = lines->first + lines->wrapped.count;
+    view_line_blocks_shift(&lines->wrapped, next - lines->first, delta);
+
+    // NOTE(jesper): in a run of alternating \r and \n the edit can change which of the bytes pair up, which
+    // moves every line start that follows within the run
+    while (next < window_end) {
+        i64 offset = (*lines)[next].offset;
+        if (offset < 2) break;
+
+        char c0 = char_at(buffer, offset-2);
+        char c1 = char_at(buffer, offset-1);
+        if (c0 == c1 || (c0 != '\n' && c0 != '\r') || (c1 != '\n' && c1 != '\r')) break;
+
+        next = next_unwrapped_line(next, *lines);
     }
+
+    recalc_line_wrap(view, lines, first, next-1);
 }
 
 bool buffer_remove(BufferId buffer_id, i64 byte_start, i64 byte_end, bool record_history = true)
@@ -2787,62 +4855,70 @@ bool buffer_remove(BufferId buffer_id, i64 byte_start, i64 byte_end, bool record
     Buffer *buffer = get_buffer(buffer_id);
     if (!buffer) return false;
 
+    buffer_make_editable(buffer);
     lsp_notify_change(&app.lsp[buffer->language], buffer->id, byte_start, byte_end, "");
 
-    switch (buffer->type) {
-    case BUFFER_FLAT: {
-        byte_start = MAX(0, byte_start);
-        byte_end = MIN(byte_end, buffer->flat.size);
-
-        i64 num_bytes = byte_end-byte_start;
-        if (record_history) {
-            BufferHistory h{
-                .type = BUFFER_REMOVE,
-                .offset = byte_start,
-                .text = { &buffer->flat.data[byte_start], (i32)num_bytes }
-            };
-            buffer_history(buffer_id, h);
+    byte_start = MAX(0, byte_start);
+    byte_end = MIN(byte_end, buffer_end(buffer));
+
+    i64 num_bytes = byte_end-byte_start;
+    if (record_history) {
+        BufferHistory h{
+            .type = BUFFER_REMOVE,
+            .offset = byte_start,
+        };
+
+        switch (buffer->type) {
+        case BUFFER_FLAT:
+            h.text = { &buffer->flat.data[byte_start], (i32)num_bytes };
+            break;
+        case BUFFER_PIECE:
+            // NOTE(jesper): the removed bytes remain alive in the piece table's original or add blocks,
+            // so reference them directly if they're contiguous instead of copying them
+            h.text = piece_contiguous_range(buffer->piece, byte_start, byte_end);
+            h.text_ref = h.text.length == num_bytes;
+            if (!h.text_ref) {
+                h.text = { ALLOC_ARR(*scratch, char, num_bytes), (i32)num_bytes };
+                piece_read(buffer->piece, byte_start, byte_end, h.text.data);
+            }
+            break;
+        case BUFFER_MAPPED:
+            PANIC("mapped buffers must be made editable before being modified");
+            break;
         }
 
+        buffer_history(buffer_id, h);
+    }
 
+    switch (buffer->type) {
+    case BUFFER_FLAT:
         memmove(&buffer->flat.data[byte_start], &buffer->flat.data[byte_end], buffer->flat.size-byte_end);
         buffer->flat.size -= num_bytes;
+        break;
+    case BUFFER_PIECE:
+        piece_remove(buffer->piece, byte_start, byte_end);
+        break;
+    case BUFFER_MAPPED:
+        PANIC("mapped buffers must be made editable before being modified");
+        break;
+    }
 
-        for (View &view : app.views) {
-            if (view.buffer != buffer_id) continue;
-
-            i32 line = wrapped_line_from_offset(byte_start, view.lines, view.caret.wrapped_line);
-            i64 start_offset = view.lines[line].offset;
-            for (i32 i = line+1; i < view.lines.count; i++) {
-                view.lines[i].offset -= num_bytes;
-
-                if (view.lines[i].offset <= start_offset) array_remove(&view.lines, i--);
-            }
-
-            // TODO(jesper): this looks wrong if removed text contains one or more newlines
-            recalc_line_wrap(
-                &view,
-                &view.lines,
-                prev_unwrapped_line(line, view.lines),
-                next_unwrapped_line(line, view.lines),
-                view.buffer);
-        }
-
-        i32 line = line_from_offset(byte_start, buffer->line_offsets);
-        for (i32 i = line+1; i < buffer->line_offsets.count; i++) {
-            buffer->line_offsets[i] -= num_bytes;
-        }
+    i32 first_line = line_from_offset(&buffer->line_index, byte_start);
+    i32 last_line = line_from_offset(&buffer->line_index, byte_end);
+    highlight_replace_lines(buffer, first_line, last_line-first_line, 0);
 
-        // TODO(jesper): handle removal of newlines
+    line_index_remove(&buffer->line_index, byte_start, byte_end);
+    buffer_line_index_edit(buffer, byte_start, byte_end, byte_start);
 
-        ts_update_buffer(buffer, {
-            .start_byte = (u32)byte_start,
-            .old_end_byte = (u32)byte_end,
-            .new_end_byte = (u32)byte_start,
-        });
-    } break;
+    for (View &view : app.views) {
+        if (view.buffer == buffer_id) view_splice_lines(&view, byte_start, byte_end, byte_start);
     }
 
+    ts_update_buffer(buffer, {
+        .start_byte = (u32)byte_start,
+        .old_end_byte = (u32)byte_end,
+        .new_end_byte = (u32)byte_start,
+    });
 
     return true;
 }
@@ -2852,19 +4928,22 @@ String buffer_read(BufferId buffer_id, i64 byte_start, i64 byte_end, Allocator m
     Buffer *buffer = get_buffer(buffer_id);
     if (!buffer) return {};
 
+    byte_start = MAX(0, byte_start);
+    byte_end = MIN(byte_end, buffer_end(buffer));
+
+    i64 num_bytes = byte_end-byte_start;
+
     String s{};
+    s.length = num_bytes;
+    s.data = ALLOC_ARR(mem, char, s.length);
 
     switch (buffer->type) {
     case BUFFER_FLAT:
-        byte_start = MAX(0, byte_start);
-        byte_end = MIN(byte_end, buffer->flat.size);
-
-        i64 num_bytes = byte_end-byte_start;
-
-        s.length = num_bytes;
-        s.data = ALLOC_ARR(mem, char, s.length);
+    case BUFFER_MAPPED:
         memcpy(s.data, &buffer->flat.data[byte_start], num_bytes);
-
+        break;
+    case BUFFER_PIECE:
+        piece_read(buffer->piece, byte_start, byte_end, s.data);
         break;
     }
 
@@ -2878,6 +4957,7 @@ i64 buffer_seek_forward(BufferId buffer_id, String needle, i64 start)
 
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_MAPPED:
         for (i64 offset = start+1;
              offset < buffer->flat.size && offset + needle.length <= buffer->flat.size;
              offset++)
@@ -2904,6 +4984,31 @@ next0:;
 next1:;
         }
         break;
+    case BUFFER_PIECE:
+        for (i64 offset = start+1;
+             offset < buffer->piece->size && offset + needle.length <= buffer->piece->size;
+             offset++)
+        {
+            for (i32 i = 0; i < needle.length; i++) {
+                if (to_lower(piece_char_at(buffer->piece, offset+i)) != needle[i]) goto next2;
+            }
+
+            return offset;
+next2:;
+        }
+
+        for (i64 offset = 0;
+             offset < start && offset + needle.length <= start && offset + needle.length <= buffer->piece->size;
+             offset++)
+        {
+            for (i32 i = 0; i < needle.length; i++) {
+                if (to_lower(piece_char_at(buffer->piece, offset+i)) != needle[i]) goto next3;
+            }
+
+            return offset;
+next3:;
+        }
+        break;
     }
 
 
@@ -2917,6 +5022,7 @@ i64 buffer_seek_first_forward(BufferId buffer_id, Array<char> chars, i64 start)
 
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_MAPPED:
         for (i64 offset = start+1; offset < buffer->flat.size; offset++)  {
             char c = *(buffer->flat.data+offset);
             for (i32 i = 0; i < chars.count; i++) {
@@ -2931,6 +5037,21 @@ i64 buffer_seek_first_forward(BufferId buffer_id, Array<char> chars, i64 start)
             }
         }
         break;
+    case BUFFER_PIECE:
+        for (i64 offset = start+1; offset < buffer->piece->size; offset++)  {
+            char c = piece_char_at(buffer->piece, offset);
+            for (i32 i = 0; i < chars.count; i++) {
+                if (c == chars[i]) return offset;
+            }
+        }
+
+        for (i64 offset = 0; offset < start; offset++) {
+            char c = piece_char_at(buffer->piece, offset);
+            for (i32 i = 0; i < chars.count; i++) {
+                if (c == chars[i]) return offset;
+            }
+        }
+        break;
     }
 
 
@@ -2944,6 +5065,7 @@ i64 buffer_seek_back(BufferId buffer_id, String needle, i64 start)
 
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_MAPPED:
         for (i64 offset = start-1; offset >= 0; offset--) {
             char *p = buffer->flat.data+offset;
             for (i32 i = 0; i < needle.length; i++) {
@@ -2961,7 +5083,27 @@ next0:;
             }
 
             return offset;
-next1:;
+next1:;
+        }
+
+        break;
+    case BUFFER_PIECE:
+        for (i64 offset = start-1; offset >= 0; offset--) {
+            for (i32 i = 0; i < needle.length; i++) {
+                if (to_lower(piece_char_at(buffer->piece, offset+i)) != needle[i]) goto next2;
+            }
+
+            return offset;
+next2:;
+        }
+
+        for (i64 offset = buffer->piece->size-1; offset > start; offset--) {
+            for (i32 i = 0; i < needle.length; i++) {
+                if (to_lower(piece_char_at(buffer->piece, offset+i)) != needle[i]) goto next3;
+            }
+
+            return offset;
+next3:;
         }
 
         break;
@@ -2978,6 +5120,7 @@ i64 buffer_seek_first_back(BufferId buffer_id, Array<char> chars, i64 start)
 
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_MAPPED:
         for (i64 offset = start-1; offset >= 0; offset--) {
             char c = *(buffer->flat.data+offset);
             for (i32 i = 0; i < chars.count; i++) {
@@ -2992,6 +5135,21 @@ i64 buffer_seek_first_back(BufferId buffer_id, Array<char> chars, i64 start)
             }
         }
         break;
+    case BUFFER_PIECE:
+        for (i64 offset = start-1; offset >= 0; offset--) {
+            char c = piece_char_at(buffer->piece, offset);
+            for (i32 i = 0; i < chars.count; i++) {
+                if (c == chars[i]) return offset;
+            }
+        }
+
+        for (i64 offset = buffer->piece->size-1; offset > start; offset--) {
+            char c = piece_char_at(buffer->piece, offset);
+            for (i32 i = 0; i < chars.count; i++) {
+                if (c == chars[i]) return offset;
+            }
+        }
+        break;
     }
 
 
@@ -3010,6 +5168,8 @@ i64 buffer_seek_first_back(BufferId buffer_id, std::initializer_list<char> chars
 
 void buffer_save(BufferId buffer_id)
 {
+    SArena scratch = tl_scratch_arena();
+
     Buffer *buffer = get_buffer(buffer_id);
     if (!buffer) return;
 
@@ -3017,14 +5177,47 @@ void buffer_save(BufferId buffer_id)
 
     lsp_notify_will_save(&app.lsp[buffer->language], buffer_id, LSP_SAVE_REASON_MANUAL);
 
-    FileHandle f = open_file(buffer->file_path, FILE_OPEN_TRUNCATE);
+    // NOTE(jesper): buffers backed by a file mapping reference the file's contents, so we can't truncate
+    // and write to it in place. Write to a temporary file instead and replace the original with it
+    String path = buffer->file_path;
+    bool replace = buffer->mapping.data != nullptr;
+    if (replace) {
+        String ext = ".save";
+
+        path.length = buffer->file_path.length + ext.length;
+        path.data = ALLOC_ARR(*scratch, char, path.length);
+        memcpy(path.data, buffer->file_path.data, buffer->file_path.length);
+        memcpy(path.data+buffer->file_path.length, ext.data, ext.length);
+    }
+
+    FileHandle f = open_file(path, FILE_OPEN_TRUNCATE);
     switch (buffer->type) {
     case BUFFER_FLAT:
+    case BUFFER_MAPPED:
         write_file(f, buffer->flat.data, buffer->flat.size);
         break;
+    case BUFFER_PIECE:
+        for (i64 offset = 0; offset < buffer->piece->size;) {
+            String chunk = piece_chunk_at(buffer->piece, offset);
+            write_file(f, chunk.data, chunk.length);
+            offset += chunk.length;
+        }
+        break;
     }
     close_file(f);
 
+#ifdef _WIN32
+    // NOTE(jesper): a file with an open mapping can't be replaced on windows, and neither can one the line index job
+    // has open. The saved file has the buffer's contents, so the buffer is moved onto a mapping of it instead,
+    // which is renamed over the original
+    if (replace) {
+        buffer_wait_line_index(buffer);
+        if (!buffer_remap_file(buffer, path)) return;
+    }
+#endif
+
+    if (replace && !replace_file(buffer->file_path, path)) return;
+
     buffer->saved_at = buffer->history_index;
     lsp_notify_did_save(&app.lsp[buffer->language], buffer_id);
 }
@@ -3052,6 +5245,8 @@ i64 buffer_insert(BufferId buffer_id, i64 offset, String in_text, bool record_hi
     Buffer *buffer = get_buffer(buffer_id);
     if (!buffer) return offset;
 
+    buffer_make_editable(buffer);
+
     i64 end_offset = offset;
     String nl = buffer_newline_str(buffer);
 
@@ -3090,10 +5285,14 @@ i64 buffer_insert(BufferId buffer_id, i64 offset, String in_text, bool record_hi
 
     lsp_notify_change(&app.lsp[buffer->language], buffer->id, offset, offset, text);
 
+    // NOTE(jesper): the text we record in the history. For piece buffers this references the table's
+    // add blocks directly instead of being copied
+    String history_text = text;
+
     switch (buffer->type) {
-    case BUFFER_FLAT: {
+    case BUFFER_FLAT:
         if (buffer->flat.size + text.length > buffer->flat.capacity) {
-            i64 new_capacity = buffer->flat.size + text.length;
+            i64 new_capacity = MAX(buffer->flat.size + text.length, buffer->flat.capacity*3/2);
             buffer->flat.data = (char*)REALLOC(mem_dynamic, buffer->flat.data, buffer->flat.capacity, new_capacity);
             buffer->flat.capacity = new_capacity;
         }
@@ -3101,42 +5300,38 @@ i64 buffer_insert(BufferId buffer_id, i64 offset, String in_text, bool record_hi
         memmove(buffer->flat.data+offset+text.length, buffer->flat.data+offset, buffer->flat.size-offset);
         memcpy(buffer->flat.data+offset, text.data, text.length);
         buffer->flat.size += required_extra_space;
-        end_offset += required_extra_space;
-
-        for (View &view : app.views) {
-            if (view.buffer != buffer_id) continue;
-
-            i32 line = wrapped_line_from_offset(offset, view.lines, view.caret.wrapped_line);
-            for (i32 i = line+1; i < view.lines.count; i++) {
-                view.lines[i].offset += required_extra_space;
-            }
-
-            // TODO(jesper): this looks wrong if the inserted text contains 1 or more newlines
-            recalc_line_wrap(
-                &view,
-                &view.lines,
-                calc_unwrapped_line(line, view.lines),
-                next_unwrapped_line(line, view.lines),
-                view.buffer);
-        }
+        break;
+    case BUFFER_PIECE:
+        history_text = piece_insert(buffer->piece, offset, text);
+        break;
+    case BUFFER_MAPPED:
+        PANIC("mapped buffers must be made editable before being modified");
+        break;
+    }
 
-        i32 line = line_from_offset(offset, buffer->line_offsets);
-        for (i32 i = line+1; i < buffer->line_offsets.count; i++) {
-            buffer->line_offsets[i] += required_extra_space;
-        }
+    end_offset += required_extra_space;
 
-        // TODO(jesper): handle newlines
+    highlight_replace_lines(buffer, line_from_offset(&buffer->line_index, offset), 0, newline_count);
+    line_index_insert(&buffer->line_index, offset, text);
+    buffer_line_index_edit(buffer, offset, offset, offset+text.length);
 
-        ts_update_buffer(buffer, {
-            .start_byte = (u32)offset,
-            .old_end_byte = (u32)offset,
-            .new_end_byte = (u32)(offset+required_extra_space),
-        });
-    } break;
+    for (View &view : app.views) {
+        if (view.buffer == buffer_id) view_splice_lines(&view, offset, offset, offset+required_extra_space);
     }
 
+    ts_update_buffer(buffer, {
+        .start_byte = (u32)offset,
+        .old_end_byte = (u32)offset,
+        .new_end_byte = (u32)(offset+required_extra_space),
+    });
+
     if (record_history) {
-        buffer_history(buffer_id, { .type = BUFFER_INSERT, .offset = offset, .text = text });
+        buffer_history(buffer_id, {
+            .type = BUFFER_INSERT,
+            .offset = offset,
+            .text = history_text,
+            .text_ref = buffer->type == BUFFER_PIECE,
+        });
     }
 
     return end_offset;
@@ -3224,7 +5419,7 @@ void buffer_redo(BufferId buffer_id)
     }
 }
 
-bool line_is_empty_or_whitespace(BufferId buffer_id, Array<ViewLine> lines, i32 wrapped_line)
+bool line_is_empty_or_whitespace(BufferId buffer_id, ViewLines lines, i32 wrapped_line)
 {
     Buffer *buffer = get_buffer(buffer_id);
     ASSERT(buffer);
@@ -3241,14 +5436,14 @@ bool line_is_empty_or_whitespace(BufferId buffer_id, Array<ViewLine> lines, i32
     return true;
 }
 
-i32 seek_non_empty_line_back(BufferId buffer_id, Array<ViewLine> lines, i32 start_line)
+i32 seek_non_empty_line_back(BufferId buffer_id, ViewLines lines, i32 start_line)
 {
     i32 line = start_line;
     while (line > 0 && (lines[line].wrapped || line_is_empty_or_whitespace(buffer_id, lines, line))) line--;
     return line;
 }
 
-i32 buffer_seek_next_empty_line(BufferId buffer_id, Array<ViewLine> lines, i32 wrapped_line)
+i32 buffer_seek_next_empty_line(BufferId buffer_id, ViewLines lines, i32 wrapped_line)
 {
     if (wrapped_line >= lines.count-1) return wrapped_line;
     bool had_non_empty = !line_is_empty_or_whitespace(buffer_id, lines, wrapped_line);
@@ -3264,7 +5459,7 @@ i32 buffer_seek_next_empty_line(BufferId buffer_id, Array<ViewLine> lines, i32 w
     return MIN(line, lines.count-1);
 }
 
-i32 buffer_seek_prev_empty_line(BufferId buffer_id, Array<ViewLine> lines, i32 wrapped_line)
+i32 buffer_seek_prev_empty_line(BufferId buffer_id, ViewLines lines, i32 wrapped_line)
 {
     if (wrapped_line <= 1) return 0;
     bool had_non_empty = !line_is_empty_or_whitespace(buffer_id, lines, wrapped_line);
@@ -3286,22 +5481,37 @@ i64 buffer_seek_next_word(BufferId buffer_id, i64 byte_offset)
     if (!buffer) return byte_offset;
 
     switch (buffer->type) {
-    case BUFFER_FLAT: {
+    case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED: {
             i64 offset = byte_offset;
             i64 end = buffer_end(buffer_id);
 
             if (byte_offset >= end) return end;
 
-            char *p = &buffer->flat.data[0];
-
-            char start_c = p[offset++];
+            char start_c = char_at(buffer, offset++);
             bool start_is_whitespace = is_whitespace(start_c);
             bool start_is_boundary = !start_is_whitespace && is_word_boundary(start_c);
             bool in_whitespace = start_is_whitespace;
             bool was_cr = start_c == '\r';
 
             for (; offset < end; offset++) {
-                char c = buffer->flat.data[offset];
+                // NOTE(jesper): runs of spaces, and of word characters while still in the starting word,
+                // can't end the motion
+                i64 run_end = buffer_skip_class(buffer, offset, end, CHAR_SPACE);
+                if (run_end > offset) {
+                    in_whitespace = true;
+                } else if (!start_is_boundary && !in_whitespace) {
+                    run_end = buffer_skip_class(buffer, offset, end, CHAR_WORD);
+                }
+
+                if (run_end > offset) {
+                    was_cr = false;
+                    offset = run_end-1;
+                    continue;
+                }
+
+                char c = char_at(buffer, offset);
 
                 bool whitespace = is_whitespace(c);
                 bool boundary = !whitespace && is_word_boundary(c);
@@ -3333,7 +5543,7 @@ i64 buffer_seek_next_word(BufferId buffer_id, i64 byte_offset)
     return byte_offset;
 }
 
-i64 buffer_seek_beginning_of_line(BufferId buffer_id, Array<ViewLine> lines, i32 line)
+i64 buffer_seek_beginning_of_line(BufferId buffer_id, ViewLines lines, i32 line)
 {
     if (line >= lines.count) return 0;
 
@@ -3356,7 +5566,7 @@ i64 buffer_seek_beginning_of_line(BufferId buffer_id, Array<ViewLine> lines, i32
     return start;
 }
 
-i64 buffer_seek_end_of_line(BufferId buffer_id, Array<ViewLine> lines, i32 line)
+i64 buffer_seek_end_of_line(BufferId buffer_id, ViewLines lines, i32 line)
 {
     if (line >= lines.count) return 0;
 
@@ -3380,13 +5590,13 @@ i64 buffer_seek_prev_word(BufferId buffer_id, i64 byte_offset)
     if (!buffer) return byte_offset;
 
     switch (buffer->type) {
-    case BUFFER_FLAT: {
+    case BUFFER_FLAT:
+    case BUFFER_PIECE:
+    case BUFFER_MAPPED: {
         i64 offset = byte_offset;
         i64 end = buffer_end(buffer_id);
 
-        char *p = &buffer->flat.data[0];
-
-        char start_c = p[offset--];
+        char start_c = char_at(buffer, offset--);
         bool start_is_whitespace = is_whitespace(start_c);
         bool start_is_boundary = !start_is_whitespace && is_word_boundary(start_c);
         bool start_is_normal = !start_is_boundary && !start_is_whitespace;
@@ -3396,7 +5606,25 @@ i64 buffer_seek_prev_word(BufferId buffer_id, i64 byte_offset)
         bool was_ln = start_c == '\n';
 
         for (; offset >= 0; offset--) {
-            char c = p[offset];
+            // NOTE(jesper): runs of word characters, and of spaces following whitespace, can't end the motion
+            i64 run_start = buffer_skip_class_back(buffer, offset+1, 0, CHAR_WORD);
+            if (run_start <= offset) {
+                was_whitespace = was_ln = false;
+                offset = run_start;
+                continue;
+            }
+
+            if (was_whitespace) {
+                run_start = buffer_skip_class_back(buffer, offset+1, 0, CHAR_SPACE);
+                if (run_start <= offset) {
+                    has_whitespace = true;
+                    was_ln = false;
+                    offset = run_start;
+                    continue;
+                }
+            }
+
+            char c = char_at(buffer, offset);
             bool whitespace = is_whitespace(c);
             bool boundary = !whitespace && is_word_boundary(c);
 
@@ -3441,7 +5669,7 @@ i64 buffer_seek_prev_word(BufferId buffer_id, i64 byte_offset)
     return byte_offset;
 }
 
-String get_indent_for_line(BufferId buffer_id, Array<ViewLine> lines, i32 line, Allocator mem)
+String get_indent_for_line(BufferId buffer_id, ViewLines lines, i32 line, Allocator mem)
 {
     line = seek_non_empty_line_back(buffer_id, lines, line);
     i64 line_start = buffer_seek_beginning_of_line(buffer_id, lines, line);
@@ -3452,37 +5680,38 @@ String get_indent_for_line(BufferId buffer_id, Array<ViewLine> lines, i32 line,
 
 bool app_needs_render()
 {
-    if (app.next_mode != app.mode || app.animating) return true;
-    for (View &view : app.views) if (view.lines_dirty || view.caret_dirty) return true;
+    // NOTE(jesper): animating keeps rendering while in text input, but there's no point in waking up again if
+    // the last frame didn't differ from the one before it
+    if (app.next_mode != app.mode || (app.animating && !app.damage.idle)) return true;
+    if (gui_needs_redraw()) return true;
+
+    // NOTE(jesper): the frame stream dropped geometry that didn't fit, so the frame has to be drawn again once it's
+    // grown. The GUI and views redraw their own draw lists when those overflow
+    if (gfx.frame_vertices.overflowed) return true;
+
+    for (View &view : app.views) if (view.lines_dirty || view.caret_dirty || view.draw_dirty) return true;
+    for (View &view : app.views) if (view.glyphs.atlas_generation != app.mono.generation) return true;
+    for (Buffer &buffer : buffers) if (buffer.line_index_job) return true;
+    if (font_glyphs_pending()) return true;
+    for (Buffer &buffer : buffers) if (buffer.syntax_worker && buffer.syntax_version < buffer.version) return true;
     return false;
 }
 
-Caret recalculate_caret(Caret caret, BufferId buffer_id, Array<ViewLine> lines)
+Caret recalculate_caret(Caret caret, BufferId buffer_id, ViewLines lines)
 {
     Buffer *buffer = get_buffer(buffer_id);
     if (!buffer) return caret;
 
-    if (caret.byte_offset == 0) caret.wrapped_line = caret.line = 0;
+    if (caret.byte_offset == 0) caret.wrapped_line = 0;
     else if (caret.byte_offset >= buffer_end(buffer_id)) {
         caret.byte_offset = buffer_end(buffer_id);
-        recalc_caret_line(lines.count-1, &caret.wrapped_line, &caret.line, lines);
+        caret.wrapped_line = lines.count-1;
     } else {
-        caret.wrapped_line = MIN(caret.wrapped_line, lines.count-1);
-        caret.wrapped_line = MAX(0, caret.wrapped_line);
-
-        while (caret.wrapped_line > 0 &&
-               caret.byte_offset < lines[caret.wrapped_line].offset)
-        {
-            if (!lines[caret.wrapped_line--].wrapped) caret.line--;
-        }
-
-        while (caret.wrapped_line < lines.count-1 &&
-               caret.byte_offset >= line_end_offset(caret.wrapped_line, lines, buffer))
-        {
-            if (!lines[++caret.wrapped_line].wrapped) caret.line++;
-        }
+        caret.wrapped_line = wrapped_line_at_offset(caret.byte_offset, lines);
     }
 
+    caret.line = line_from_offset(&buffer->line_index, caret.byte_offset);
+
     caret.wrapped_column = calc_wrapped_column_from_byte_offset(caret.byte_offset, caret.wrapped_line, lines, buffer);
     caret.column = calc_unwrapped_column(caret.wrapped_line, caret.wrapped_column, lines, buffer);
     caret.preferred_column = caret.wrapped_column;
@@ -3527,19 +5756,11 @@ void view_seek_line(View *view, i32 wrapped_line)
 
     wrapped_line = CLAMP(wrapped_line, 0, view->lines.count-1);
     if (buffer && wrapped_line != view->caret.wrapped_line) {
-        i32 l = CLAMP(view->caret.wrapped_line, 0, view->lines.count-1);
-        while (l > 0 && l > wrapped_line) {
-            if (!view->lines[l--].wrapped) view->caret.line--;
-        }
-
-        while (l < view->lines.count-1 && l < wrapped_line) {
-            if (!view->lines[++l].wrapped) view->caret.line++;
-        }
-
-        view->caret.wrapped_line = l;
+        view->caret.wrapped_line = wrapped_line;
         view->caret.wrapped_column = calc_wrapped_column(view->caret.wrapped_line, view->caret.preferred_column, view->lines, buffer);
         view->caret.column = calc_unwrapped_column(view->caret.wrapped_line, view->caret.wrapped_column, view->lines, buffer);
         view->caret.byte_offset = calc_byte_offset(view->caret.wrapped_column, view->caret.wrapped_line, view->lines, buffer);
+        view->caret.line = line_from_offset(&buffer->line_index, view->caret.byte_offset);
 
         move_view_to_caret(view);
 
@@ -3632,13 +5853,12 @@ void app_gather_input(AppWindow *wnd) INTERNAL
 
         switch (event.type) {
         case WE_QUIT:
+            shutdown_job_pool();
             exit(0);
             break;
 
         case WE_RESIZE:
             if (app_change_resolution({ (f32)event.resize.width, (f32)event.resize.height })) {
-                glViewport(0, 0, event.resize.width, event.resize.height);
-
                 // TODO(jesper): I don't really understand why I can't just set this to true
                 // and let the main loop handle it. It appears as if we get stuck in WM_SIZE message
                 // loop until you stop resizing
@@ -3648,8 +5868,7 @@ void app_gather_input(AppWindow *wnd) INTERNAL
                 // points or something that can be used for local reset of the allocators
                 RESET_ALLOC(mem_frame);
 
-                update_and_render();
-                present_window(wnd);
+                if (update_and_render()) present_window(wnd);
             }
             break;
 
@@ -4041,6 +6260,9 @@ void app_gather_input(AppWindow *wnd) INTERNAL
     if (get_input_edge(UNDO, app.input.edit)) buffer_undo(view->buffer);
     if (get_input_edge(REDO, app.input.edit)) buffer_redo(view->buffer);
 
+    if (get_input_edge(ZOOM_IN, app.input.edit)) app_zoom_mono_font(MONO_FONT_ZOOM_STEP);
+    if (get_input_edge(ZOOM_OUT, app.input.edit)) app_zoom_mono_font(-MONO_FONT_ZOOM_STEP);
+
     if (get_input_edge(PASTE, app.input.edit)) {
         write_string(view, view->buffer, read_clipboard_str(scratch), VIEW_SET_MARK);
     }
@@ -4085,7 +6307,6 @@ void app_gather_input(AppWindow *wnd) INTERNAL
                 if (!buffer) buffer = create_buffer(path);
                 view_set_buffer(app.current_view, buffer);
 
-
             }
         }
     }
@@ -4107,9 +6328,353 @@ void app_gather_input(AppWindow *wnd) INTERNAL
     }
 }
 
-void update_and_render() INTERNAL
+ViewDrawSource view_draw_source(View *view)
+{
+    Rect rect = view->text_rect;
+    return {
+        .x0 = rect.tl.x, .y0 = rect.tl.y,
+        .x1 = rect.br.x, .y1 = rect.br.y,
+        .voffset = view->voffset,
+        .line_offset = view->line_offset,
+        .lines_visible = view->lines_visible,
+        .caret_line = view->caret.wrapped_line,
+        .mark_line = view->mark.wrapped_line,
+        .caret_column = view->caret.wrapped_column,
+        .mark_column = view->mark.wrapped_column,
+        .glyph_atlas = app.mono.texture,
+        .glyph_ssbo = view->glyphs.ssbo,
+        .cell_width = app.mono.space_width,
+        .cell_height = app.mono.line_height,
+        .atlas_cell_width = app.mono.raster.space_width,
+        .atlas_cell_height = app.mono.raster.line_height,
+        .sdf_width = font_sdf_width(&app.mono),
+        .columns = view->glyphs.columns,
+        .rows = view->glyphs.rows,
+        .has_buffer = get_buffer(view->buffer) != nullptr,
+    };
+}
+
+// NOTE(jesper): records the view's caret, mark, and text into its draw list
+void view_record_draw_list(View *view)
+{
+    gui_begin_draw_list(&view->draw);
+
+    // draw caret
+    if (view->caret.wrapped_line >= view->line_offset &&
+        view->caret.wrapped_line < view->line_offset + view->lines_visible)
+    {
+        Rect rect = view->text_rect;
+        i32 y = view->caret.wrapped_line - view->line_offset;
+        f32 w = app.mono.space_width;
+        f32 h = app.mono.line_height+1;
+
+        Vector2 p0{
+            rect.tl.x + view->caret.wrapped_column*app.mono.space_width,
+            rect.tl.y + y*app.mono.line_height - view->voffset,
+        };
+        Vector2 p1{ p0.x, p0.y + h };
+
+        gui_draw_rect({ rect.tl.x, p0.y }, { rect.size().x, h }, app.line_bg);
+
+        gui_draw_rect(p0, { w, h }, app.caret_bg);
+        gui_draw_rect(p0, { 1.0f, h }, app.caret_fg);
+        gui_draw_rect(p0, { w, 1.0f }, app.caret_fg);
+        gui_draw_rect(p1, { w, 1.0f }, app.caret_fg);
+    }
+
+    // draw caret anchor
+    if (view->mark.wrapped_line >= view->line_offset &&
+        view->mark.wrapped_line < view->line_offset + view->lines_visible)
+    {
+        Rect rect = view->text_rect;
+        i32 y = view->mark.wrapped_line - view->line_offset;
+        f32 w = app.mono.space_width/2;
+        f32 h = app.mono.line_height - 1.0f;
+
+        Vector2 p0{
+            rect.tl.x + view->mark.wrapped_column*app.mono.space_width,
+            rect.tl.y + y*app.mono.line_height - view->voffset + 1,
+        };
+        Vector2 p1{ p0.x, p0.y + h };
+
+        gui_draw_rect(p0, { 1.0f, h }, app.mark_fg);
+        gui_draw_rect(p0, { w, 1.0f }, app.mark_fg);
+        gui_draw_rect(p1, { w, 1.0f }, app.mark_fg);
+    }
+
+    gui_end_draw_list();
+
+    if (Buffer *buffer = get_buffer(view->buffer); buffer) {
+        FontAtlas *font = &app.mono;
+        GlyphGrid *grid = &view->glyphs;
+
+        Rect rect = view->text_rect;
+
+        GfxCommand cmd{
+            .type = GFX_COMMAND_MONO_TEXT,
+            .mono_text = {
+                .vbo             = view->draw.vertices->vbo,
+                .vbo_offset      = view->draw.vertices->count,
+                .glyph_ssbo      = grid->ssbo,
+                .fence           = &grid->fence,
+                .glyph_atlas     = font->texture,
+                .cell_size       = { app.mono.space_width, app.mono.line_height },
+                .atlas_cell_size = { font->raster.space_width, font->raster.line_height },
+                .sdf_width       = font_sdf_width(font),
+                .pos             = rect.tl,
+                .offset          = view->voffset,
+                .line_offset     = view->line_offset,
+                .columns         = grid->columns,
+                .rows            = grid->rows,
+            }
+        };
+
+        f32 vertices[] = {
+            rect.br.x, rect.tl.y,
+            rect.tl.x, rect.tl.y,
+            rect.tl.x, rect.br.y,
+            rect.tl.x, rect.br.y,
+            rect.br.x, rect.br.y,
+            rect.br.x, rect.tl.y,
+        };
+
+        if (gfx_stream_add(view->draw.vertices, vertices, ARRAY_COUNT(vertices)) >= 0) {
+            gfx_push_command(cmd, &view->draw.commands);
+        }
+    }
+}
+
+// NOTE(jesper): encodes the rows of a view's glyph grid that are out of date. The highlight query and the row
+// encoding run on the job pool, one job per view. Looking the glyphs up in the atlas can grow or clear its
+// texture, so the job leaves the codepoints in its own copy of the rows and they're resolved on the main thread
+struct ViewGlyphsJob {
+    View *view;
+    Buffer *buffer;
+
+    // NOTE(jesper): shallow copies of the buffer and its piece table for reading the text, like the wrap jobs.
+    // The highlight cache is only touched through the buffer itself, which the views of a buffer take turns at
+    Buffer text;
+    PieceTable piece;
+
+    i32 columns, rows;
+    u32 fg;
+
+    DynamicArray<RangeColor> colors;
+    DynamicArray<GlyphCell> cells;
+    DynamicArray<i32> written_rows;
+};
+
+void view_glyphs_job(void *data)
+{
+    ViewGlyphsJob *job = (ViewGlyphsJob*)data;
+    View *view = job->view;
+    Buffer *buffer = &job->text;
+    GlyphGrid *grid = &view->glyphs;
+
+    i32 columns = job->columns;
+    i32 rows = job->rows;
+
+    i64 byte_start = line_start_offset(view->line_offset, view->lines);
+    i64 byte_end = line_end_offset(view->line_offset+rows, view->lines, buffer);
+
+    if (DEBUG_TREE_SITTER_COLORS) LOG_INFO("-- highlight query start --");
+
+#if DEBUG_TREE_SITTER_COLORS
+    String l = string_from_enum(buffer->language);
+    LOG_INFO("highlight colors for language '%.*s'", STRFMT(l));
+#endif
+    DynamicArray<RangeColor> &colors = job->colors;
+    if (buffer->syntax_degraded) fallback_highlight(&colors, buffer, byte_start, byte_end);
+    else buffer_highlight_lines(&colors, job->buffer, byte_start, byte_end);
+
+    if (DEBUG_TREE_SITTER_COLORS) for (auto c : colors) LOG_INFO("color range [%d, %d]", c.start, c.end);
+
+    i32 current_color = 0;
+    for (i32 line_index = view->line_offset; line_index < view->line_offset+rows; line_index++) {
+        GlyphGridRow state{ .line = line_index, .start = -1, .end = -1, .colors_hash = MURMUR3_SEED };
+        if (line_index < view->lines.count) {
+            state.start = view->lines[line_index].offset;
+            state.end = line_end_offset(line_index, view->lines, buffer);
+        }
+
+        while (current_color < colors.count && colors[current_color].end <= state.start) current_color++;
+        for (i32 i = current_color; i < colors.count && colors[i].start < state.end; i++) {
+            state.colors_hash = hash32((i32)(colors[i].start - state.start), state.colors_hash);
+            state.colors_hash = hash32((i32)(colors[i].end - state.start), state.colors_hash);
+            state.colors_hash = hash32((i32)colors[i].color, state.colors_hash);
+        }
+
+        GlyphGridRow *row = &grid->row_state[line_index % rows];
+        if (row->line == state.line && row->start == state.start && row->end == state.end &&
+            row->colors_hash == state.colors_hash)
+        {
+            continue;
+        }
+
+        *row = state;
+        array_add(&job->written_rows, line_index % rows);
+
+        i32 base = job->cells.count;
+        array_resize(&job->cells, base + columns);
+
+        GlyphCell *cells = &job->cells[base];
+        for (i32 i = 0; i < columns; i++) cells[i] = { .glyph_index = 0xFFFFFFFF, .fg = job->fg };
+
+        i32 color = current_color;
+        i64 p = state.start;
+        i64 end = state.end;
+
+        i64 vcolumn = 0;
+        while (p < end && vcolumn < columns) {
+            i64 pc = p;
+            i32 c = utf32_it_next(buffer, &p);
+            if (c == 0) break;
+
+            if (c == '\n' || c == '\r') {
+                if (p < end && c == '\n' && char_at(buffer, p) == '\r') p = next_byte(buffer, p);
+                if (p < end && c == '\r' && char_at(buffer, p) == '\n') p = next_byte(buffer, p);
+                vcolumn = 0;
+                continue;
+            }
+
+            if (c == ' ') {
+                vcolumn++;
+                continue;
+            }
+
+            if (c == '\t') {
+                i32 w = buffer->tab_width - vcolumn % buffer->tab_width;
+                vcolumn += w;
+                continue;
+            }
+
+            cells[vcolumn].glyph_index = (u32)c;
+
+            while (color < colors.count && colors[color].end <= pc) color++;
+            if (color < colors.count && pc >= colors[color].start) {
+                cells[vcolumn].fg = colors[color].color;
+            }
+
+            vcolumn++;
+        }
+    }
+}
+
+// NOTE(jesper): brings the glyph grids of all views up to date. The grids of the views are encoded on the job
+// pool in rounds, and a round's glyphs looked up in the atlas afterwards. If that evicted an atlas page, the
+// grids are invalidated by glyph_grid_prepare and re-encoded in another round
+void update_view_glyphs()
+{
+    SArena scratch = tl_scratch_arena();
+    FontAtlas *font = &app.mono;
+    u32 fg = bgr_pack(linear_from_sRGB(app.fg));
+
+    while (true) {
+        DynamicArray<ViewGlyphsJob> jobs{ .alloc = scratch };
+
+        for (View &view : app.views) {
+            if (view.id == -1) continue;
+
+            Buffer *buffer = get_buffer(view.buffer);
+            if (!buffer) continue;
+
+            i32 columns = (i32)ceilf(view.rect.size().x / font->space_width);
+            i32 rows = view.lines_visible;
+
+            GlyphGrid *grid = &view.glyphs;
+            glyph_grid_prepare(grid, columns, rows, view.buffer, font->generation, fg, buffer->tab_width);
+
+            GlyphGridSource source{
+                .version         = buffer->version,
+                .syntax_version  = buffer->syntax_version,
+                .syntax_degraded = buffer->syntax_degraded,
+                .line_offset     = view.line_offset,
+                .line_count      = view.lines.line_count,
+                .first           = view.lines.first,
+                .last            = view.lines.last,
+                .wrapped_end     = view.lines.wrapped_end,
+                .count           = view.lines.count,
+            };
+
+            // NOTE(jesper): the rows were encoded from exactly this state last frame, so neither the highlight
+            // query nor the rows need to be looked at again
+            if (source == grid->source) continue;
+            grid->source = source;
+
+            // NOTE(jesper): the GPU may still be reading the rows from the previous frame
+            glyph_grid_wait(grid);
+
+            ViewGlyphsJob job{
+                .view    = &view,
+                .buffer  = buffer,
+                .text    = *buffer,
+                .columns = columns,
+                .rows    = rows,
+                .fg      = fg,
+            };
+            job.colors.alloc = job.cells.alloc = job.written_rows.alloc = mem_dynamic;
+
+            if (buffer->type == BUFFER_PIECE) {
+                job.piece = *buffer->piece;
+                job.piece.cache = {};
+            }
+
+            array_add(&jobs, job);
+        }
+
+        if (jobs.count == 0) break;
+
+        // NOTE(jesper): views showing the same buffer share its highlight cache, so each of them runs after
+        // the previous one
+        DynamicArray<Job> graph{ .alloc = scratch };
+        for (i32 i = 0; i < jobs.count; i++) {
+            ViewGlyphsJob *job = &jobs[i];
+            if (job->buffer->type == BUFFER_PIECE) job->text.piece = &job->piece;
+
+            i32 after = -1;
+            for (i32 j = 0; j < i; j++) if (jobs[j].buffer == job->buffer) after = j;
+            array_add(&graph, { .proc = view_glyphs_job, .data = job, .after = after });
+        }
+
+        run_jobs(graph);
+
+        for (ViewGlyphsJob &job : jobs) {
+            GlyphGrid *grid = &job.view->glyphs;
+
+            for (i32 i = 0; i < job.written_rows.count; i++) {
+                GlyphCell *src = &job.cells[i*job.columns];
+                GlyphCell *dst = &grid->cells[job.written_rows[i]*job.columns];
+
+                for (i32 column = 0; column < job.columns; column++) {
+                    GlyphCell cell = src[column];
+
+                    // TODO(jesper): this is broken if a glyph is larger than the cell whatever unicode esque reason
+                    if (cell.glyph_index != 0xFFFFFFFF) {
+                        Glyph glyph = find_or_create_glyph(font, cell.glyph_index);
+                        cell.glyph_index = 0xFFFFFFFF;
+                        if (glyph.page >= 0) {
+                            cell.glyph_index = (u32(glyph.x0) & 0xFFF) | ((u32(glyph.y0) & 0xFFF) << 12) | (u32(glyph.page) << 24);
+                        }
+                    }
+
+                    dst[column] = cell;
+                }
+            }
+
+            if (job.written_rows.count > 0) job.view->draw_dirty = true;
+
+            FREE(mem_dynamic, job.colors.data);
+            FREE(mem_dynamic, job.cells.data);
+            FREE(mem_dynamic, job.written_rows.data);
+        }
+    }
+}
+
+// NOTE(jesper): returns whether anything was drawn that needs to be presented
+bool update_and_render() INTERNAL
 {
     SArena scratch = tl_scratch_arena();
+    if (font_begin_frame()) app.damage.glyphs_written = true;
 
     //LOG_INFO("------- frame --------");
     //defer { LOG_INFO("-------- frame end -------\n\n"); };
@@ -4128,6 +6693,22 @@ void update_and_render() INTERNAL
         app.mode = app.next_mode;
     }
 
+    // NOTE(jesper): the views' tabs, status lines, and scrollbars are drawn in the background window, which is only
+    // rebuilt on input unless it's damaged. Lines being indexed, or the views' lines or caret being changed other
+    // than by input, change them as well
+    bool views_changed = false;
+    for (Buffer &buffer : buffers) if (buffer.line_index_job) views_changed = true;
+    for (View &view : app.views) {
+        if (view.lines_dirty || view.caret_dirty || view.defer_move_view_to_caret) views_changed = true;
+    }
+
+    for (Buffer &buffer : buffers) {
+        buffer_poll_line_index(&buffer);
+        ts_poll_buffer(&buffer);
+    }
+
+    if (views_changed) gui_damage_window(gui.windows[GUI_BACKGROUND].id);
+
     gfx_begin_frame();
     gui_begin_frame();
 
@@ -4146,6 +6727,7 @@ void update_and_render() INTERNAL
 
         gui_menu("debug") {
             if (gui_button("history")) gui_window_toggle(debug.buffer_history.wnd);
+            if (gui_button("syntax memory")) gui_window_toggle(debug.syntax_memory.wnd);
 
         }
 
@@ -4155,6 +6737,11 @@ void update_and_render() INTERNAL
         }
     }
 
+    // NOTE(jesper): the debug windows show the state of the buffers, which they aren't told about changes to, so they're
+    // rebuilt in every frame they're shown in
+    gui_damage_window(debug.buffer_history.wnd);
+    gui_damage_window(debug.syntax_memory.wnd);
+
     gui_window_id(debug.buffer_history.wnd) {
         if (auto buffer = get_buffer(app.current_view->buffer); buffer) {
             i32 indent = 0;
@@ -4187,6 +6774,17 @@ void update_and_render() INTERNAL
         }
     }
 
+    gui_window_id(debug.syntax_memory.wnd) {
+        for (i32 i = 0; i < LANGUAGE_COUNT; i++) {
+            i64 bytes = ts_bytes_in_use((Language)i);
+            if (bytes == 0) continue;
+
+            String l = string_from_enum((Language)i);
+            Rect r = split_row({ gui.fonts.base.line_height*1.2f });
+            gui_textbox(stringf(scratch, "%.*s: %.2f MiB", STRFMT(l), bytes / (f32)MiB), r);
+        }
+    }
+
     f32 lister_w = gfx.resolution.x*0.7f;
     lister_w = MAX(lister_w, 500.0f);
     lister_w = MIN(lister_w, gfx.resolution.x-10);
@@ -4317,7 +6915,6 @@ next_node:;
         }
     }
 
-    DynamicArray<RangeColor> colors{ .alloc = scratch };
     for (View &view : app.views) {
         if (view.id == -1) continue;
 
@@ -4529,9 +7126,11 @@ next_node:;
                 view.lines_visible);
 
             if (view.lines_dirty) {
-                recalc_line_wrap(&view, &view.lines, 0, view.lines.count, view.buffer);
+                view_rewrap_lines(&view);
                 view.lines_dirty = false;
             }
+
+            view_wrap_lines_around(&view, view.line_offset);
         }
 
         view.text_rect = *gui_current_layout();
@@ -4551,6 +7150,7 @@ next_node:;
         view.mark = recalculate_caret(view.mark, view.buffer, view.lines);
 
         if (view.defer_move_view_to_caret) {
+            view_wrap_lines_around(&view, view.caret.wrapped_line);
             i32 line_padding = 3;
 
             // TODO(jesper): do something sensible with the decimal vertical offset
@@ -4562,196 +7162,50 @@ next_node:;
 
             view.defer_move_view_to_caret = 0;
         }
+    }
 
+    update_view_glyphs();
 
-        // draw caret
-        if (view.caret.wrapped_line >= view.line_offset &&
-            view.caret.wrapped_line < view.line_offset + view.lines_visible)
-        {
-            Rect rect = view.text_rect;
-            i32 y = view.caret.wrapped_line - view.line_offset;
-            f32 w = app.mono.space_width;
-            f32 h = app.mono.line_height+1;
-
-            Vector2 p0{
-                rect.tl.x + view.caret.wrapped_column*app.mono.space_width,
-                rect.tl.y + y*app.mono.line_height - view.voffset,
-            };
-            Vector2 p1{ p0.x, p0.y + h };
-
-            gui_draw_rect({ rect.tl.x, p0.y }, { rect.size().x, h }, app.line_bg, &gfx.frame_cmdbuf);
-
-            gui_draw_rect(p0, { w, h }, app.caret_bg, &gfx.frame_cmdbuf);
-            gui_draw_rect(p0, { 1.0f, h }, app.caret_fg, &gfx.frame_cmdbuf);
-            gui_draw_rect(p0, { w, 1.0f }, app.caret_fg, &gfx.frame_cmdbuf);
-            gui_draw_rect(p1, { w, 1.0f }, app.caret_fg, &gfx.frame_cmdbuf);
-        }
-
-        // draw caret anchor
-        if (view.mark.wrapped_line >= view.line_offset &&
-            view.mark.wrapped_line < view.line_offset + view.lines_visible)
-        {
-            Rect rect = view.text_rect;
-            i32 y = view.mark.wrapped_line - view.line_offset;
-            f32 w = app.mono.space_width/2;
-            f32 h = app.mono.line_height - 1.0f;
-
-            Vector2 p0{
-                rect.tl.x + view.mark.wrapped_column*app.mono.space_width,
-                rect.tl.y + y*app.mono.line_height - view.voffset + 1,
-            };
-            Vector2 p1{ p0.x, p0.y + h };
-
-            gui_draw_rect(p0, { 1.0f, h }, app.mark_fg, &gfx.frame_cmdbuf);
-            gui_draw_rect(p0, { w, 1.0f }, app.mark_fg, &gfx.frame_cmdbuf);
-            gui_draw_rect(p1, { w, 1.0f }, app.mark_fg, &gfx.frame_cmdbuf);
-        }
-
-        if (Buffer *buffer = get_buffer(view.buffer); buffer) {
-            FontAtlas *font = &app.mono;
-
-            i32 columns = (i32)ceilf(view.rect.size().x / font->space_width);
-            i32 rows = view.lines_visible;
-
-            i64 byte_start = line_start_offset(view.line_offset, view.lines);
-            i64 byte_end = line_end_offset(view.line_offset+rows, view.lines, view.buffer);
-
-            if (DEBUG_TREE_SITTER_COLORS) LOG_INFO("-- highlight query start --");
-
-#if DEBUG_TREE_SITTER_COLORS
-            String l = string_from_enum(buffer->language);
-            LOG_INFO("highlight colors for language '%.*s'", STRFMT(l));
-#endif
-            ts_get_syntax_colors(&colors, byte_start, byte_end, buffer->syntax_tree, buffer->language);
-
-            for (auto st : buffer->subtrees) {
-#if DEBUG_TREE_SITTER_COLORS
-                String l = string_from_enum(st.language);
-                LOG_INFO("highlight colors for language '%.*s'", STRFMT(l));
-#endif
-                ts_get_syntax_colors(&colors, byte_start, byte_end, st.tree, st.language);
-            }
-
-            if (DEBUG_TREE_SITTER_COLORS) for (auto c : colors) LOG_INFO("color range [%d, %d]", c.start, c.end);
-
-            ANON_ARRAY(u32 glyph_index; u32 fg) glyphs{};
-
-            void *mapped = nullptr;
-            i32 buffer_size = 0;
-            //if (columns*rows*(i32)sizeof glyphs[0] > buffer_size)
-            {
-                // if (mapped) {
-                //     glUnmapNamedBuffer(view.glyph_data_ssbo);
-                //     mapped = nullptr;
-                // }
-
-                buffer_size = columns*rows*sizeof glyphs[0];
-                glBindBuffer(GL_SHADER_STORAGE_BUFFER, view.glyph_data_ssbo);
-                glBufferData(GL_SHADER_STORAGE_BUFFER, buffer_size, nullptr, GL_STREAM_DRAW);
-            }
-
-            mapped = glMapNamedBufferRange(view.glyph_data_ssbo, 0, buffer_size, GL_MAP_WRITE_BIT);
-            defer { glUnmapNamedBuffer(view.glyph_data_ssbo); };
-            glyphs = { .data = (decltype(glyphs.data))mapped, .count = columns*rows};
-
-            Vector3 fg = linear_from_sRGB(app.fg);
-
-            for (auto &g : glyphs) {
-                g.glyph_index = 0xFFFFFFFF;
-                g.fg = bgr_pack(fg);
-            }
+    // NOTE(jesper): done after the glyph grids are updated, which is what can resize them and mark the views dirty
+    bool views_recorded = false;
+    for (View &view : app.views) {
+        if (view.id == -1) continue;
 
-            i32 current_color = 0;
-            for (i32 line_index = view.line_offset;
-                 line_index < MIN(view.lines.count, view.line_offset+rows);
-                 line_index++)
-            {
-                i32 i = line_index-view.line_offset;
-                i64 p = view.lines[line_index].offset;
-                i64 end = line_end_offset(line_index, view.lines, buffer);
-
-                i64 vcolumn = 0;
-                while (p < end) {
-                    i64 pc = p;
-                    i32 c = utf32_it_next(buffer, &p);
-                    if (c == 0) break;
-
-                    if (c == '\n' || c == '\r') {
-                        if (p < end && c == '\n' && char_at(buffer, p) == '\r') p = next_byte(buffer, p);
-                        if (p < end && c == '\r' && char_at(buffer, p) == '\n') p = next_byte(buffer, p);
-                        vcolumn = 0;
-                        continue;
-                    }
+        ViewDrawSource source = view_draw_source(&view);
+        if (!view.draw_dirty && source == view.drawn) continue;
 
-                    if (c == ' ') {
-                        vcolumn++;
-                        continue;
-                    }
+        view_record_draw_list(&view);
+        view.drawn = source;
+        view.draw_dirty = gui_draw_list_overflowed(&view.draw);
+        views_recorded = true;
+    }
 
-                    if (c == '\t') {
-                        i32 w = buffer->tab_width - vcolumn % buffer->tab_width;
-                        vcolumn += w;
-                        continue;
-                    }
+    gui_end_frame();
 
-                    // TODO(jesper): this is broken if a glyph is larger than the cell whatever unicode esque reason
-                    Glyph glyph = find_or_create_glyph(font, c);
-                    u32 index = (u32(glyph.x0) & 0xFFFF) | (u32(glyph.y0) << 16);
-                    glyphs[i*columns + vcolumn].glyph_index = index;
+    app.animating = text_input_enabled();
 
-                    while (current_color < colors.count && colors[current_color].end <= pc) current_color++;
-                    if (current_color < colors.count && pc >= colors[current_color].start) {
-                        glyphs[i*columns+vcolumn].fg = colors[current_color].color;
-                    }
+    bool damaged = views_recorded || gui.frame_damaged || app.damage.glyphs_written ||
+        gfx.frame_cmdbuf.commands.count > 0 || debug_gfx.commands.count > 0;
 
-                    vcolumn++;
-                }
-            }
+    app.damage.glyphs_written = false;
+    app.damage.idle = !damaged;
+    if (app.damage.idle) return false;
 
+    gfx_clear(linear_from_sRGB(app.bg));
 
-            Rect rect = *gui_current_layout();
-
-            GfxCommand cmd{
-                .type = GFX_COMMAND_MONO_TEXT,
-                .mono_text = {
-                    .vbo         = gfx.vbos.frame,
-                    .vbo_offset  = gfx.frame_vertices.count,
-                    .glyph_ssbo  = view.glyph_data_ssbo,
-                    .glyph_atlas = font->texture,
-                    .cell_size   = { app.mono.space_width, app.mono.line_height },
-                    .pos         = rect.tl,
-                    .offset      = view.voffset,
-                    .line_offset = view.line_offset,
-                    .columns     = columns,
-                }
-            };
+    Matrix3 view = mat3_orthographic2(0, gfx.resolution.x, gfx.resolution.y, 0);
 
-            array_append(&gfx.frame_vertices, {
-                rect.br.x, rect.tl.y,
-                rect.tl.x, rect.tl.y,
-                rect.tl.x, rect.br.y,
-                rect.tl.x, rect.br.y,
-                rect.br.x, rect.br.y,
-                rect.br.x, rect.tl.y,
-            });
+    gfx_submit_commands(gfx.frame_cmdbuf, view);
 
-            gfx_push_command(cmd, &gfx.frame_cmdbuf);
-        }
+    // NOTE(jesper): the views are submitted in view order, so the frame's commands come out the same regardless of
+    // which threads their glyph grids were encoded on
+    for (View &it : app.views) {
+        if (it.id != -1) gui_submit_draw_list(&it.draw, view);
     }
 
-    gui_end_frame();
-
-    Vector3 clear_color = linear_from_sRGB(app.bg);
-    glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    app.animating = text_input_enabled();
-
-    Matrix3 view = mat3_orthographic2(0, gfx.resolution.x, gfx.resolution.y, 0);
-
-    gfx_flush_transfers();
-    gfx_submit_commands(gfx.frame_cmdbuf, view);
     gfx_submit_commands(debug_gfx, view);
 
     gui_render();
+    gfx_end_frame();
+    return true;
 }
@@ -0,0 +1,352 @@
+// NOTE(jesper): piece table backing store for large buffers. The text is described by a sequence of
+// pieces pointing into either the original, immutable, file contents or into append-only blocks of
+// inserted text. The pieces are kept in an implicit treap ordered by buffer position and augmented with
+// subtree byte counts, so that insertion, removal, and offset lookup are O(log n) in the number of
+// pieces instead of O(n) in the number of bytes.
+//
+// Because neither the original contents nor the add blocks are ever moved or written to after the
+// bytes have been appended, any String referencing them remains valid for the lifetime of the table,
+// which lets buffer history reference removed and inserted text without copying it.
+
+#define PIECE_ADD_BLOCK_SIZE (64*1024)
+
+struct Piece {
+    char *data;
+    i64 length;
+};
+
+struct PieceNode {
+    Piece piece;
+    i64 size;
+    i32 left, right;
+    u32 priority;
+};
+
+struct PieceTable {
+    DynamicArray<PieceNode> nodes;
+    i32 root = -1;
+    i32 free_list = -1;
+    u32 seed = 0x9E3779B9;
+
+    i64 size;
+    Piece original;
+
+    DynamicArray<char*> add_blocks;
+    char *add_head;
+    i64 add_remaining;
+
+    // NOTE(jesper): most access patterns are sequential, so cache the last piece we looked up
+    // to make char_at and friends O(1) for the common case
+    struct {
+        i64 start, end;
+        char *data;
+    } cache;
+};
+
+u32 piece_random(PieceTable *pt)
+{
+    u32 x = pt->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return pt->seed = x;
+}
+
+i64 piece_subtree_size(PieceTable *pt, i32 node)
+{
+    return node == -1 ? 0 : pt->nodes[node].size;
+}
+
+void piece_update(PieceTable *pt, i32 node)
+{
+    PieceNode *n = &pt->nodes[node];
+    n->size = n->piece.length + piece_subtree_size(pt, n->left) + piece_subtree_size(pt, n->right);
+}
+
+i32 piece_node_alloc(PieceTable *pt, Piece piece)
+{
+    PieceNode node{
+        .piece = piece,
+        .size = piece.length,
+        .left = -1,
+        .right = -1,
+        .priority = piece_random(pt),
+    };
+
+    if (pt->free_list != -1) {
+        i32 index = pt->free_list;
+        pt->free_list = pt->nodes[index].left;
+        pt->nodes[index] = node;
+        return index;
+    }
+
+    return array_add(&pt->nodes, node);
+}
+
+void piece_node_free(PieceTable *pt, i32 node)
+{
+    if (node == -1) return;
+
+    piece_node_free(pt, pt->nodes[node].left);
+    piece_node_free(pt, pt->nodes[node].right);
+
+    pt->nodes[node].left = pt->free_list;
+    pt->free_list = node;
+}
+
+i32 piece_merge(PieceTable *pt, i32 a, i32 b)
+{
+    if (a == -1) return b;
+    if (b == -1) return a;
+
+    if (pt->nodes[a].priority > pt->nodes[b].priority) {
+        i32 right = piece_merge(pt, pt->nodes[a].right, b);
+        pt->nodes[a].right = right;
+        piece_update(pt, a);
+        return a;
+    }
+
+    i32 left = piece_merge(pt, a, pt->nodes[b].left);
+    pt->nodes[b].left = left;
+    piece_update(pt, b);
+    return b;
+}
+
+// NOTE(jesper): splits the tree such that *l contains the first offset bytes and *r the remainder,
+// splitting a piece in two if the offset lands inside of it
+void piece_split(PieceTable *pt, i32 node, i64 offset, i32 *l, i32 *r)
+{
+    if (node == -1) {
+        *l = *r = -1;
+        return;
+    }
+
+    i64 left_size = piece_subtree_size(pt, pt->nodes[node].left);
+    i64 length = pt->nodes[node].piece.length;
+
+    if (offset <= left_size) {
+        i32 ll, lr;
+        piece_split(pt, pt->nodes[node].left, offset, &ll, &lr);
+        pt->nodes[node].left = lr;
+        piece_update(pt, node);
+        *l = ll; *r = node;
+    } else if (offset >= left_size + length) {
+        i32 rl, rr;
+        piece_split(pt, pt->nodes[node].right, offset - left_size - length, &rl, &rr);
+        pt->nodes[node].right = rl;
+        piece_update(pt, node);
+        *l = node; *r = rr;
+    } else {
+        i64 cut = offset - left_size;
+        Piece tail{ pt->nodes[node].piece.data + cut, length - cut };
+
+        // NOTE(jesper): piece_node_alloc may grow the node array, don't hold on to pointers across it
+        i32 tail_node = piece_node_alloc(pt, tail);
+        i32 right = pt->nodes[node].right;
+
+        pt->nodes[node].piece.length = cut;
+        pt->nodes[node].right = -1;
+        piece_update(pt, node);
+
+        *l = node;
+        *r = piece_merge(pt, tail_node, right);
+    }
+}
+
+// NOTE(jesper): returns the node containing offset, and the buffer offset at which its piece starts
+i32 piece_find(PieceTable *pt, i64 offset, i64 *piece_start)
+{
+    i32 node = pt->root;
+    i64 base = 0;
+
+    while (node != -1) {
+        PieceNode *n = &pt->nodes[node];
+        i64 left_size = piece_subtree_size(pt, n->left);
+
+        if (offset < base + left_size) {
+            node = n->left;
+        } else if (offset < base + left_size + n->piece.length) {
+            *piece_start = base + left_size;
+            return node;
+        } else {
+            base += left_size + n->piece.length;
+            node = n->right;
+        }
+    }
+
+    return -1;
+}
+
+// NOTE(jesper): returns the contiguous run of bytes starting at offset until the end of its piece
+String piece_chunk_at(PieceTable *pt, i64 offset)
+{
+    if (offset >= pt->cache.start && offset < pt->cache.end) {
+        return { pt->cache.data + (offset - pt->cache.start), (i32)MIN(pt->cache.end - offset, i32_MAX) };
+    }
+
+    i64 start = 0;
+    i32 node = piece_find(pt, offset, &start);
+    if (node == -1) return {};
+
+    Piece piece = pt->nodes[node].piece;
+    pt->cache.start = start;
+    pt->cache.end = start + piece.length;
+    pt->cache.data = piece.data;
+
+    return { piece.data + (offset - start), (i32)MIN(pt->cache.end - offset, i32_MAX) };
+}
+
+// NOTE(jesper): returns the contiguous run of bytes ending at offset, from the start of its piece
+String piece_chunk_before(PieceTable *pt, i64 offset)
+{
+    if (offset <= 0 || piece_chunk_at(pt, offset-1).length == 0) return {};
+
+    i32 length = (i32)MIN(offset - pt->cache.start, i32_MAX);
+    return { pt->cache.data + (offset - pt->cache.start) - length, length };
+}
+
+char piece_char_at(PieceTable *pt, i64 offset)
+{
+    if (offset >= pt->cache.start && offset < pt->cache.end) {
+        return pt->cache.data[offset - pt->cache.start];
+    }
+
+    String chunk = piece_chunk_at(pt, offset);
+    return chunk.length > 0 ? chunk[0] : 0;
+}
+
+// NOTE(jesper): copies the text into the add blocks and returns the stable copy
+String piece_append_text(PieceTable *pt, String text)
+{
+    if (text.length > pt->add_remaining) {
+        i64 block_size = MAX(PIECE_ADD_BLOCK_SIZE, text.length);
+        char *block = ALLOC_ARR(mem_dynamic, char, block_size);
+        array_add(&pt->add_blocks, block);
+
+        pt->add_head = block;
+        pt->add_remaining = block_size;
+    }
+
+    String result{ pt->add_head, text.length };
+    memcpy(pt->add_head, text.data, text.length);
+
+    pt->add_head += text.length;
+    pt->add_remaining -= text.length;
+    return result;
+}
+
+// NOTE(jesper): extends the piece ending at offset in-place if its bytes are immediately followed by
+// the newly appended text. This is the common case when typing sequentially and avoids growing the
+// tree by a node per keystroke
+bool piece_try_extend(PieceTable *pt, i32 node, i64 offset, String text)
+{
+    if (node == -1) return false;
+
+    i64 left_size = piece_subtree_size(pt, pt->nodes[node].left);
+    i64 length = pt->nodes[node].piece.length;
+
+    bool extended = false;
+    if (offset <= left_size) {
+        extended = piece_try_extend(pt, pt->nodes[node].left, offset, text);
+    } else if (offset > left_size + length) {
+        extended = piece_try_extend(pt, pt->nodes[node].right, offset - left_size - length, text);
+    } else if (offset == left_size + length && pt->nodes[node].piece.data + length == text.data) {
+        pt->nodes[node].piece.length += text.length;
+        extended = true;
+    }
+
+    if (extended) pt->nodes[node].size += text.length;
+    return extended;
+}
+
+PieceTable* create_piece_table(char *data, i64 size, Allocator mem)
+{
+    PieceTable *pt = ALLOC_T(mem, PieceTable) {};
+    pt->original = { data, size };
+    pt->size = size;
+
+    if (size > 0) pt->root = piece_node_alloc(pt, pt->original);
+    return pt;
+}
+
+// NOTE(jesper): replaces the contents of the table with data, which becomes its original. The add blocks are kept,
+// so the Strings referencing them remain valid
+void piece_reset(PieceTable *pt, char *data, i64 size)
+{
+    pt->nodes.count = 0;
+    pt->root = -1;
+    pt->free_list = -1;
+    pt->cache = {};
+
+    pt->original = { data, size };
+    pt->size = size;
+
+    if (size > 0) pt->root = piece_node_alloc(pt, pt->original);
+}
+
+// NOTE(jesper): returns the stable copy of text that the table references
+String piece_insert(PieceTable *pt, i64 offset, String text)
+{
+    if (text.length <= 0) return {};
+
+    String stable = piece_append_text(pt, text);
+    pt->cache = {};
+
+    if (offset == 0 || !piece_try_extend(pt, pt->root, offset, stable)) {
+        i32 l, r;
+        piece_split(pt, pt->root, offset, &l, &r);
+
+        i32 node = piece_node_alloc(pt, { stable.data, stable.length });
+        pt->root = piece_merge(pt, piece_merge(pt, l, node), r);
+    }
+
+    pt->size += stable.length;
+    return stable;
+}
+
+void piece_remove(PieceTable *pt, i64 start, i64 end)
+{
+    if (end <= start) return;
+    pt->cache = {};
+
+    i32 l, m, r;
+    piece_split(pt, pt->root, start, &l, &r);
+    piece_split(pt, r, end-start, &m, &r);
+
+    piece_node_free(pt, m);
+    pt->root = piece_merge(pt, l, r);
+    pt->size -= end-start;
+}
+
+// NOTE(jesper): returns the bytes in [start, end[ if they are contiguous in memory, i.e. all within
+// the same piece, or an empty string otherwise
+String piece_contiguous_range(PieceTable *pt, i64 start, i64 end)
+{
+    String chunk = piece_chunk_at(pt, start);
+    if (chunk.length < end-start) return {};
+    return { chunk.data, (i32)(end-start) };
+}
+
+void piece_read(PieceTable *pt, i64 start, i64 end, char *dst)
+{
+    for (i64 offset = start; offset < end;) {
+        String chunk = piece_chunk_at(pt, offset);
+        if (chunk.length == 0) break;
+
+        i64 count = MIN(chunk.length, end-offset);
+        memcpy(dst, chunk.data, count);
+        dst += count;
+        offset += count;
+    }
+}
+
+// NOTE(jesper): appends the pieces of the subtree in buffer order. The pieces reference immutable storage,
+// so the resulting list is a snapshot of the contents that remains valid across later edits of the table
+void piece_collect(PieceTable *pt, i32 node, DynamicArray<Piece> *pieces)
+{
+    if (node == -1) return;
+
+    piece_collect(pt, pt->nodes[node].left, pieces);
+    array_add(pieces, pt->nodes[node].piece);
+    piece_collect(pt, pt->nodes[node].right, pieces);
+}
@@ -0,0 +1,204 @@
+// NOTE(jesper): compact storage for the wrapped lines of a view. Lines are stored in blocks of at most
+// VIEW_LINE_BLOCK_SIZE lines, as a base offset, the deltas of every line's offset from it, and a bitmap of
+// which lines are wrapped. The deltas are u16 unless the block spans more than 64KiB, in which case they're
+// u32, bringing a line down from 8 bytes to a little over 2 in the common case.
+//
+// Shifting the offsets of every line following an edit only has to touch the bases of the blocks, and offset
+// and line lookups are a binary search over the blocks followed by one within the block.
+
+#define VIEW_LINE_BLOCK_SIZE 256
+
+struct ViewLine {
+    i64 offset : 63;
+    i64 wrapped : 1;
+};
+
+struct ViewLineBlock {
+    i64 base;
+    i32 first;
+    i32 count;
+
+    u32 wrapped[VIEW_LINE_BLOCK_SIZE/32];
+    u16 deltas[VIEW_LINE_BLOCK_SIZE];
+
+    // NOTE(jesper): used instead of deltas if any of the deltas don't fit in a u16
+    u32 *wide_deltas;
+};
+
+struct ViewLineBlocks {
+    DynamicArray<ViewLineBlock> blocks;
+    i32 count;
+};
+
+i64 view_line_block_offset(const ViewLineBlock *block, i32 i)
+{
+    return block->base + (block->wide_deltas ? block->wide_deltas[i] : block->deltas[i]);
+}
+
+ViewLine view_line_block_line(const ViewLineBlock *block, i32 i)
+{
+    return { view_line_block_offset(block, i), .wrapped = ((block->wrapped[i/32] >> (i%32)) & 1) != 0 };
+}
+
+// NOTE(jesper): returns the index of the block containing line
+i32 view_line_block_find(const ViewLineBlocks *vl, i32 line)
+{
+    i32 lo = 0, hi = vl->blocks.count-1;
+    while (lo < hi) {
+        i32 mid = lo + (hi-lo+1)/2;
+        if (vl->blocks.data[mid].first <= line) lo = mid;
+        else hi = mid-1;
+    }
+    return lo;
+}
+
+ViewLine view_line_get(const ViewLineBlocks *vl, i32 line)
+{
+    const ViewLineBlock *block = &vl->blocks.data[view_line_block_find(vl, line)];
+    return view_line_block_line(block, line - block->first);
+}
+
+// NOTE(jesper): returns the last line starting at or before offset
+i32 view_line_at_offset(const ViewLineBlocks *vl, i64 offset)
+{
+    if (vl->count == 0) return 0;
+
+    i32 lo = 0, hi = vl->blocks.count-1;
+    while (lo < hi) {
+        i32 mid = lo + (hi-lo+1)/2;
+        if (vl->blocks.data[mid].base <= offset) lo = mid;
+        else hi = mid-1;
+    }
+
+    const ViewLineBlock *block = &vl->blocks.data[lo];
+
+    i32 l = 0, h = block->count-1;
+    while (l < h) {
+        i32 mid = l + (h-l+1)/2;
+        if (view_line_block_offset(block, mid) <= offset) l = mid;
+        else h = mid-1;
+    }
+
+    return block->first + l;
+}
+
+// NOTE(jesper): encodes the lines into blocks of evenly distributed line counts. A block is ended early if its
+// deltas would no longer fit in a u32. The offsets are normally increasing, but the lines following an edit are
+// shifted before the lines it touched are rewrapped, so the base is the lowest offset in the block rather than
+// the first
+void view_line_blocks_encode(Array<ViewLine> lines, DynamicArray<ViewLineBlock> *blocks)
+{
+    i32 num_blocks = MAX(1, (lines.count + VIEW_LINE_BLOCK_SIZE-1) / VIEW_LINE_BLOCK_SIZE);
+    i32 per_block = (lines.count + num_blocks-1) / num_blocks;
+
+    for (i32 i = 0; i < lines.count;) {
+        i64 lo = lines[i].offset, hi = lo;
+
+        i32 end = i+1;
+        for (; end < lines.count && end-i < per_block; end++) {
+            i64 offset = lines[end].offset;
+            if (MAX(hi, offset) - MIN(lo, offset) > 0xFFFFFFFF) break;
+
+            lo = MIN(lo, offset);
+            hi = MAX(hi, offset);
+        }
+
+        ViewLineBlock block{ .base = lo, .count = end-i };
+        if (hi-lo > 0xFFFF) block.wide_deltas = ALLOC_ARR(mem_dynamic, u32, VIEW_LINE_BLOCK_SIZE);
+
+        for (i32 j = 0; j < block.count; j++) {
+            i64 delta = lines[i+j].offset - lo;
+            if (block.wide_deltas) block.wide_deltas[j] = (u32)delta;
+            else block.deltas[j] = (u16)delta;
+
+            if (lines[i+j].wrapped) block.wrapped[j/32] |= 1u << (j%32);
+        }
+
+        array_add(blocks, block);
+        i = end;
+    }
+}
+
+void view_line_blocks_renumber(ViewLineBlocks *vl, i32 from_block)
+{
+    i32 first = 0;
+    if (from_block > 0) first = vl->blocks[from_block-1].first + vl->blocks[from_block-1].count;
+
+    for (i32 i = from_block; i < vl->blocks.count; i++) {
+        vl->blocks[i].first = first;
+        first += vl->blocks[i].count;
+    }
+
+    vl->count = first;
+}
+
+// NOTE(jesper): replaces the lines in [start, end[ with the given lines. Only the blocks covering the range
+// are re-encoded
+void view_line_blocks_replace(ViewLineBlocks *vl, i32 start, i32 end, Array<ViewLine> lines)
+{
+    SArena scratch = tl_scratch_arena();
+
+    i32 first_block = 0, last_block = 0;
+    i32 range_start = 0, range_end = 0;
+    if (vl->blocks.count > 0) {
+        first_block = view_line_block_find(vl, start);
+        last_block = view_line_block_find(vl, MAX(end-1, start))+1;
+
+        range_start = vl->blocks[first_block].first;
+        range_end = vl->blocks[last_block-1].first + vl->blocks[last_block-1].count;
+    }
+
+    DynamicArray<ViewLine> merged{ .alloc = scratch };
+    array_reserve(&merged, start - range_start + lines.count + range_end - end);
+
+    for (i32 i = range_start; i < start; i++) array_add(&merged, view_line_get(vl, i));
+    for (ViewLine line : lines) array_add(&merged, line);
+    for (i32 i = end; i < range_end; i++) array_add(&merged, view_line_get(vl, i));
+
+    for (i32 i = first_block; i < last_block; i++) {
+        if (vl->blocks[i].wide_deltas) FREE(mem_dynamic, vl->blocks[i].wide_deltas);
+    }
+
+    DynamicArray<ViewLineBlock> new_blocks{ .alloc = scratch };
+    view_line_blocks_encode(merged, &new_blocks);
+
+    array_replace(&vl->blocks, first_block, last_block, new_blocks);
+    view_line_blocks_renumber(vl, first_block);
+}
+
+// NOTE(jesper): adds delta to the offsets of the lines in [start, count[
+void view_line_blocks_shift(ViewLineBlocks *vl, i32 start, i64 delta)
+{
+    if (start >= vl->count || delta == 0) return;
+
+    i32 block_index = view_line_block_find(vl, start);
+    for (i32 i = block_index+1; i < vl->blocks.count; i++) vl->blocks[i].base += delta;
+
+    ViewLineBlock *block = &vl->blocks[block_index];
+    if (start == block->first) {
+        block->base += delta;
+        return;
+    }
+
+    SArena scratch = tl_scratch_arena();
+    DynamicArray<ViewLine> lines{ .alloc = scratch };
+    array_reserve(&lines, block->count);
+
+    for (i32 i = 0; i < block->count; i++) {
+        ViewLine line = view_line_block_line(block, i);
+        if (block->first + i >= start) line.offset += delta;
+        array_add(&lines, line);
+    }
+
+    view_line_blocks_replace(vl, block->first, block->first + block->count, lines);
+}
+
+void view_line_blocks_clear(ViewLineBlocks *vl)
+{
+    for (ViewLineBlock &block : vl->blocks) {
+        if (block.wide_deltas) FREE(mem_dynamic, block.wide_deltas);
+    }
+
+    vl->blocks.count = 0;
+    vl->count = 0;
+}
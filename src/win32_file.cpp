@@ -0,0 +1,71 @@
+#include "core/win32_core.h"
+
+#include "core/memory.h"
+#include "core/string.h"
+
+char* map_file_readonly(String path, i64 *size)
+{
+    SArena scratch = tl_scratch_arena();
+
+    HANDLE file = CreateFileA(
+        sz_string(path, scratch),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("failed to open file '%.*s'", STRFMT(path));
+        return nullptr;
+    }
+    defer { CloseHandle(file); };
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return nullptr;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        LOG_ERROR("failed to create file mapping for '%.*s'", STRFMT(path));
+        return nullptr;
+    }
+    defer { CloseHandle(mapping); };
+
+    // NOTE(jesper): the view keeps the mapping and file alive after the handles are closed
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        LOG_ERROR("failed to map view of file '%.*s'", STRFMT(path));
+        return nullptr;
+    }
+
+    *size = file_size.QuadPart;
+    return (char*)data;
+}
+
+void unmap_file(char *data, i64 /*size*/)
+{
+    UnmapViewOfFile(data);
+}
+
+i64 get_file_size(String path)
+{
+    SArena scratch = tl_scratch_arena();
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(sz_string(path, scratch), GetFileExInfoStandard, &attributes)) return -1;
+
+    return ((i64)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+}
+
+bool replace_file(String dst, String src)
+{
+    SArena scratch = tl_scratch_arena();
+
+    // NOTE(jesper): this fails if dst has an open mapping, buffer_save moves the buffer onto a mapping of src first
+    if (!MoveFileExA(sz_string(src, scratch), sz_string(dst, scratch), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_ERROR("failed to replace file '%.*s' with '%.*s'", STRFMT(dst), STRFMT(src));
+        return false;
+    }
+
+    return true;
+}